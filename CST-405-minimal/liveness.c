@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "liveness.h"
+
+static int liveIsTemp(const char* s) {
+    if (!s || s[0] != 't' || s[1] == '\0') return 0;
+    for (int i = 1; s[i]; i++) if (!isdigit((unsigned char)s[i])) return 0;
+    return 1;
+}
+
+static int liveTracked(const char* s, int (*isScalar)(const char*)) {
+    if (!s || s[0] == '"') return 0;
+    if (liveIsTemp(s)) return 1;
+    char* end;
+    strtod(s, &end);
+    if (*end == '\0') return 0;                  /* numeric constant */
+    return isScalar(s);
+}
+
+int liveNameIndex(LiveInfo* L, const char* name) {
+    if (!name) return -1;
+    for (int k = 0; k < L->nNames; k++)
+        if (strcmp(L->names[k], name) == 0) return k;
+    return -1;
+}
+
+static int liveIntern(LiveInfo* L, const char* name, int (*isScalar)(const char*)) {
+    if (!liveTracked(name, isScalar)) return -1;
+    int k = liveNameIndex(L, name);
+    if (k >= 0 || L->nNames >= LIVE_MAX_NAMES) return k;
+    L->names[L->nNames] = (char*)name;
+    return L->nNames++;
+}
+
+int liveIsSet(const unsigned* set, int name) {
+    return (set[name / 32] >> (name % 32)) & 1u;
+}
+
+static void liveSetBit(unsigned* set, int name) {
+    set[name / 32] |= 1u << (name % 32);
+}
+
+static void liveClearBit(unsigned* set, int name) {
+    set[name / 32] &= ~(1u << (name % 32));
+}
+
+/* Which operand fields does code[i] read?  ARG operands are read at
+ * the FUNC_CALL (the backend loads argument registers at the jal), so
+ * an ARG reads nothing and a call reads its own ARGs.  A nested call's
+ * ARGs sit between the outer call's; walking back, each nested call
+ * hides as many earlier ARGs as it takes. */
+static int liveCollectUses(LiveInfo* L, int i, int* out, int (*isScalar)(const char*)) {
+    TACInstr* in = L->code[i];
+    const char* ops[3] = { NULL, NULL, NULL };
+    int count = 0;
+    switch (in->op) {
+    case TAC_ASSIGN: case TAC_PRINT: case TAC_WRITE: case TAC_RETURN:
+    case TAC_IF_FALSE:
+        ops[0] = in->arg1; break;
+    case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY: case TAC_DIVIDE:
+    case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+    case TAC_ARRAY_READ:
+        ops[0] = in->arg1; ops[1] = in->arg2; break;
+    case TAC_MEMBER_LOAD:
+        ops[0] = in->arg1; break;
+    case TAC_ARRAY_WRITE:
+        ops[0] = in->arg1; ops[1] = in->arg2; ops[2] = in->result; break;
+    case TAC_MEMBER_STORE:
+        ops[0] = in->arg1; ops[1] = in->result; break;
+    case TAC_SELECT:            /* keeps the old result when arg1 is 0 */
+        ops[0] = in->arg1; ops[1] = in->arg2; ops[2] = in->result; break;
+    case TAC_FUNC_CALL: {
+        int want = getFunctionParamCount(in->arg1), hidden = 0;
+        for (int j = i - 1; j > 0 && want != 0; j--) {
+            TACInstr* a = L->code[j];
+            if (a->op == TAC_FUNC_CALL) {
+                int n = getFunctionParamCount(a->arg1);
+                if (n < 0 || want < 0) break;
+                hidden += n;
+            } else if (a->op == TAC_ARG) {
+                if (hidden > 0) { hidden--; continue; }
+                int k = liveIntern(L, a->arg1, isScalar);
+                if (k >= 0) out[count++] = k;
+                want--;
+            }
+        }
+        return count;
+    }
+    default:
+        break;
+    }
+    for (int f = 0; f < 3; f++) {
+        int k = liveIntern(L, ops[f], isScalar);
+        if (k >= 0) out[count++] = k;
+    }
+    return count;
+}
+
+static int liveCollectDef(LiveInfo* L, int i, int (*isScalar)(const char*)) {
+    TACInstr* in = L->code[i];
+    switch (in->op) {
+    case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+    case TAC_DIVIDE: case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT:
+    case TAC_LE: case TAC_GE: case TAC_ARRAY_READ: case TAC_MEMBER_LOAD:
+    case TAC_ADDR_OF: case TAC_FUNC_CALL: case TAC_SELECT:
+        return liveIntern(L, in->result, isScalar);
+    case TAC_PARAM:
+        return liveIntern(L, in->arg1, isScalar);
+    default:
+        return -1;
+    }
+}
+
+static int liveFindLabel(LiveInfo* L, const char* label) {
+    for (int j = 0; j < L->n; j++)
+        if (L->code[j]->op == TAC_LABEL && L->code[j]->arg1 &&
+            strcmp(L->code[j]->arg1, label) == 0) return j;
+    return -1;
+}
+
+void liveAnalyze(LiveInfo* L, TACInstr** code, int n, int (*isScalar)(const char*)) {
+    L->code = code;
+    L->n = n;
+    L->nNames = 0;
+    L->def = malloc(sizeof(int) * n);
+    L->succ = malloc(sizeof(int) * 2 * n);
+    L->useStart = malloc(sizeof(int) * (n + 1));
+
+    /* Uses and defs; every ARG is read at most once, so 3 per instruction
+     * plus one per ARG bounds the list. */
+    L->useList = malloc(sizeof(int) * (4 * n + 1));
+    int used = 0;
+    for (int i = 0; i < n; i++) {
+        L->useStart[i] = used;
+        used += liveCollectUses(L, i, L->useList + used, isScalar);
+        L->def[i] = liveCollectDef(L, i, isScalar);
+    }
+    L->useStart[n] = used;
+
+    /* Control-flow successors */
+    for (int i = 0; i < n; i++) {
+        TACInstr* in = code[i];
+        int* s = &L->succ[2 * i];
+        s[0] = s[1] = -1;
+        if (in->op == TAC_RETURN) continue;
+        if (in->op == TAC_GOTO) { s[0] = liveFindLabel(L, in->arg1); continue; }
+        if (i + 1 < n) s[0] = i + 1;
+        if (in->op == TAC_IF_FALSE) s[1] = liveFindLabel(L, in->result);
+    }
+
+    L->words = (L->nNames + 31) / 32;
+    if (L->words == 0) L->words = 1;
+    L->liveIn  = calloc((size_t)n * L->words, sizeof(unsigned));
+    L->liveOut = calloc((size_t)n * L->words, sizeof(unsigned));
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            unsigned* out = L->liveOut + (size_t)i * L->words;
+            unsigned* in  = L->liveIn  + (size_t)i * L->words;
+            for (int w = 0; w < L->words; w++) {
+                unsigned v = 0;
+                for (int k = 0; k < 2; k++) {
+                    int s = L->succ[2 * i + k];
+                    if (s >= 0) v |= L->liveIn[(size_t)s * L->words + w];
+                }
+                out[w] = v;
+            }
+            unsigned newIn[L->words];
+            memcpy(newIn, out, sizeof(unsigned) * L->words);
+            if (L->def[i] >= 0) liveClearBit(newIn, L->def[i]);
+            for (int u = L->useStart[i]; u < L->useStart[i + 1]; u++)
+                liveSetBit(newIn, L->useList[u]);
+            if (memcmp(newIn, in, sizeof(unsigned) * L->words) != 0) {
+                memcpy(in, newIn, sizeof(unsigned) * L->words);
+                changed = 1;
+            }
+        }
+    }
+}
+
+int liveUses(LiveInfo* L, int i, int* out) {
+    int count = 0;
+    for (int u = L->useStart[i]; u < L->useStart[i + 1]; u++)
+        out[count++] = L->useList[u];
+    return count;
+}
+
+int liveDef(LiveInfo* L, int i) {
+    return L->def[i];
+}
+
+void liveFree(LiveInfo* L) {
+    free(L->def);
+    free(L->succ);
+    free(L->useStart);
+    free(L->useList);
+    free(L->liveIn);
+    free(L->liveOut);
+    L->def = L->succ = L->useStart = L->useList = NULL;
+    L->liveIn = L->liveOut = NULL;
+}
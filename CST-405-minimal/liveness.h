@@ -0,0 +1,37 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include "tac.h"
+
+/* LIVENESS ANALYSIS
+ * Backward dataflow over one function of TAC.  Tracks the scalar
+ * operands (temps, scalar locals, parameters) that hold a value which
+ * may still be read later.  Arrays and structs are memory objects and
+ * are not tracked.  Used to share stack slots and to allocate registers.
+ */
+
+#define LIVE_MAX_NAMES 1024
+
+typedef struct {
+    TACInstr** code;                 /* code[0] = FUNC_DEF, then the body */
+    int        n;                    /* number of instructions */
+    char*      names[LIVE_MAX_NAMES];/* scalar operands, in first-seen order */
+    int        nNames;
+    int        words;                /* bitset words per instruction */
+    unsigned*  liveIn;               /* n * words: live before code[i] */
+    unsigned*  liveOut;              /* n * words: live after code[i] */
+    int*       succ;                 /* 2 successors per instruction, -1 = none */
+    int*       def;                  /* name written by code[i], or -1 */
+    int*       useStart;             /* uses of code[i] are useList[useStart[i]..useStart[i+1]) */
+    int*       useList;
+} LiveInfo;
+
+/* isScalar decides which non-temp names are tracked (temps always are) */
+void liveAnalyze(LiveInfo* L, TACInstr** code, int n, int (*isScalar)(const char*));
+void liveFree(LiveInfo* L);
+int  liveNameIndex(LiveInfo* L, const char* name);          /* -1 if untracked */
+int  liveIsSet(const unsigned* set, int name);              /* test bit */
+int  liveUses(LiveInfo* L, int i, int* out);                /* names read by code[i] */
+int  liveDef(LiveInfo* L, int i);                           /* name written, or -1 */
+
+#endif
@@ -7,6 +7,9 @@
 #include <string.h>
 #include <ctype.h>
 #include <sys/time.h>
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
 #include "ast.h"
 #include "symtab.h"
 #include "codegen.h"
@@ -14,6 +17,7 @@
 #include "tac.h"
 #include "benchmark.h"
 #include "stringpool.h"
+#include "superopt.h"
 
 // External declarations for TAC lists
 extern TACList tacList;
@@ -86,8 +90,11 @@ static int countMIPSInstructionsFromFile(const char* filePath) {
 
 static int runSpimCaptureWithTiming(const char* asmFile, const char* transcriptFile, double* elapsedMs) {
     char spim_cmd[1024];
+    int delayed = 0;
+    optGetProfileOption("delay-slots", &delayed);
     snprintf(spim_cmd, sizeof(spim_cmd),
-             "spim -file \"%s\" > \"%s\" 2>&1", asmFile, transcriptFile);
+             "spim %s-file \"%s\" > \"%s\" 2>&1",
+             delayed ? "-delayed_branches " : "", asmFile, transcriptFile);
     double start = now_ms();
     int status = system(spim_cmd);
     double end = now_ms();
@@ -123,6 +130,253 @@ static void write_benchmark_line(FILE* report, const char* phase, BenchmarkResul
     fprintf(report, "  Memory Delta: %.2f KB\n", bench->peak_memory / 1024.0);
 }
 
+/* AUTOTUNER
+ * Recompiles the input with this compiler under candidate profiles
+ * (post-pass orders and thresholds) and scores each one as
+ *     static MIPS instructions / default + SPIM run time / default,
+ * lower being better.  Every candidate, the default included, must
+ * print what the unoptimized build prints under SPIM; without SPIM
+ * nothing can be checked and the tuner refuses to run.  The target
+ * options (regalloc, delay-slots) stay as given and are not searched.
+ * Search: move each pass to every other position, then try each
+ * threshold's values, keeping every improvement.  Candidate files live
+ * in a private temporary directory that is removed at the end.
+ */
+#define TUNE_MAX_CANDIDATES 200
+#define TUNE_RUNS           3
+#define TUNE_PROFILE        "candidate.prof"
+#define TUNE_TARGET         "target.prof"
+#define TUNE_ASM            "candidate.s"
+#define TUNE_OUTPUT         "candidate.txt"
+#define TUNE_REFERENCE      "reference.txt"
+#define TUNE_UNOPT_ASM      "test_final_unopt.s"   /* written by each child compile */
+#define TUNE_NOISE          0.02    /* run-time differences below this are noise */
+
+typedef struct {
+    const char* key;
+    int         values[4];
+} TuneParam;
+
+static const TuneParam tuneParams[] = {
+    { "unswitch-max-loop", { 0, 48, 96, 192 } },
+    { "unswitch-budget",   { 64, 128, 256, 1024 } },
+    { "ifconv-max-arm",    { 0, 1, 3, 6 } },
+    { "egraph-rounds",     { 0, 2, 8, 16 } },
+};
+#define TUNE_NUM_PARAMS ((int)(sizeof(tuneParams) / sizeof(tuneParams[0])))
+
+typedef struct {
+    const char* passes[32];
+    int         nPasses;
+    int         values[TUNE_NUM_PARAMS];
+    int         staticCount;
+    double      runMs;
+    double      score;
+} TuneConfig;
+
+static int sameFileContents(const char* a, const char* b) {
+    FILE* fa = fopen(a, "r");
+    FILE* fb = fopen(b, "r");
+    int same = fa && fb;
+    while (same) {
+        int ca = fgetc(fa), cb = fgetc(fb);
+        if (ca != cb) same = 0;
+        if (ca == EOF) break;
+    }
+    if (fa) fclose(fa);
+    if (fb) fclose(fb);
+    return same;
+}
+
+static char tuneDir[512];
+
+/* path of a file inside the tuning directory (one of two rotating buffers) */
+static const char* tunePath(const char* name) {
+    static char buf[2][1024];
+    static int next = 0;
+    char* p = buf[next];
+    next ^= 1;
+    snprintf(p, sizeof(buf[0]), "%s/%s", tuneDir, name);
+    return p;
+}
+
+static int makeTuneDir(void) {
+    const char* tmp = getenv("TMPDIR");
+    snprintf(tuneDir, sizeof(tuneDir), "%s/minicompiler-tune-XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    return mkdtemp(tuneDir) ? 0 : -1;
+}
+
+static void removeTuneDir(void) {
+    DIR* d = opendir(tuneDir);
+    if (d) {
+        struct dirent* e;
+        while ((e = readdir(d)) != NULL)
+            if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0)
+                remove(tunePath(e->d_name));
+        closedir(d);
+    }
+    rmdir(tuneDir);
+}
+
+static int writeTuneProfile(const TuneConfig* c, const char* path, const char* header) {
+    char passes[512] = "";
+    char value[32];
+    for (int i = 0; i < c->nPasses; i++) {
+        if (i) strcat(passes, ",");
+        strcat(passes, c->passes[i]);
+    }
+    optSetProfileOption("passes", passes);
+    for (int i = 0; i < TUNE_NUM_PARAMS; i++) {
+        snprintf(value, sizeof(value), "%d", c->values[i]);
+        optSetProfileOption(tuneParams[i].key, value);
+    }
+    FILE* f = fopen(path, "w");
+    if (!f) return -1;
+    if (header) fputs(header, f);
+    optWriteProfile(f, 0);
+    fclose(f);
+    return 0;
+}
+
+/* Compile one candidate inside tuneDir; self and input are absolute */
+static int compileTuneConfig(const char* self, const char* input, const TuneConfig* c) {
+    char cmd[4096];
+    if (writeTuneProfile(c, tunePath(TUNE_PROFILE), NULL) != 0) return -1;
+    snprintf(cmd, sizeof(cmd),
+             "cd \"%s\" && \"%s\" --profile=" TUNE_TARGET " --profile=" TUNE_PROFILE
+             " \"%s\" " TUNE_ASM " > /dev/null 2>&1",
+             tuneDir, self, input);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+/* Run the compiled candidate; 0 on success, -1 if it is rejected */
+static int measureTuneConfig(TuneConfig* c, const TuneConfig* base) {
+    c->staticCount = countMIPSInstructionsFromFile(tunePath(TUNE_ASM));
+    if (c->staticCount < 0) return -1;
+    c->runMs = 0.0;
+    for (int r = 0; r < TUNE_RUNS; r++) {
+        double ms;
+        if (runSpimCaptureWithTiming(tunePath(TUNE_ASM), tunePath(TUNE_OUTPUT), &ms) != 0) return -1;
+        if (!sameFileContents(tunePath(TUNE_OUTPUT), tunePath(TUNE_REFERENCE))) return -1;
+        if (r == 0 || ms < c->runMs) c->runMs = ms;
+    }
+    c->score = base ? (double)c->staticCount / base->staticCount : 1.0;
+    c->score += base && base->runMs > 0.0 ? c->runMs / base->runMs : 1.0;
+    return 0;
+}
+
+static int evaluateTuneConfig(const char* self, const char* input, TuneConfig* c,
+                              const TuneConfig* base) {
+    return compileTuneConfig(self, input, c) == 0 ? measureTuneConfig(c, base) : -1;
+}
+
+/* Fewer static instructions without a measurable slowdown, or a
+ * score gain beyond timing noise */
+static int tuneBetter(const TuneConfig* c, const TuneConfig* best) {
+    if (c->staticCount < best->staticCount && c->runMs <= best->runMs * (1.0 + TUNE_NOISE)) return 1;
+    return c->score < best->score - TUNE_NOISE;
+}
+
+static int runAutotune(const char* self, const char* input, const char* profileOut) {
+    TuneConfig base, best, cand;
+    memset(&base, 0, sizeof(base));
+    base.nPasses = optNumProfilePasses();
+    for (int i = 0; i < base.nPasses; i++) base.passes[i] = optProfilePass(i);
+    for (int i = 0; i < TUNE_NUM_PARAMS; i++) optGetProfileOption(tuneParams[i].key, &base.values[i]);
+
+    char selfPath[PATH_MAX], inputPath[PATH_MAX];
+    if (!realpath(input, inputPath)) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", input);
+        return 1;
+    }
+    if (!strchr(self, '/')) snprintf(selfPath, sizeof(selfPath), "%s", self);   /* found on PATH */
+    else if (!realpath(self, selfPath)) {
+        fprintf(stderr, "Error: Cannot locate the compiler '%s'\n", self);
+        return 1;
+    }
+    if (makeTuneDir() != 0) {
+        fprintf(stderr, "Error: Cannot create a temporary directory for tuning\n");
+        return 1;
+    }
+
+    printf("Autotuning %s\n", input);
+    int status = 1;
+    FILE* target = fopen(tunePath(TUNE_TARGET), "w");
+    if (!target) {
+        fprintf(stderr, "Error: Cannot write to '%s'\n", tuneDir);
+        goto done;
+    }
+    optWriteProfile(target, 1);
+    fclose(target);
+    /* The default compile also writes the unoptimized build, whose
+     * output is the reference every candidate must reproduce */
+    if (compileTuneConfig(selfPath, inputPath, &base) != 0) {
+        fprintf(stderr, "Error: '%s' does not compile with the default profile\n", input);
+        goto done;
+    }
+    if (runSpimCaptureWithTiming(tunePath(TUNE_UNOPT_ASM), tunePath(TUNE_REFERENCE), NULL) != 0) {
+        fprintf(stderr, "Error: SPIM is required to check candidate output; not tuning\n");
+        goto done;
+    }
+    if (measureTuneConfig(&base, NULL) != 0) {
+        fprintf(stderr, "Error: the default profile changes the output of '%s'; not tuning\n", input);
+        goto done;
+    }
+    printf("  default: %d static instructions, %.3f ms\n", base.staticCount, base.runMs);
+    best = base;
+    int tried = 1;
+
+    /* Pass order: move each pass to every other position */
+    for (int i = 0; i < best.nPasses && tried < TUNE_MAX_CANDIDATES; i++) {
+        for (int j = 0; j < best.nPasses && tried < TUNE_MAX_CANDIDATES; j++) {
+            if (i == j) continue;
+            cand = best;
+            const char* moved = cand.passes[i];
+            if (i < j) memmove(&cand.passes[i], &cand.passes[i + 1], sizeof(char*) * (j - i));
+            else       memmove(&cand.passes[j + 1], &cand.passes[j], sizeof(char*) * (i - j));
+            cand.passes[j] = moved;
+            tried++;
+            if (evaluateTuneConfig(selfPath, inputPath, &cand, &base) == 0 && tuneBetter(&cand, &best)) {
+                best = cand;
+                printf("  [%3d] move %-8s to %d: score %.4f (%d static, %.3f ms)\n",
+                       tried, moved, j, best.score, best.staticCount, best.runMs);
+            }
+        }
+    }
+
+    /* Thresholds: one at a time */
+    for (int p = 0; p < TUNE_NUM_PARAMS; p++) {
+        for (int v = 0; v < 4 && tried < TUNE_MAX_CANDIDATES; v++) {
+            if (tuneParams[p].values[v] == best.values[p]) continue;
+            cand = best;
+            cand.values[p] = tuneParams[p].values[v];
+            tried++;
+            if (evaluateTuneConfig(selfPath, inputPath, &cand, &base) == 0 && tuneBetter(&cand, &best)) {
+                best = cand;
+                printf("  [%3d] %s = %d: score %.4f (%d static, %.3f ms)\n",
+                       tried, tuneParams[p].key, cand.values[p], best.score, best.staticCount, best.runMs);
+            }
+        }
+    }
+
+    char header[1024];
+    snprintf(header, sizeof(header),
+             "# Optimization profile for %s, tuned over %d candidates\n"
+             "# default: %d static instructions, %.3f ms\n"
+             "# tuned:   %d static instructions, %.3f ms (score %.4f of %.4f)\n",
+             input, tried, base.staticCount, base.runMs,
+             best.staticCount, best.runMs, best.score, base.score);
+    if (writeTuneProfile(&best, profileOut, header) != 0) {
+        fprintf(stderr, "Error: Cannot write profile '%s'\n", profileOut);
+        goto done;
+    }
+    printf("✓ Best profile (%d static, %.3f ms) written to: %s\n", best.staticCount, best.runMs, profileOut);
+    status = 0;
+done:
+    removeTuneDir();
+    return status;
+}
+
 int main(int argc, char* argv[]) {
     const char* reportFile = "report.txt";
     FILE* report = fopen(reportFile, "w");
@@ -131,28 +385,72 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    if (argc != 3) {
-        printf("Usage: %s <input.c> <output.s>\n", argv[0]);
+    /* Options come before the two file names */
+    int argi = 1;
+    int superoptTraining = 0;
+    int autotune = 0;
+    int badProfile = 0;
+    while (argi < argc && argv[argi][0] == '-') {
+        if (strcmp(argv[argi], "-O2") == 0) {
+            optSetProfileOption("regalloc", "2");         /* graph coloring */
+        } else if (strcmp(argv[argi], "--superopt") == 0) {
+            superoptTraining = 1;
+        } else if (strcmp(argv[argi], "--tune") == 0) {
+            autotune = 1;
+        } else if (strcmp(argv[argi], "--peval") == 0) {
+            optSetProfileOption("peval-steps", "200000");  /* evaluation budget */
+        } else if (strcmp(argv[argi], "--memo") == 0) {
+            optSetProfileOption("memo-size", "1024");      /* entries per table */
+        } else if (strcmp(argv[argi], "--delayed-branches") == 0) {
+            optSetProfileOption("delay-slots", "1");       /* fill branch delay slots */
+        } else if (strncmp(argv[argi], "--profile=", 10) == 0) {
+            badProfile |= optLoadProfile(argv[argi] + 10) != 0;
+        } else {
+            fprintf(stderr, "Error: unknown option '%s'\n", argv[argi]);
+            argi = argc;
+            break;
+        }
+        argi++;
+    }
+
+    if (argc - argi != 2 || badProfile) {
+        printf("Usage: %s [options] <input.c> <output.s>\n", argv[0]);
+        printf("       %s --tune [--profile=<file>] <input.c> <profile-out>\n", argv[0]);
         printf("Example: ./minicompiler test.c output.s\n");
+        printf("  -O2               allocate registers by graph coloring instead of linear scan\n");
+        printf("  --superopt        search for new peephole rewrites and add them to %s\n",
+               SUPEROPT_TABLE_FILE);
+        printf("  --peval           run main at compile time as far as its inputs allow\n");
+        printf("  --memo            cache the results of pure recursive int functions\n");
+        printf("  --delayed-branches  emit for delayed branches (spim -delayed_branches), filling the slots\n");
+        printf("  --profile=<file>  take the optimizer pass order and thresholds from <file>\n");
+        printf("  --tune            search pass orders and thresholds for <input.c>, write the best profile\n");
         fprintf(report, "Compilation Report\n");
         fprintf(report, "Status: FAILED\n");
         fprintf(report, "Reason: invalid command-line arguments\n");
         fclose(report);
         return 1;
     }
+    const char* inputFile = argv[argi];
+    const char* outputFile = argv[argi + 1];
+
+    if (autotune) {
+        fclose(report);
+        return runAutotune(argv[0], inputFile, outputFile);
+    }
 
     time_t now = time(NULL);
     fprintf(report, "Compilation Report\n");
-    fprintf(report, "Input: %s\n", argv[1]);
-    fprintf(report, "Output: %s\n", argv[2]);
+    fprintf(report, "Input: %s\n", inputFile);
+    fprintf(report, "Output: %s\n", outputFile);
     if (now != (time_t)-1) {
         fprintf(report, "Timestamp: %s", ctime(&now));
     }
     fprintf(report, "\n");
     
-    yyin = fopen(argv[1], "r");
+    yyin = fopen(inputFile, "r");
     if (!yyin) {
-        fprintf(stderr, "Error: Cannot open input file '%s'\n", argv[1]);
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", inputFile);
         fprintf(report, "Status: FAILED\n");
         fprintf(report, "Reason: cannot open input file\n");
         fclose(report);
@@ -179,6 +477,8 @@ int main(int argc, char* argv[]) {
     init_string_pool();  /* Initialize string interning pool */
     initGlobalSymTab();  /* Initialize global symbol table */
     initSymTab();        /* Initialize symbol table */
+    superoptLoadTable(); /* Load the superoptimizer rewrite table */
+    superoptSetTraining(superoptTraining);
     end_benchmark(bench_init, "Phase 0: Initialization");
     phase0_ms = bench_init->wall_time * 1000.0;
     write_benchmark_line(report, "Phase 0: Initialization", bench_init);
@@ -188,7 +488,7 @@ int main(int argc, char* argv[]) {
     printf("┌──────────────────────────────────────────────────────────┐\n");
     printf("│ PHASE 1: LEXICAL & SYNTAX ANALYSIS                       │\n");
     printf("├──────────────────────────────────────────────────────────┤\n");
-    printf("│ • Reading source file: %s\n", argv[1]);                   
+    printf("│ • Reading source file: %s\n", inputFile);                   
     printf("│ • Tokenizing input (scanner.l)\n");
     printf("│ • Parsing grammar rules (parser.y)\n");
     printf("│ • Building Abstract Syntax Tree\n");
@@ -265,7 +565,7 @@ int main(int argc, char* argv[]) {
         double unopt_codegen_start = now_ms();
         generateMIPSFromUnoptimizedTAC2(unoptimizedMipsFile);
         double unopt_codegen_ms = now_ms() - unopt_codegen_start;
-        mips_unopt_count = countMIPSInstructionsFromFile(unoptimizedMipsFile);
+        mips_unopt_count = getLastMIPSInstructionCount();
         compile_unopt_ms = phase0_ms + phase1_ms + phase2_ms + phase3_ms + unopt_codegen_ms;
         
         /* PHASE 4: Optimization */
@@ -287,6 +587,11 @@ int main(int argc, char* argv[]) {
         phase4_ms = bench_opt->wall_time * 1000.0;
         write_benchmark_line(report, "Phase 4: Optimization", bench_opt);
         free(bench_opt);
+        if (superoptTraining) {
+            int rules = superoptSaveTable(SUPEROPT_TABLE_FILE);
+            if (rules >= 0) printf("✓ Superoptimizer table (%d rules) written to: %s\n", rules, SUPEROPT_TABLE_FILE);
+            else            printf("⚠ Cannot write superoptimizer table %s\n", SUPEROPT_TABLE_FILE);
+        }
         printf("✓ Optimized TAC written to: %s\n", optimizedTacFile);
         fprintf(report, "Optimized TAC file: %s\n", optimizedTacFile);
         printf("\n");
@@ -314,17 +619,17 @@ int main(int argc, char* argv[]) {
         printf("│ • System calls for print operations                      │\n");
         printf("└──────────────────────────────────────────────────────────┘\n");
         BenchmarkResult* bench_mips = start_benchmark();
-        generateMIPSFromOptimizedTAC2(argv[2]);
+        generateMIPSFromOptimizedTAC2(outputFile);
         end_benchmark(bench_mips, "Phase 5: MIPS Code Generation");
         phase5_ms = bench_mips->wall_time * 1000.0;
         write_benchmark_line(report, "Phase 5: MIPS Code Generation", bench_mips);
         free(bench_mips);
-        mips_opt_count = countMIPSInstructionsFromFile(argv[2]);
+        mips_opt_count = getLastMIPSInstructionCount();
         compile_opt_ms = phase0_ms + phase1_ms + phase2_ms + phase3_ms + phase4_ms + phase5_ms;
         fprintf(report, "AUDIT NOTE: MIPS codegen ALWAYS uses optimized TAC (%s).\n", optimizedTacFile);
         fprintf(report, "AUDIT NOTE: Unoptimized TAC (%s) is output for reference only and never used for codegen.\n", unoptimizedTacFile);
-        printf("✓ MIPS assembly code generated to: %s\n", argv[2]);
-        fprintf(report, "MIPS output file: %s\n", argv[2]);
+        printf("✓ MIPS assembly code generated to: %s\n", outputFile);
+        fprintf(report, "MIPS output file: %s\n", outputFile);
         printf("\n");
 
         /* PHASE 6: SPIM transcript capture */
@@ -336,7 +641,7 @@ int main(int argc, char* argv[]) {
 
         int spim_status_unopt = runSpimCaptureWithTiming(unoptimizedMipsFile, unoptimizedTranscriptFile, &sim_unopt_ms);
         BenchmarkResult* bench_spim = start_benchmark();
-        int spim_status = runSpimCaptureWithTiming(argv[2], transcriptFile, &sim_opt_ms);
+        int spim_status = runSpimCaptureWithTiming(outputFile, transcriptFile, &sim_opt_ms);
         end_benchmark(bench_spim, "Phase 6: SPIM Transcript Capture");
         write_benchmark_line(report, "Phase 6: SPIM Transcript Capture", bench_spim);
         free(bench_spim);
@@ -370,7 +675,7 @@ int main(int argc, char* argv[]) {
         int execution_comparable = (spim_status_unopt == 0 && spim_status == 0);
 
         fprintf(report, "\n===== Compiler Performance Report =====\n");
-        fprintf(report, "Source file       : %s\n\n", argv[1]);
+        fprintf(report, "Source file       : %s\n\n", inputFile);
         fprintf(report, "                     Unoptimized    Optimized    Reduction\n");
         fprintf(report, "TAC instructions : %10d %12d %10d%%\n", tac_unopt_count, tac_opt_count, tac_reduction);
         fprintf(report, "MIPS instructions: %10d %12d %10d%%\n", mips_unopt_count, mips_opt_count, mips_reduction);
@@ -3,7 +3,8 @@
 #include <string.h>
 #include "mips.h"
 
-MIPSInstr* createMIPS(MIPSOp op, char* result, char* arg1, char* arg2, char* comment) {
+MIPSInstr* createMIPS(MIPSOp op, const char* result, const char* arg1, const char* arg2,
+                      const char* comment) {
     MIPSInstr* instr = malloc(sizeof(MIPSInstr));
     instr->op = op;
     instr->result = result ? strdup(result) : NULL;
@@ -23,282 +24,131 @@ void appendMIPS(MIPSList* list, MIPSInstr* instr) {
     }
 }
 
+/* Operand layout and properties of each opcode.  Printed operands are
+ * result, arg1, arg2 in order (MIPS_SHAPE_DST), only arg1, arg2
+ * (MIPS_SHAPE_SRC), or arg1 then result (mtc1). */
+enum { MIPS_SHAPE_NONE, MIPS_SHAPE_DST, MIPS_SHAPE_SRC, MIPS_SHAPE_MTC1 };
+
+#define MIPS_READS_RESULT 1   /* result is read (stores, branches, movn) */
+#define MIPS_CONTROL      2   /* control transfer, syscall or label */
+#define MIPS_NO_DEF       4   /* writes no register named by result */
+#define MIPS_PSEUDO       8   /* assembles to more than one instruction */
+
+typedef struct {
+    MIPSOp      op;
+    const char* name;
+    int         shape;
+    int         flags;
+} MIPSOpInfo;
+
+static const MIPSOpInfo mipsOps[] = {
+    { MIPS_LI,        "li",        MIPS_SHAPE_DST,  0 },
+    { MIPS_LW,        "lw",        MIPS_SHAPE_DST,  0 },
+    { MIPS_SW,        "sw",        MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_NO_DEF },
+    { MIPS_L_S,       "l.s",       MIPS_SHAPE_DST,  0 },
+    { MIPS_S_S,       "s.s",       MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_NO_DEF },
+    { MIPS_ADD,       "add",       MIPS_SHAPE_DST,  0 },
+    { MIPS_SUB,       "sub",       MIPS_SHAPE_DST,  0 },
+    { MIPS_MUL,       "mult",      MIPS_SHAPE_SRC,  MIPS_NO_DEF },
+    { MIPS_DIV,       "div",       MIPS_SHAPE_SRC,  MIPS_NO_DEF },
+    { MIPS_MFLO,      "mflo",      MIPS_SHAPE_DST,  0 },
+    { MIPS_ADDI,      "addi",      MIPS_SHAPE_DST,  0 },
+    { MIPS_ADD_S,     "add.s",     MIPS_SHAPE_DST,  0 },
+    { MIPS_SUB_S,     "sub.s",     MIPS_SHAPE_DST,  0 },
+    { MIPS_MUL_S,     "mul.s",     MIPS_SHAPE_DST,  0 },
+    { MIPS_DIV_S,     "div.s",     MIPS_SHAPE_DST,  0 },
+    { MIPS_MTC1,      "mtc1",      MIPS_SHAPE_MTC1, 0 },
+    { MIPS_MFC1,      "mfc1",      MIPS_SHAPE_DST,  0 },
+    { MIPS_CVT_S_W,   "cvt.s.w",   MIPS_SHAPE_DST,  0 },
+    { MIPS_TRUNC_W_S, "trunc.w.s", MIPS_SHAPE_DST,  0 },
+    { MIPS_MOVE,      "move",      MIPS_SHAPE_DST,  0 },
+    { MIPS_MOV_S,     "mov.s",     MIPS_SHAPE_DST,  0 },
+    { MIPS_JAL,       "jal",       MIPS_SHAPE_SRC,  MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_JR,        "jr",        MIPS_SHAPE_SRC,  MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_LABEL,     NULL,        MIPS_SHAPE_SRC,  MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_SYSCALL,   "syscall",   MIPS_SHAPE_NONE, MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_COMMENT,   NULL,        MIPS_SHAPE_NONE, MIPS_NO_DEF },
+    { MIPS_BEQZ,      "beqz",      MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BLTZ,      "bltz",      MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BGE,       "bge",       MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF | MIPS_PSEUDO },
+    { MIPS_J,         "j",         MIPS_SHAPE_SRC,  MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_LA,        "la",        MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_LI_S,      "li.s",      MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_ADDIU,     "addiu",     MIPS_SHAPE_DST,  0 },
+    { MIPS_ADDU,      "addu",      MIPS_SHAPE_DST,  0 },
+    { MIPS_SUBU,      "subu",      MIPS_SHAPE_DST,  0 },
+    { MIPS_SLL,       "sll",       MIPS_SHAPE_DST,  0 },
+    { MIPS_SLT,       "slt",       MIPS_SHAPE_DST,  0 },
+    { MIPS_SLTI,      "slti",      MIPS_SHAPE_DST,  0 },
+    { MIPS_SLTU,      "sltu",      MIPS_SHAPE_DST,  0 },
+    { MIPS_SLTIU,     "sltiu",     MIPS_SHAPE_DST,  0 },
+    { MIPS_SEQ,       "seq",       MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_SNE,       "sne",       MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_SGT,       "sgt",       MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_SLE,       "sle",       MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_SGE,       "sge",       MIPS_SHAPE_DST,  MIPS_PSEUDO },
+    { MIPS_XORI,      "xori",      MIPS_SHAPE_DST,  0 },
+    { MIPS_MOVN,      "movn",      MIPS_SHAPE_DST,  MIPS_READS_RESULT },
+    { MIPS_BNEZ,      "bnez",      MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BEQ,       "beq",       MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BNE,       "bne",       MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BGEZ,      "bgez",      MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BGTZ,      "bgtz",      MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_BLEZ,      "blez",      MIPS_SHAPE_DST,  MIPS_READS_RESULT | MIPS_CONTROL | MIPS_NO_DEF },
+    { MIPS_NOP,       "nop",       MIPS_SHAPE_NONE, MIPS_NO_DEF },
+    { MIPS_DIRECTIVE, NULL,        MIPS_SHAPE_SRC,  MIPS_NO_DEF },
+};
+
+static const MIPSOpInfo* mipsInfo(MIPSOp op) {
+    for (size_t k = 0; k < sizeof(mipsOps) / sizeof(mipsOps[0]); k++)
+        if (mipsOps[k].op == op) return &mipsOps[k];
+    return &mipsOps[0];
+}
+
+/* Instructions only: labels, directives and comments are not counted */
 int countMIPSInstructions(MIPSList* list) {
     int count = 0;
     MIPSInstr* curr = list->head;
     while (curr) {
-        count++;
+        if (curr->op != MIPS_LABEL && curr->op != MIPS_DIRECTIVE && curr->op != MIPS_COMMENT)
+            count++;
         curr = curr->next;
     }
     return count;
 }
 
 void printMIPS(MIPSList* list, FILE* output) {
-    MIPSInstr* curr = list->head;
-    while (curr) {
-        switch(curr->op) {
-            case MIPS_LI:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    li %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    li %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_LW:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    lw %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    lw %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_SW:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    sw %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    sw %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_L_S:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    l.s %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    l.s %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_S_S:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    s.s %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    s.s %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_ADD:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    add %s, %s, %s    # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    add %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_SUB:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    sub %s, %s, %s    # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    sub %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_MUL:
-                if (curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    mult %s, %s       # %s\n", curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    mult %s, %s\n", curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_DIV:
-                if (curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    div %s, %s        # %s\n", curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    div %s, %s\n", curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_MFLO:
-                if (curr->result) {
-                    if (curr->comment) {
-                        fprintf(output, "    mflo %s           # %s\n", curr->result, curr->comment);
-                    } else {
-                        fprintf(output, "    mflo %s\n", curr->result);
-                    }
-                }
-                break;
-            case MIPS_ADD_S:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    add.s %s, %s, %s  # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    add.s %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_SUB_S:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    sub.s %s, %s, %s  # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    sub.s %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_MUL_S:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    mul.s %s, %s, %s  # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    mul.s %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_DIV_S:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    div.s %s, %s, %s  # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    div.s %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_MTC1:
-                if (curr->arg1 && curr->result) {
-                    if (curr->comment) {
-                        fprintf(output, "    mtc1 %s, %s        # %s\n", curr->arg1, curr->result, curr->comment);
-                    } else {
-                        fprintf(output, "    mtc1 %s, %s\n", curr->arg1, curr->result);
-                    }
-                }
-                break;
-            case MIPS_MFC1:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    mfc1 %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    mfc1 %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_CVT_S_W:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    cvt.s.w %s, %s     # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    cvt.s.w %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_TRUNC_W_S:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    trunc.w.s %s, %s  # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    trunc.w.s %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_MOVE:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    move %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    move %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_MOV_S:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    mov.s %s, %s       # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    mov.s %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_ADDI:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    addi %s, %s, %s    # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    addi %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
-            case MIPS_SYSCALL:
-                if (curr->comment) {
-                    fprintf(output, "    syscall            # %s\n", curr->comment);
-                } else {
-                    fprintf(output, "    syscall\n");
-                }
-                break;
-            case MIPS_COMMENT:
-                if (curr->comment) {
-                    fprintf(output, "    # %s\n", curr->comment);
-                } else {
-                    // Skip NULL comments entirely
-                }
-                break;
-            case MIPS_JAL:
-                if (curr->arg1 && curr->arg1[0] != '\0') {
-                    if (curr->comment) {
-                        fprintf(output, "    jal %s  # %s\n", curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    jal %s\n", curr->arg1);
-                    }
-                } else {
-                    // Skip NULL function calls entirely
-                }
-                break;
-            case MIPS_JR:
-                if (curr->arg1 && curr->arg1[0] != '\0') {
-                    if (curr->comment) {
-                        fprintf(output, "    jr %s  # %s\n", curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    jr %s\n", curr->arg1);
-                    }
-                } else {
-                    // Skip NULL jump instructions entirely
-                }
-                break;
-            case MIPS_LABEL:
-                if (curr->arg1) {
-                    fprintf(output, "\n%s:\n", curr->arg1);
-                    if (curr->comment) {
-                        fprintf(output, "    # %s\n", curr->comment);
-                    }
-                }
-                break;
-            case MIPS_BEQZ:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    beqz %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    beqz %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_BLTZ:
-                if (curr->result && curr->arg1) {
-                    if (curr->comment) {
-                        fprintf(output, "    bltz %s, %s        # %s\n", curr->result, curr->arg1, curr->comment);
-                    } else {
-                        fprintf(output, "    bltz %s, %s\n", curr->result, curr->arg1);
-                    }
-                }
-                break;
-            case MIPS_BGE:
-                if (curr->result && curr->arg1 && curr->arg2) {
-                    if (curr->comment) {
-                        fprintf(output, "    bge %s, %s, %s    # %s\n", curr->result, curr->arg1, curr->arg2, curr->comment);
-                    } else {
-                        fprintf(output, "    bge %s, %s, %s\n", curr->result, curr->arg1, curr->arg2);
-                    }
-                }
-                break;
+    for (MIPSInstr* curr = list->head; curr; curr = curr->next) {
+        const MIPSOpInfo* info = mipsInfo(curr->op);
+        switch (curr->op) {
+        case MIPS_LABEL:
+            fprintf(output, "%s:", curr->arg1);
+            break;
+        case MIPS_DIRECTIVE:
+            if (curr->result) fprintf(output, "%s: ", curr->result);
+            fputs(curr->arg1, output);
+            break;
+        case MIPS_COMMENT:
+            fputs("   ", output);   /* the comment itself follows */
+            break;
+        default: {
+            const char* operand[3];
+            int n = 0;
+            if (info->shape == MIPS_SHAPE_MTC1) {
+                operand[n++] = curr->arg1;
+                operand[n++] = curr->result;
+            } else {
+                if (info->shape == MIPS_SHAPE_DST && curr->result) operand[n++] = curr->result;
+                if (curr->arg1) operand[n++] = curr->arg1;
+                if (curr->arg2) operand[n++] = curr->arg2;
+            }
+            fprintf(output, "    %s", info->name);
+            for (int k = 0; k < n; k++) fprintf(output, "%s%s", k ? ", " : " ", operand[k]);
+            break;
         }
-        curr = curr->next;
+        }
+        if (curr->comment) fprintf(output, "    # %s", curr->comment);
+        fputc('\n', output);
     }
 }
 
@@ -316,3 +166,450 @@ void freeMIPSList(MIPSList* list) {
     list->head = NULL;
     list->tail = NULL;
 }
+
+/* ─── Peephole optimization ─── */
+
+static int sameStr(const char* a, const char* b) {
+    return a && b && strcmp(a, b) == 0;
+}
+
+static void freeMIPSInstr(MIPSInstr* instr) {
+    free(instr->result);
+    free(instr->arg1);
+    free(instr->arg2);
+    free(instr->comment);
+    free(instr);
+}
+
+/* Unlink the instruction after prev (the head when prev is NULL) */
+static MIPSInstr* unlinkMIPSAfter(MIPSList* list, MIPSInstr* prev) {
+    MIPSInstr* instr = prev ? prev->next : list->head;
+    if (prev) prev->next = instr->next;
+    else list->head = instr->next;
+    if (list->tail == instr) list->tail = prev;
+    instr->next = NULL;
+    return instr;
+}
+
+static void removeMIPSAfter(MIPSList* list, MIPSInstr* prev) {
+    freeMIPSInstr(unlinkMIPSAfter(list, prev));
+}
+
+static void insertMIPSAfter(MIPSList* list, MIPSInstr* prev, MIPSInstr* instr) {
+    instr->next = prev->next;
+    prev->next = instr;
+    if (list->tail == prev) list->tail = instr;
+}
+
+/* Rewrite instr in place as op result, arg1, arg2 */
+static void setMIPS(MIPSInstr* instr, MIPSOp op, const char* result, const char* arg1, const char* arg2) {
+    char* r = result ? strdup(result) : NULL;
+    char* a1 = arg1 ? strdup(arg1) : NULL;
+    char* a2 = arg2 ? strdup(arg2) : NULL;
+    free(instr->result);
+    free(instr->arg1);
+    free(instr->arg2);
+    instr->op = op;
+    instr->result = r;
+    instr->arg1 = a1;
+    instr->arg2 = a2;
+}
+
+/* Is reg the base register of address operand addr, "off(base)"? */
+static int isBase(const char* addr, const char* reg) {
+    const char* open = addr ? strchr(addr, '(') : NULL;
+    size_t n = strlen(reg);
+    return open && strncmp(open + 1, reg, n) == 0 && open[1 + n] == ')';
+}
+
+/* Is reg one of the registers instr reads through its operands? */
+static int mipsUses(MIPSInstr* instr, const char* reg) {
+    if ((mipsInfo(instr->op)->flags & MIPS_READS_RESULT) && sameStr(instr->result, reg)) return 1;
+    return sameStr(instr->arg1, reg) || sameStr(instr->arg2, reg) || isBase(instr->arg1, reg);
+}
+
+/* Does instr read register reg?  -1 when it cannot tell (control flow
+ * and syscalls end the scan). */
+static int mipsReads(MIPSInstr* instr, const char* reg) {
+    if (mipsInfo(instr->op)->flags & MIPS_CONTROL) return -1;
+    return mipsUses(instr, reg);
+}
+
+static int mipsWrites(MIPSInstr* instr, const char* reg) {
+    return !(mipsInfo(instr->op)->flags & MIPS_NO_DEF) && sameStr(instr->result, reg);
+}
+
+/* Is reg overwritten before it is read, within the straight-line code
+ * from instr on? */
+static int deadFrom(MIPSInstr* instr, const char* reg) {
+    for (; instr; instr = instr->next) {
+        int r = mipsReads(instr, reg);
+        if (r != 0) return 0;
+        if (mipsWrites(instr, reg)) return 1;
+    }
+    return 0;
+}
+
+/* A value of at most 16 signed bits */
+static int isImm16(const char* s) {
+    char* end;
+    long v = strtol(s, &end, 10);
+    return *s && *end == '\0' && v >= -32768 && v <= 32767;
+}
+
+/* sw r, X ; lw r2, X  →  sw r, X ; move r2, r  (dropped when r2 == r) */
+static int peepStoreLoad(MIPSList* list, MIPSInstr* a, MIPSInstr* b) {
+    if (!sameStr(a->arg1, b->arg1)) return 0;
+    if (sameStr(a->result, b->result)) removeMIPSAfter(list, a);
+    else setMIPS(b, b->op == MIPS_LW ? MIPS_MOVE : MIPS_MOV_S, b->result, a->result, NULL);
+    return 1;
+}
+
+/* li r, c ; add d, x, r  →  addi d, x, c  when r dies there
+ * (and sub d, x, r  →  addi d, x, -c) */
+static int peepLiArith(MIPSList* list, MIPSInstr* a, MIPSInstr* b) {
+    const char* r = a->result;
+    const char* x;
+    if (sameStr(b->arg2, r) && !sameStr(b->arg1, r)) x = b->arg1;
+    else if (b->op == MIPS_ADD && sameStr(b->arg1, r) && !sameStr(b->arg2, r)) x = b->arg2;
+    else return 0;
+    char imm[32];
+    if (b->op == MIPS_SUB) {
+        if (!isImm16(a->arg1) || strtol(a->arg1, NULL, 10) == -32768) return 0;
+        snprintf(imm, sizeof(imm), "%ld", -strtol(a->arg1, NULL, 10));
+    } else {
+        if (!isImm16(a->arg1)) return 0;
+        snprintf(imm, sizeof(imm), "%s", a->arg1);
+    }
+    if (!sameStr(b->result, r) && !deadFrom(b->next, r)) return 0;
+    setMIPS(a, MIPS_ADDI, b->result, x, imm);
+    removeMIPSAfter(list, a);
+    return 1;
+}
+
+/* j L ; L:  →  L:  (and conditional branches to the next label,
+ * whose target is their last operand) */
+static int peepBranchToNext(MIPSList* list, MIPSInstr* a, MIPSInstr* b) {
+    (void)list;
+    const char* target = a->arg2 ? a->arg2 : a->arg1;
+    return sameStr(target, b->arg1) ? -1 : 0;
+}
+
+/* move r, r  →  (nothing) */
+static int peepSelfMove(MIPSList* list, MIPSInstr* a, MIPSInstr* b) {
+    (void)list; (void)b;
+    return sameStr(a->result, a->arg1) ? -1 : 0;
+}
+
+/* Rules match the window (first, second), second -1 matching anything
+ * including the end of the list.  A rule returns 1 after rewriting the
+ * window, -1 to have the first instruction deleted, 0 if it does not
+ * apply. */
+typedef struct {
+    MIPSOp first;
+    int    second;
+    int (*apply)(MIPSList* list, MIPSInstr* a, MIPSInstr* b);
+} PeepRule;
+
+static const PeepRule peepRules[] = {
+    { MIPS_SW,    MIPS_LW,      peepStoreLoad },
+    { MIPS_S_S,   MIPS_L_S,     peepStoreLoad },
+    { MIPS_LI,    MIPS_ADD,     peepLiArith },
+    { MIPS_LI,    MIPS_SUB,     peepLiArith },
+    { MIPS_J,     MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BEQZ,  MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BNEZ,  MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BEQ,   MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BNE,   MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BLTZ,  MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BGEZ,  MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BGTZ,  MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BLEZ,  MIPS_LABEL,   peepBranchToNext },
+    { MIPS_BGE,   MIPS_LABEL,   peepBranchToNext },
+    { MIPS_MOVE,  -1,           peepSelfMove },
+    { MIPS_MOV_S, -1,           peepSelfMove },
+};
+#define NUM_PEEP_RULES ((int)(sizeof(peepRules) / sizeof(peepRules[0])))
+
+int peepholeMIPS(MIPSList* list) {
+    int total = 0, changed = 1;
+    while (changed) {
+        changed = 0;
+        MIPSInstr* prev = NULL;
+        MIPSInstr* a = list->head;
+        while (a) {
+            MIPSInstr* b = a->next;
+            int done = 0;
+            for (int k = 0; k < NUM_PEEP_RULES && !done; k++) {
+                const PeepRule* r = &peepRules[k];
+                if (a->op != r->first) continue;
+                if (r->second >= 0 && (!b || (int)b->op != r->second)) continue;
+                done = r->apply(list, a, b);
+            }
+            if (done < 0) removeMIPSAfter(list, prev);
+            if (done) {
+                total++;
+                changed = 1;
+                a = prev ? prev->next : list->head;   /* re-match the new window */
+                continue;
+            }
+            prev = a;
+            a = a->next;
+        }
+    }
+    return total;
+}
+
+/* ─── Branch delay slots ─── */
+
+static int isBranch(MIPSOp op) {
+    return (mipsInfo(op)->flags & MIPS_CONTROL) && op != MIPS_LABEL && op != MIPS_SYSCALL;
+}
+
+static int isMemOp(MIPSOp op) {
+    return op == MIPS_LW || op == MIPS_SW || op == MIPS_L_S || op == MIPS_S_S;
+}
+
+/* Register written by instr, NULL if none ($ra for jal) */
+static const char* mipsDef(MIPSInstr* instr) {
+    if (instr->op == MIPS_JAL) return "$ra";
+    return (mipsInfo(instr->op)->flags & MIPS_NO_DEF) ? NULL : instr->result;
+}
+
+static int immFits(const char* s, long lo, long hi) {
+    char* end;
+    long v = s ? strtol(s, &end, 10) : 0;
+    return s && *s && *end == '\0' && v >= lo && v <= hi;
+}
+
+/* Can instr sit in a delay slot?  It must be one machine instruction,
+ * and hi/lo traffic stays where it is.  SPIM expands a negative li and
+ * an immediate sub or subu through $at, so those stay out. */
+static int slotSafe(MIPSInstr* instr) {
+    int flags = mipsInfo(instr->op)->flags;
+    if (flags & (MIPS_CONTROL | MIPS_PSEUDO)) return 0;
+    switch (instr->op) {
+    case MIPS_COMMENT: case MIPS_DIRECTIVE: case MIPS_NOP:
+    case MIPS_MUL: case MIPS_DIV: case MIPS_MFLO:
+        return 0;
+    case MIPS_LI:
+        return immFits(instr->arg1, 0, 32767);
+    case MIPS_LW: case MIPS_SW: case MIPS_L_S: case MIPS_S_S: {
+        const char* open = instr->arg1 ? strchr(instr->arg1, '(') : NULL;
+        if (!open) return 0;
+        if (open == instr->arg1) return 1;
+        char disp[32];
+        size_t n = (size_t)(open - instr->arg1);
+        if (n >= sizeof(disp)) return 0;
+        memcpy(disp, instr->arg1, n);
+        disp[n] = '\0';
+        return immFits(disp, -32768, 32767);
+    }
+    case MIPS_XORI:
+        return immFits(instr->arg2, 0, 65535);
+    case MIPS_SLL: case MIPS_MOVN:
+        return 1;
+    case MIPS_SUB: case MIPS_SUBU:
+        return !instr->arg2 || instr->arg2[0] == '$';
+    default:
+        if (instr->arg2 && instr->arg2[0] != '$') return immFits(instr->arg2, -32768, 32767);
+        return 1;
+    }
+}
+
+/* May x move below y without changing what either computes? */
+static int mayPass(MIPSInstr* x, MIPSInstr* y) {
+    if (y->op == MIPS_COMMENT) return 1;
+    const char* dx = mipsDef(x);
+    const char* dy = mipsDef(y);
+    if (dx && (mipsUses(y, dx) || sameStr(dx, dy))) return 0;
+    if (dy && mipsUses(x, dy)) return 0;
+    if (isMemOp(x->op) && isMemOp(y->op) &&
+        (x->op == MIPS_SW || x->op == MIPS_S_S || y->op == MIPS_SW || y->op == MIPS_S_S)) return 0;
+    return 1;
+}
+
+static char** branchTarget(MIPSInstr* br) {
+    return br->arg2 ? &br->arg2 : &br->arg1;
+}
+
+static MIPSInstr* findLabel(MIPSList* list, const char* name) {
+    for (MIPSInstr* i = list->head; i; i = i->next)
+        if (i->op == MIPS_LABEL && sameStr(i->arg1, name)) return i;
+    return NULL;
+}
+
+/* Registers a call or return leaves undefined for the code after it:
+ * temporaries and the float scratch registers outside the argument
+ * pair (at a return, the argument registers as well) */
+static int clobberedBy(MIPSOp op, const char* reg) {
+    if (strncmp(reg, "$t", 2) == 0) return 1;
+    if (op == MIPS_JR && strncmp(reg, "$a", 2) == 0) return 1;
+    if (strncmp(reg, "$f", 2) != 0) return 0;
+    int f = atoi(reg + 2);
+    return f >= 4 && f <= 19 && (op == MIPS_JR || (f != 12 && f != 14));
+}
+
+/* Labels already searched by deadOnPaths; a path reaching one again
+ * adds nothing new */
+#define DEAD_MAX_LABELS 32
+
+typedef struct {
+    MIPSInstr* seen[DEAD_MAX_LABELS];
+    int        n;
+} DeadSearch;
+
+/* Mark label searched: 1 if it already was, -1 when out of room, else 0 */
+static int deadVisit(DeadSearch* ds, MIPSInstr* label) {
+    for (int k = 0; k < ds->n; k++)
+        if (ds->seen[k] == label) return 1;
+    if (ds->n == DEAD_MAX_LABELS) return -1;
+    ds->seen[ds->n++] = label;
+    return 0;
+}
+
+/* Is reg written before it is read along every path from instr?  Jumps
+ * and both arms of branches are followed; the instruction after a
+ * branch may already be its slot, so it must not read reg either.
+ * Nothing runs past the end of the list (main exits first). */
+static int deadOnPaths(MIPSList* list, MIPSInstr* instr, const char* reg, DeadSearch* ds) {
+    for (; instr; instr = instr->next) {
+        switch (instr->op) {
+        case MIPS_LABEL: {
+            int seen = deadVisit(ds, instr);
+            if (seen) return seen > 0;
+            continue;
+        }
+        case MIPS_COMMENT: case MIPS_NOP:
+            continue;
+        case MIPS_SYSCALL:   /* reads $v0 and the argument registers */
+            if (sameStr(reg, "$v0") || sameStr(reg, "$a0") || sameStr(reg, "$a1") ||
+                sameStr(reg, "$f12")) return 0;
+            continue;
+        case MIPS_JR: case MIPS_JAL:
+            if (mipsUses(instr, reg) || (instr->next && mipsUses(instr->next, reg))) return 0;
+            return clobberedBy(instr->op, reg);
+        default:
+            break;
+        }
+        if (!isBranch(instr->op)) {
+            if (mipsUses(instr, reg)) return 0;
+            if (mipsWrites(instr, reg)) return 1;
+            continue;
+        }
+        if (mipsUses(instr, reg) || (instr->next && mipsUses(instr->next, reg))) return 0;
+        MIPSInstr* label = findLabel(list, *branchTarget(instr));
+        if (!label) return 0;
+        if (instr->op == MIPS_J) {
+            int seen = deadVisit(ds, label);   /* the loop steps past it */
+            if (seen) return seen > 0;
+            instr = label;
+            continue;
+        }
+        if (!deadOnPaths(list, label, reg, ds)) return 0;
+    }
+    return 1;   /* past the end of the program */
+}
+
+/* A conditional branch's slot also runs on the path that did not ask
+ * for x, so x must be free of side effects and its result dead there */
+static int harmlessOn(MIPSList* list, MIPSInstr* x, MIPSInstr* path) {
+    const char* d = mipsDef(x);
+    DeadSearch ds = { .n = 0 };
+    return !isMemOp(x->op) && d && deadOnPaths(list, path, d, &ds);
+}
+
+/* Fill from before the branch: the latest instruction of the block
+ * that everything after it, the branch included, lets through.  block
+ * holds the instructions since anchor (NULL: the list head). */
+static MIPSInstr* slotFromBefore(MIPSList* list, MIPSInstr** block, int n,
+                                 MIPSInstr* anchor, MIPSInstr* br) {
+    for (int i = n - 1; i >= 0; i--) {
+        MIPSInstr* x = block[i];
+        if (!slotSafe(x) || !mayPass(x, br)) continue;
+        int ok = 1;
+        for (int j = i + 1; j < n && ok; j++) ok = mayPass(x, block[j]);
+        if (ok) return unlinkMIPSAfter(list, i > 0 ? block[i - 1] : anchor);
+    }
+    return NULL;
+}
+
+/* Fill from the target: copy its first instruction into the slot and
+ * branch past it, to a new label unless one is already there */
+static MIPSInstr* slotFromTarget(MIPSList* list, MIPSInstr* br, int* labels) {
+    if (br->op == MIPS_JAL || br->op == MIPS_JR) return NULL;
+    MIPSInstr* label = findLabel(list, *branchTarget(br));
+    MIPSInstr* x = label ? label->next : NULL;
+    if (!x || !slotSafe(x)) return NULL;
+    if (br->op != MIPS_J && !harmlessOn(list, x, br->next)) return NULL;
+    MIPSInstr* after = x->next;
+    if (!after || after->op != MIPS_LABEL) {
+        char name[32];
+        snprintf(name, sizeof(name), "Lds%d", (*labels)++);
+        after = createMIPS(MIPS_LABEL, NULL, name, NULL, NULL);
+        insertMIPSAfter(list, x, after);
+    }
+    free(*branchTarget(br));
+    *branchTarget(br) = strdup(after->arg1);
+    return createMIPS(x->op, x->result, x->arg1, x->arg2, NULL);
+}
+
+/* Fill from the fall-through: hoist the next instruction when the
+ * taken path does not need the register it writes.  One that could
+ * fill the slot of a branch right after it is left for that one. */
+static MIPSInstr* slotFromFallThrough(MIPSList* list, MIPSInstr* br) {
+    if (br->op == MIPS_J || br->op == MIPS_JAL || br->op == MIPS_JR) return NULL;
+    MIPSInstr* x = br->next;
+    MIPSInstr* label = findLabel(list, *branchTarget(br));
+    if (!x || !label || !slotSafe(x) || (x->next && isBranch(x->next->op) && mayPass(x, x->next))) return NULL;
+    if (!harmlessOn(list, x, label->next)) return NULL;
+    return unlinkMIPSAfter(list, br);
+}
+
+/* Does br jump forward?  Those are taken for exits and skipped arms,
+ * so the fall-through is the better guess for the hot path. */
+static int jumpsForward(MIPSInstr* br) {
+    for (MIPSInstr* i = br->next; i; i = i->next)
+        if (i->op == MIPS_LABEL && sameStr(i->arg1, *branchTarget(br))) return 1;
+    return 0;
+}
+
+#define SLOT_WINDOW 16
+
+int fillDelaySlotsMIPS(MIPSList* list, int schedule) {
+    MIPSInstr* block[SLOT_WINDOW];
+    int n = 0, filled = 0, labels = 0;
+    MIPSInstr* anchor = NULL;
+    MIPSInstr* instr = list->head;
+    while (instr) {
+        if (!isBranch(instr->op)) {
+            if (instr->op == MIPS_LABEL || instr->op == MIPS_SYSCALL || instr->op == MIPS_DIRECTIVE) {
+                anchor = instr;
+                n = 0;
+            } else {
+                if (n == SLOT_WINDOW) {
+                    anchor = block[0];
+                    memmove(block, block + 1, sizeof(block[0]) * --n);
+                }
+                block[n++] = instr;
+            }
+            instr = instr->next;
+            continue;
+        }
+        MIPSInstr* slot = NULL;
+        if (schedule) {
+            int forward = jumpsForward(instr);
+            slot = slotFromBefore(list, block, n, anchor, instr);
+            if (!slot && forward) slot = slotFromFallThrough(list, instr);
+            if (!slot) slot = slotFromTarget(list, instr, &labels);
+            if (!slot && !forward) slot = slotFromFallThrough(list, instr);
+        }
+        if (slot) filled++;
+        else slot = createMIPS(MIPS_NOP, NULL, NULL, NULL, NULL);
+        insertMIPSAfter(list, instr, slot);
+        anchor = slot;
+        n = 0;
+        instr = slot->next;
+    }
+    return filled;
+}
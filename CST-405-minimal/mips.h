@@ -31,7 +31,33 @@ typedef enum {
     MIPS_COMMENT,   /* Comment line */
     MIPS_BEQZ,      /* Branch if equal to zero: beqz $reg, label */
     MIPS_BLTZ,      /* Branch if less than zero: bltz $reg, label */
-    MIPS_BGE        /* Branch if greater or equal: bge $reg1, $reg2, label */
+    MIPS_BGE,       /* Branch if greater or equal: bge $reg1, $reg2, label */
+    MIPS_J,         /* Unconditional jump: j label */
+    MIPS_LA,        /* Load address: la $reg, label */
+    MIPS_LI_S,      /* Load float immediate: li.s $freg, value */
+    MIPS_ADDIU,     /* Add immediate unsigned: addiu $dst, $src, imm */
+    MIPS_ADDU,      /* Add unsigned: addu $dst, $src1, $src2 */
+    MIPS_SUBU,      /* Subtract unsigned: subu $dst, $src1, $src2 */
+    MIPS_SLL,       /* Shift left logical: sll $dst, $src, shamt */
+    MIPS_SLT,       /* Set on less than: slt $dst, $src1, $src2 */
+    MIPS_SLTI,      /* Set on less than immediate: slti $dst, $src, imm */
+    MIPS_SLTU,      /* Set on less than unsigned: sltu $dst, $src1, $src2 */
+    MIPS_SLTIU,     /* Set on less than immediate unsigned: sltiu $dst, $src, imm */
+    MIPS_SEQ,       /* Set on equal: seq $dst, $src1, $src2 */
+    MIPS_SNE,       /* Set on not equal: sne $dst, $src1, $src2 */
+    MIPS_SGT,       /* Set on greater than: sgt $dst, $src1, $src2 */
+    MIPS_SLE,       /* Set on less or equal: sle $dst, $src1, $src2 */
+    MIPS_SGE,       /* Set on greater or equal: sge $dst, $src1, $src2 */
+    MIPS_XORI,      /* Exclusive or immediate: xori $dst, $src, imm */
+    MIPS_MOVN,      /* Move if not zero: movn $dst, $src, $cond */
+    MIPS_BNEZ,      /* Branch if not zero: bnez $reg, label */
+    MIPS_BEQ,       /* Branch if equal: beq $reg1, $reg2, label */
+    MIPS_BNE,       /* Branch if not equal: bne $reg1, $reg2, label */
+    MIPS_BGEZ,      /* Branch if >= 0: bgez $reg, label */
+    MIPS_BGTZ,      /* Branch if > 0: bgtz $reg, label */
+    MIPS_BLEZ,      /* Branch if <= 0: blez $reg, label */
+    MIPS_NOP,       /* No operation (fills a branch delay slot) */
+    MIPS_DIRECTIVE  /* Assembler directive: [result:] arg1, e.g. .asciiz "..." */
 } MIPSOp;
 
 /* MIPS INSTRUCTION STRUCTURE */
@@ -51,10 +77,28 @@ typedef struct {
 } MIPSList;
 
 /* MIPS GENERATION FUNCTIONS */
-MIPSInstr* createMIPS(MIPSOp op, char* result, char* arg1, char* arg2, char* comment);
+MIPSInstr* createMIPS(MIPSOp op, const char* result, const char* arg1, const char* arg2,
+                      const char* comment);
 void appendMIPS(MIPSList* list, MIPSInstr* instr);
-int countMIPSInstructions(MIPSList* list);
+int countMIPSInstructions(MIPSList* list);                  /* labels, directives, comments excluded */
 void printMIPS(MIPSList* list, FILE* output);
 void freeMIPSList(MIPSList* list);
 
+/* PEEPHOLE OPTIMIZATION
+ * Slides a two-instruction window over the list and applies the first
+ * matching rule from a table (store/load forwarding, li folded into
+ * addi, jumps to the next label, moves to self) until nothing changes.
+ * Returns the number of rewrites.
+ */
+int peepholeMIPS(MIPSList* list);
+
+/* BRANCH DELAY SLOTS
+ * For targets that execute the instruction after every branch or jump.
+ * With schedule set, each slot takes an independent instruction from
+ * before the branch, else a copy of the target's first instruction,
+ * else the fall-through's first one when the other path does not need
+ * it; slots left over get a nop.  Returns the number of slots filled.
+ */
+int fillDelaySlotsMIPS(MIPSList* list, int schedule);
+
 #endif
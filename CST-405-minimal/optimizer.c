@@ -2,10 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdarg.h>
 #include "optimizer.h"
 #include "mips.h"
 #include "symtab.h"
 #include "tac.h"
+#include "liveness.h"
+#include "superopt.h"
 
 /* External declarations */
 extern TACList tacList;
@@ -120,6 +123,4180 @@ static const char* propLookup(const char* name,
     return name;
 }
 
+/* =========================================================
+ * POST-PASS HELPERS
+ * The passes below run over optimizedList after the main
+ * traversal.  They work one function at a time; a function is
+ * the run of instructions from a FUNC_DEF up to (not including)
+ * the next FUNC_DEF.
+ * ========================================================= */
+#define OPT_MAX_FUNC_INSTRS 4096
+#define OPT_MAX_PARAMS      16
+
+static int optSame(const char* a, const char* b) {
+    return a && b && strcmp(a, b) == 0;
+}
+
+/* Collect the instructions of the function starting at fn into out[].
+ * Returns -1 when there are more than max: a pass that cannot see the
+ * whole function leaves it alone rather than rewrite a prefix of it. */
+static int optCollectFunc(TACInstr* fn, TACInstr** out, int max) {
+    int n = 0;
+    for (TACInstr* it = fn; it; it = it->next) {
+        if (it != fn && it->op == TAC_FUNC_DEF) break;
+        if (n == max) return -1;
+        out[n++] = it;
+    }
+    return n;
+}
+
+/* Number of instructions in the function starting at fn */
+static int optFuncLength(TACInstr* fn) {
+    int n = 1;
+    for (TACInstr* it = fn->next; it && it->op != TAC_FUNC_DEF; it = it->next) n++;
+    return n;
+}
+
+/* Replace an operand string; instructions own their operand copies */
+static void optSet(char** field, const char* value) {
+    char* copy = value ? strdup(value) : NULL;
+    free(*field);
+    *field = copy;
+}
+
+/* Does this instruction write its result operand? */
+static int optDefinesResult(TACInstr* in) {
+    switch (in->op) {
+    case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+    case TAC_DIVIDE: case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT:
+    case TAC_LE: case TAC_GE: case TAC_ARRAY_READ: case TAC_MEMBER_LOAD:
+    case TAC_ADDR_OF: case TAC_FUNC_CALL: case TAC_SELECT:
+        return in->result != NULL;
+    default:
+        return 0;
+    }
+}
+
+/* Unlink every code[i] with dead[i] set (code[0] is never removed) */
+static void optSweepFunc(TACInstr** code, int n, int* dead) {
+    TACInstr* prev = code[0];
+    for (int i = 1; i < n; i++) {
+        if (!dead[i]) { prev = code[i]; continue; }
+        prev->next = code[i]->next;
+        if (optimizedList.tail == code[i]) optimizedList.tail = prev;
+    }
+}
+
+/* Splice instr into optimizedList right after pos */
+static void optInsertAfter(TACInstr* pos, TACInstr* instr) {
+    instr->next = pos->next;
+    pos->next = instr;
+    if (optimizedList.tail == pos) optimizedList.tail = instr;
+}
+
+/* The instruction in front of instr in the function starting at fn */
+static TACInstr* optPrev(TACInstr* fn, TACInstr* instr) {
+    TACInstr* prev = fn;
+    while (prev->next != instr) prev = prev->next;
+    return prev;
+}
+
+/* Take instr (somewhere after fn) out of optimizedList */
+static void optUnlink(TACInstr* fn, TACInstr* instr) {
+    TACInstr* prev = fn;
+    while (prev->next != instr) prev = prev->next;
+    prev->next = instr->next;
+    instr->next = NULL;
+    if (optimizedList.tail == instr) optimizedList.tail = prev;
+}
+
+/* Splice instr into optimizedList right before code[idx] (idx > 0) */
+static void optInsertBefore(TACInstr** code, int idx, TACInstr* instr) {
+    optInsertAfter(code[idx - 1], instr);
+}
+
+/* depth[i] = number of loops (backward GOTO ranges) enclosing code[i] */
+static void optLoopDepths(TACInstr** code, int n, int* depth) {
+    for (int i = 0; i < n; i++) depth[i] = 0;
+    for (int g = 0; g < n; g++) {
+        if (code[g]->op != TAC_GOTO) continue;
+        for (int l = 0; l < g; l++)
+            if (code[l]->op == TAC_LABEL && optSame(code[l]->arg1, code[g]->arg1)) {
+                for (int i = l; i <= g; i++) depth[i]++;
+                break;
+            }
+    }
+}
+
+/* Rough execution weight of an instruction at the given loop depth */
+static int optDepthWeight(int depth) {
+    int w = 1;
+    while (depth-- > 0 && w < 100000) w *= 8;
+    return w;
+}
+
+/* Is label the target of a live GOTO / IF_FALSE in code[]? */
+static int optLabelUsed(TACInstr** code, int n, int* dead, const char* label) {
+    for (int i = 1; i < n; i++) {
+        if (dead[i]) continue;
+        if (code[i]->op == TAC_GOTO && optSame(code[i]->arg1, label)) return 1;
+        if (code[i]->op == TAC_IF_FALSE && optSame(code[i]->result, label)) return 1;
+    }
+    return 0;
+}
+
+/* Mark unreachable code, jumps to the very next label and labels that no
+ * jump refers to as dead.  DECLs are kept: the backend lays out the frame
+ * from them.  Returns the number of instructions marked. */
+static int optCleanupFunc(TACInstr** code, int n, int* dead) {
+    int removed = 0, changed = 1;
+    while (changed) {
+        changed = 0;
+        int reachable = 1;
+        for (int i = 1; i < n; i++) {
+            if (dead[i]) continue;
+            TACInstr* in = code[i];
+            if (in->op == TAC_DECL || in->op == TAC_ARRAY_DECL) continue;
+            if (in->op == TAC_LABEL) {
+                if (optLabelUsed(code, n, dead, in->arg1)) {
+                    reachable = 1;
+                    continue;
+                }
+            } else if (reachable && in->op == TAC_GOTO) {
+                int j = i + 1;
+                while (j < n && (dead[j] || code[j]->op == TAC_DECL ||
+                                 code[j]->op == TAC_ARRAY_DECL)) j++;
+                if (!(j < n && code[j]->op == TAC_LABEL && optSame(code[j]->arg1, in->arg1))) {
+                    reachable = 0;
+                    continue;
+                }
+            } else if (reachable) {
+                if (in->op == TAC_RETURN) reachable = 0;
+                continue;
+            }
+            dead[i] = 1;
+            removed++;
+            changed = 1;
+        }
+    }
+    return removed;
+}
+
+/* Match every ARG with the call that consumes it.  The parser emits
+ * arguments last-to-first, and a nested call's ARGs appear between the
+ * outer call's ARGs, so a pending stack is needed.  callOf[i] receives
+ * the index of the consuming FUNC_CALL and paramOf[i] the parameter
+ * position for each ARG at index i (-1 for everything else). */
+static int escParamCount(const char* fn);
+
+static void optMatchArgs(TACInstr** code, int n, int* callOf, int* paramOf) {
+    int pending[OPT_MAX_FUNC_INSTRS];
+    int top = 0;
+    for (int i = 0; i < n; i++) {
+        callOf[i] = paramOf[i] = -1;
+        if (code[i]->op == TAC_ARG) {
+            pending[top++] = i;
+        } else if (code[i]->op == TAC_FUNC_CALL) {
+            int want = escParamCount(code[i]->arg1);
+            if (want < 0 || want > top) want = top;
+            for (int k = 0; k < want; k++) {
+                int a = pending[top - want + k];
+                callOf[a]  = i;
+                paramOf[a] = want - 1 - k;
+            }
+            top -= want;
+        }
+    }
+}
+
+/* =========================================================
+ * ESCAPE ANALYSIS
+ *
+ * Local structs and arrays live in the frame, and every access
+ * used to go through memory.  This pass works out which of them
+ * can be treated as plain values:
+ *
+ *   1. A summary per function records, for each PARAM, whether the
+ *      callee reads through it, writes through it, or lets it go
+ *      anywhere other than a load/store base (capture).  Summaries
+ *      are solved optimistically to a fixed point so recursion works.
+ *   2. In each caller, the temps/pointer locals that hold &obj are
+ *      tracked.  The object escapes if one of them is used as a
+ *      value, stored, returned, or handed to a capturing parameter.
+ *   3. Member accesses through a pointer that can only hold &obj are
+ *      rewritten to access obj directly.
+ *   4. Objects that do not escape and are only accessed at constant
+ *      offsets are promoted to one scalar per slot ("box.w", "a[2]").
+ *      Memory is only synchronised around calls that receive the
+ *      address: stored before if the callee reads, reloaded after
+ *      if it writes.
+ * ========================================================= */
+#define ESC_MAX_OBJECTS  32
+#define ESC_MAX_ALIASES  32
+#define ESC_MAX_SLOTS    16
+
+typedef struct {
+    char* name;
+    char* params[OPT_MAX_PARAMS];
+    int   nParams;
+    int   captures[OPT_MAX_PARAMS];  /* pointer may be kept past the call */
+    int   reads[OPT_MAX_PARAMS];     /* callee loads through the pointer */
+    int   writes[OPT_MAX_PARAMS];    /* callee stores through the pointer */
+} EscapeSummary;
+
+typedef struct {
+    char*       name;
+    int         isArray;
+    int         slots;                       /* number of 4-byte words */
+    VarType     elemType;
+    StructType* st;
+    TACInstr*   decl;                        /* DECL / ARRAY_DECL instruction */
+    char*       aliases[ESC_MAX_ALIASES];    /* names that hold &name */
+    int         nAliases;
+    int         addressTaken;                /* address handed to a callee */
+    int         escapes;
+} EscapeObject;
+
+static EscapeSummary escSummaries[MAX_FUNCS];
+static int escSummaryCount = 0;
+
+static EscapeSummary* escFindSummary(const char* fn) {
+    for (int i = 0; i < escSummaryCount; i++)
+        if (optSame(escSummaries[i].name, fn)) return &escSummaries[i];
+    return NULL;
+}
+
+static int escParamCount(const char* fn) {
+    EscapeSummary* s = escFindSummary(fn);
+    return s ? s->nParams : -1;
+}
+
+static int escParamIndex(EscapeSummary* s, const char* name) {
+    for (int k = 0; k < s->nParams; k++)
+        if (optSame(s->params[k], name)) return k;
+    return -1;
+}
+
+static int escMark(int* flag) {
+    if (*flag) return 0;
+    *flag = 1;
+    return 1;
+}
+
+static int escMarkAll(EscapeSummary* s, int k) {
+    return escMark(&s->captures[k]) | escMark(&s->reads[k]) | escMark(&s->writes[k]);
+}
+
+static void escComputeSummaries(void) {
+    escSummaryCount = 0;
+    for (TACInstr* it = optimizedList.head; it; it = it->next) {
+        if (it->op == TAC_FUNC_DEF && escSummaryCount < MAX_FUNCS) {
+            EscapeSummary* s = &escSummaries[escSummaryCount++];
+            memset(s, 0, sizeof(*s));
+            s->name = it->arg1;
+        } else if (it->op == TAC_PARAM && escSummaryCount > 0) {
+            EscapeSummary* s = &escSummaries[escSummaryCount - 1];
+            if (s->nParams < OPT_MAX_PARAMS) s->params[s->nParams++] = it->arg1;
+        }
+    }
+
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int callOf[OPT_MAX_FUNC_INSTRS], paramOf[OPT_MAX_FUNC_INSTRS];
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+            if (fn->op != TAC_FUNC_DEF) continue;
+            EscapeSummary* s = escFindSummary(fn->arg1);
+            int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (n < 0) {
+                /* too long to scan: assume the worst of every param */
+                for (int k = 0; k < s->nParams; k++) changed |= escMarkAll(s, k);
+                continue;
+            }
+            optMatchArgs(code, n, callOf, paramOf);
+            for (int i = 1; i < n; i++) {
+                TACInstr* in = code[i];
+                if (in->op == TAC_PARAM) continue;
+                const char* ops[3] = { in->arg1, in->arg2, in->result };
+                for (int f = 0; f < 3; f++) {
+                    int k = ops[f] ? escParamIndex(s, ops[f]) : -1;
+                    if (k < 0) continue;
+                    int isBase = (f == 0);
+                    if (isBase && (in->op == TAC_MEMBER_LOAD || in->op == TAC_ARRAY_READ))
+                        changed |= escMark(&s->reads[k]);
+                    else if (isBase && (in->op == TAC_MEMBER_STORE || in->op == TAC_ARRAY_WRITE))
+                        changed |= escMark(&s->writes[k]);
+                    else if (isBase && in->op == TAC_BOUNDS_CHECK)
+                        ;
+                    else if (f == 0 && in->op == TAC_ASSIGN)
+                        changed |= escMarkAll(s, k);      /* pointer copied */
+                    else if (isBase && in->op == TAC_ARG && callOf[i] >= 0) {
+                        EscapeSummary* callee = escFindSummary(code[callOf[i]]->arg1);
+                        int j = paramOf[i];
+                        if (!callee || j >= callee->nParams) {
+                            changed |= escMarkAll(s, k);
+                        } else {
+                            if (callee->captures[j]) changed |= escMark(&s->captures[k]);
+                            if (callee->reads[j])    changed |= escMark(&s->reads[k]);
+                            if (callee->writes[j])   changed |= escMark(&s->writes[k]);
+                        }
+                    } else if (f == 2 && optDefinesResult(in)) {
+                        changed |= escMarkAll(s, k);      /* param redefined */
+                    } else {
+                        /* used as a plain value: nothing can be
+                         * dereferenced through it afterwards */
+                        changed |= escMark(&s->captures[k]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static int escIsAlias(EscapeObject* o, const char* name) {
+    if (!name) return 0;
+    for (int i = 0; i < o->nAliases; i++)
+        if (strcmp(o->aliases[i], name) == 0) return 1;
+    return 0;
+}
+
+/* Name of the scalar that replaces slot `slot` of o */
+static char* escSlotName(EscapeObject* o, int slot) {
+    char buf[160];
+    if (o->isArray) {
+        snprintf(buf, sizeof(buf), "%s[%d]", o->name, slot);
+    } else {
+        const char* field = NULL;
+        for (int i = 0; i < o->st->numFields; i++)
+            if (o->st->fields[i].offset == slot * 4) field = o->st->fields[i].name;
+        if (field) snprintf(buf, sizeof(buf), "%s.%s", o->name, field);
+        else       snprintf(buf, sizeof(buf), "%s.%d", o->name, slot * 4);
+    }
+    return strdup(buf);
+}
+
+/* Slot index of a constant member offset / array index, -1 if unknown */
+static int escConstSlot(EscapeObject* o, TACInstr* in) {
+    if (!isConst(in->arg2)) return -1;
+    int v = (int)atof(in->arg2);
+    int slot = o->isArray ? v : v / 4;
+    if (!o->isArray && v % 4) return -1;
+    return (slot >= 0 && slot < o->slots) ? slot : -1;
+}
+
+/* Collect the local aggregates of the function at code[0] */
+static int escCollectObjects(TACInstr** code, int n, EscapeObject* objs) {
+    int count = 0;
+    enterFunction(code[0]->arg1);
+    for (int i = 1; i < n && count < ESC_MAX_OBJECTS; i++) {
+        TACInstr* in = code[i];
+        EscapeObject* o = &objs[count];
+        memset(o, 0, sizeof(*o));
+        if (in->op == TAC_DECL && getVarType(in->result) == TYPE_STRUCT) {
+            o->st = getVarStructType(in->result);
+            if (!o->st) continue;
+            o->name = in->result;
+            o->slots = o->st->totalSize / 4;
+            o->elemType = TYPE_INT;
+        } else if (in->op == TAC_ARRAY_DECL) {
+            o->name = in->arg1;
+            o->isArray = 1;
+            o->slots = getArraySize(in->arg1);
+            o->elemType = getVarType(in->arg1);
+        } else {
+            continue;
+        }
+        o->decl = in;
+        o->aliases[o->nAliases++] = o->name;
+        count++;
+    }
+    exitFunction();
+    return count;
+}
+
+/* Grow o's alias set: ADDR_OF results, then pointer locals whose every
+ * definition copies an existing alias. */
+static void escFindAliases(EscapeObject* o, TACInstr** code, int n) {
+    for (int i = 1; i < n; i++)
+        if (code[i]->op == TAC_ADDR_OF && optSame(code[i]->arg1, o->name) &&
+            code[i]->result && !escIsAlias(o, code[i]->result) &&
+            o->nAliases < ESC_MAX_ALIASES)
+            o->aliases[o->nAliases++] = code[i]->result;
+
+    int grew = 1;
+    while (grew) {
+        grew = 0;
+        for (int i = 1; i < n; i++) {
+            TACInstr* in = code[i];
+            if (in->op != TAC_ASSIGN || !escIsAlias(o, in->arg1) || escIsAlias(o, in->result))
+                continue;
+            int onlyAliasDefs = 1;
+            for (int j = 1; j < n; j++) {
+                TACInstr* d = code[j];
+                if (!optSame(d->result, in->result)) continue;
+                if (d->op == TAC_ASSIGN && escIsAlias(o, d->arg1)) continue;
+                if (d->op == TAC_ARRAY_WRITE || d->op == TAC_MEMBER_STORE ||
+                    d->op == TAC_BOUNDS_CHECK || d->op == TAC_IF_FALSE || d->op == TAC_DECL)
+                    continue;
+                onlyAliasDefs = 0;
+            }
+            for (int j = 1; j < n && onlyAliasDefs; j++)
+                if (code[j]->op == TAC_PARAM && optSame(code[j]->arg1, in->result))
+                    onlyAliasDefs = 0;
+            if (onlyAliasDefs && o->nAliases < ESC_MAX_ALIASES) {
+                o->aliases[o->nAliases++] = in->result;
+                grew = 1;
+            }
+        }
+    }
+}
+
+/* Decide whether o escapes; sets addressTaken / escapes */
+static void escClassify(EscapeObject* o, TACInstr** code, int n, int* callOf, int* paramOf) {
+    for (int i = 1; i < n; i++) {
+        TACInstr* in = code[i];
+        switch (in->op) {
+        case TAC_DECL:
+        case TAC_ARRAY_DECL:
+        case TAC_ADDR_OF:
+            if (in->op == TAC_ADDR_OF && escIsAlias(o, in->arg1) && !optSame(in->arg1, o->name))
+                o->escapes = 1;
+            continue;
+        case TAC_MEMBER_LOAD:
+        case TAC_ARRAY_READ:
+            if (escIsAlias(o, in->arg2) || escIsAlias(o, in->result)) o->escapes = 1;
+            continue;
+        case TAC_MEMBER_STORE:
+        case TAC_ARRAY_WRITE:
+            if (escIsAlias(o, in->arg2) || escIsAlias(o, in->result)) o->escapes = 1;
+            continue;
+        case TAC_BOUNDS_CHECK:
+            if (escIsAlias(o, in->arg2)) o->escapes = 1;
+            continue;
+        case TAC_ASSIGN:
+            if (escIsAlias(o, in->arg1) && !escIsAlias(o, in->result)) o->escapes = 1;
+            continue;
+        case TAC_ARG:
+            if (!escIsAlias(o, in->arg1)) continue;
+            o->addressTaken = 1;
+            if (callOf[i] < 0) { o->escapes = 1; continue; }
+            {
+                EscapeSummary* callee = escFindSummary(code[callOf[i]]->arg1);
+                int j = paramOf[i];
+                if (!callee || j >= callee->nParams || callee->captures[j]) o->escapes = 1;
+            }
+            continue;
+        default:
+            if (escIsAlias(o, in->arg1) || escIsAlias(o, in->arg2) || escIsAlias(o, in->result))
+                o->escapes = 1;
+            continue;
+        }
+    }
+}
+
+/* Replace memory accesses to o with scalar copies; returns 1 on success.
+ * When the address reaches callees, promotion only pays off if the
+ * accesses it removes outweigh the loads/stores needed around calls. */
+static int escPromote(EscapeObject* o, TACInstr** code, int n, int* callOf, int* paramOf) {
+    static int depth[OPT_MAX_FUNC_INSTRS];
+    if (o->escapes || o->slots <= 0 || o->slots > ESC_MAX_SLOTS) return 0;
+    if (o->elemType != TYPE_INT) return 0;
+    optLoopDepths(code, n, depth);
+    int accessWeight = 0, syncWeight = 0;
+    for (int i = 1; i < n; i++) {
+        TACInstr* in = code[i];
+        int isAccess = (in->op == TAC_MEMBER_LOAD || in->op == TAC_MEMBER_STORE ||
+                        in->op == TAC_ARRAY_READ  || in->op == TAC_ARRAY_WRITE);
+        if (isAccess && optSame(in->arg1, o->name)) {
+            if (escConstSlot(o, in) < 0) return 0;
+            accessWeight += optDepthWeight(depth[i]);
+        }
+        if (in->op == TAC_ARG && escIsAlias(o, in->arg1) && callOf[i] >= 0) {
+            EscapeSummary* callee = escFindSummary(code[callOf[i]]->arg1);
+            /* each synced slot costs a scalar access plus a memory access;
+             * a write-only callee still needs the stores, since the
+             * reload after it covers every slot */
+            int j = paramOf[i];
+            int stores = callee->reads[j] || callee->writes[j];
+            int syncs = (stores + callee->writes[j]) * o->slots * 2;
+            syncWeight += syncs * optDepthWeight(depth[callOf[i]]);
+        }
+    }
+    if (syncWeight > accessWeight) return 0;
+
+    char* slotNames[ESC_MAX_SLOTS];
+    for (int s = 0; s < o->slots; s++) slotNames[s] = escSlotName(o, s);
+
+    /* Calls that see the address: sync memory around them.  Memory is
+     * brought up to date before any call that touches it, because the
+     * reload afterwards takes back every slot, not just those written. */
+    for (int i = 1; i < n; i++) {
+        if (code[i]->op != TAC_ARG || !escIsAlias(o, code[i]->arg1) || callOf[i] < 0) continue;
+        TACInstr* call = code[callOf[i]];
+        EscapeSummary* callee = escFindSummary(call->arg1);
+        int j = paramOf[i];
+        if (callee->reads[j] || callee->writes[j]) {
+            for (int s = 0; s < o->slots; s++) {
+                char off[32];
+                snprintf(off, sizeof(off), "%d", o->isArray ? s : s * 4);
+                optInsertBefore(code, callOf[i],
+                    createTAC(o->isArray ? TAC_ARRAY_WRITE : TAC_MEMBER_STORE,
+                              o->name, off, slotNames[s]));
+            }
+        }
+        if (callee->writes[j]) {
+            for (int s = o->slots - 1; s >= 0; s--) {
+                char off[32];
+                snprintf(off, sizeof(off), "%d", o->isArray ? s : s * 4);
+                optInsertAfter(call,
+                    createTAC(o->isArray ? TAC_ARRAY_READ : TAC_MEMBER_LOAD,
+                              o->name, off, slotNames[s]));
+            }
+        }
+    }
+
+    /* Rewrite the direct accesses */
+    for (int i = 1; i < n; i++) {
+        TACInstr* in = code[i];
+        if (!optSame(in->arg1, o->name)) continue;
+        if (in->op == TAC_MEMBER_LOAD || in->op == TAC_ARRAY_READ) {
+            char* slot = slotNames[escConstSlot(o, in)];
+            in->op = TAC_ASSIGN;
+            optSet(&in->arg1, slot);
+            optSet(&in->arg2, NULL);
+        } else if (in->op == TAC_MEMBER_STORE || in->op == TAC_ARRAY_WRITE) {
+            char* slot = slotNames[escConstSlot(o, in)];
+            in->op = TAC_ASSIGN;
+            optSet(&in->arg1, in->result);
+            optSet(&in->arg2, NULL);
+            optSet(&in->result, slot);
+        }
+    }
+
+    for (int s = o->slots - 1; s >= 1; s--)
+        optInsertAfter(o->decl, createTAC(TAC_DECL, NULL, NULL, slotNames[s]));
+    if (o->addressTaken) {
+        optInsertAfter(o->decl, createTAC(TAC_DECL, NULL, NULL, slotNames[0]));
+    } else {
+        /* Nothing reads the frame copy any more; reuse its declaration */
+        o->decl->op = TAC_DECL;
+        optSet(&o->decl->arg1, NULL);
+        optSet(&o->decl->result, slotNames[0]);
+    }
+    for (int s = 0; s < o->slots; s++) free(slotNames[s]);
+    return 1;
+}
+
+/* Local aggregates of the function at code[0], with alias sets and
+ * escape state filled in.  Needs escComputeSummaries() to have run. */
+static int escAnalyzeFunc(TACInstr** code, int n, int* callOf, int* paramOf,
+                          EscapeObject* objs) {
+    int nObjs = escCollectObjects(code, n, objs);
+    for (int k = 0; k < nObjs; k++) {
+        escFindAliases(&objs[k], code, n);
+        escClassify(&objs[k], code, n, callOf, paramOf);
+    }
+    return nObjs;
+}
+
+static void escapeAnalysisPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int callOf[OPT_MAX_FUNC_INSTRS], paramOf[OPT_MAX_FUNC_INSTRS];
+    EscapeObject objs[ESC_MAX_OBJECTS];
+
+    escComputeSummaries();
+
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+        if (n < 0) continue;
+        optMatchArgs(code, n, callOf, paramOf);
+        int nObjs = escAnalyzeFunc(code, n, callOf, paramOf, objs);
+
+        for (int k = 0; k < nObjs && n >= 0; k++) {
+            EscapeObject* o = &objs[k];
+            if (o->escapes) {
+                fprintf(stderr, "\n⚡ Optimizer [escape]: %s in %s escapes — kept in memory\n\n",
+                        o->name, fn->arg1);
+                continue;
+            }
+            /* Member accesses through a pointer that can only hold &o */
+            for (int i = 1; i < n; i++) {
+                TACInstr* in = code[i];
+                if ((in->op == TAC_MEMBER_LOAD || in->op == TAC_MEMBER_STORE) &&
+                    in->arg1 && !optSame(in->arg1, o->name) && escIsAlias(o, in->arg1))
+                    optSet(&in->arg1, o->name);
+            }
+            /* promotion may reuse the declaration o->name points into */
+            char* name = strdup(o->name);
+            if (escPromote(o, code, n, callOf, paramOf)) {
+                fprintf(stderr, "\n⚡ Optimizer [escape]: %s in %s does not escape"
+                        " — promoted %d slot(s) to scalars\n\n", name, fn->arg1, o->slots);
+                /* Inserted instructions invalidate code[]; refresh */
+                n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+                if (n >= 0) optMatchArgs(code, n, callOf, paramOf);
+            }
+            free(name);
+        }
+    }
+}
+
+/* =========================================================
+ * MEMORY-OP FORWARDING
+ *
+ * Walks each extended basic block (a run of code entered only at
+ * its first instruction: a new one starts at every LABEL) keeping
+ * the known contents of array elements and struct fields:
+ *
+ *   • Store forwarding    — a load of a location that was just stored
+ *                           becomes a copy of the stored value.
+ *   • Redundant loads     — a second load of the same location becomes
+ *                           a copy of the first load's result.
+ *   • Dead stores         — a store overwritten before anything could
+ *                           read it is deleted; so is a store to a local
+ *                           that is followed by RETURN.
+ *
+ * Alias rules: two different local objects never alias, a local that
+ * does not escape never aliases a parameter, and constant indices /
+ * offsets are compared exactly.  Parameters and pointers may alias each
+ * other.  A call only touches memory its arguments point to, because
+ * the language has no globals.
+ * ========================================================= */
+#define MEM_MAX_ENTRIES 64
+
+typedef struct {
+    char*   base;      /* array / struct / pointer name */
+    char*   index;     /* element index or byte offset (constant or name) */
+    char*   value;     /* operand currently held at that location */
+    int     isLocal;   /* base is a non-escaping local object */
+    int     storeIdx;  /* index of an unobserved store, or -1 */
+} MemEntry;
+
+typedef struct {
+    MemEntry e[MEM_MAX_ENTRIES];
+    int      n;
+    EscapeObject* objs;
+    int      nObjs;
+} MemState;
+
+static EscapeObject* memFindObject(MemState* st, const char* name) {
+    for (int k = 0; k < st->nObjs; k++)
+        if (optSame(st->objs[k].name, name)) return &st->objs[k];
+    return NULL;
+}
+
+static int memIsLocal(MemState* st, const char* base) {
+    EscapeObject* o = memFindObject(st, base);
+    return o && !o->escapes;
+}
+
+/* 1 = same location, 0 = disjoint, -1 = may overlap */
+static int memCompare(MemState* st, const char* b1, const char* i1,
+                      const char* b2, const char* i2) {
+    if (!optSame(b1, b2)) {
+        if (memIsLocal(st, b1) || memIsLocal(st, b2)) return 0;
+        if (memFindObject(st, b1) && memFindObject(st, b2)) return 0;
+        return -1;
+    }
+    if (optSame(i1, i2)) return 1;
+    if (isConst(i1) && isConst(i2)) return atof(i1) == atof(i2) ? 1 : 0;
+    return -1;
+}
+
+static void memDrop(MemState* st, int k) {
+    st->e[k] = st->e[--st->n];
+}
+
+/* A name was redefined: facts that mention it are stale */
+static void memKillName(MemState* st, const char* name) {
+    if (!name) return;
+    for (int k = st->n - 1; k >= 0; k--)
+        if (optSame(st->e[k].base, name) || optSame(st->e[k].index, name) ||
+            optSame(st->e[k].value, name))
+            memDrop(st, k);
+}
+
+/* Type of a TAC operand as the backend will see it */
+static VarType memOperandType(const char* op, VarType* tempTypes, int nTemps) {
+    if (!op) return TYPE_VOID;
+    if (isTemporary((char*)op)) {
+        int t = atoi(op + 1);
+        return (t < nTemps) ? tempTypes[t] : TYPE_VOID;
+    }
+    if (isConst(op)) return strchr(op, '.') ? TYPE_FLOAT : TYPE_INT;
+    return getVarType((char*)op);
+}
+
+static VarType memElemType(const char* base, TACOp op) {
+    if (op == TAC_MEMBER_LOAD || op == TAC_MEMBER_STORE) return TYPE_INT;
+    return getVarType((char*)base);
+}
+
+/* Forward scan giving each temp the type of the value it holds.
+ * Integer division is left unknown (TYPE_VOID): the backend may
+ * evaluate it in floating point depending on later uses. */
+static void memInferTempTypes(TACInstr** code, int n, VarType* tempTypes, int nTemps) {
+    for (int t = 0; t < nTemps; t++) tempTypes[t] = TYPE_VOID;
+    for (int i = 1; i < n; i++) {
+        TACInstr* in = code[i];
+        if (!optDefinesResult(in) || !isTemporary(in->result)) continue;
+        int t = atoi(in->result + 1);
+        if (t >= nTemps) continue;
+        VarType a = memOperandType(in->arg1, tempTypes, nTemps);
+        VarType b = memOperandType(in->arg2, tempTypes, nTemps);
+        switch (in->op) {
+        case TAC_ASSIGN:      tempTypes[t] = a; break;
+        case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+            tempTypes[t] = (a == TYPE_VOID || b == TYPE_VOID) ? TYPE_VOID :
+                           (a == TYPE_FLOAT || b == TYPE_FLOAT) ? TYPE_FLOAT : TYPE_INT;
+            break;
+        case TAC_DIVIDE:
+            tempTypes[t] = (a == TYPE_FLOAT || b == TYPE_FLOAT) ? TYPE_FLOAT : TYPE_VOID;
+            break;
+        case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+            tempTypes[t] = TYPE_INT; break;
+        case TAC_ARRAY_READ:
+        case TAC_MEMBER_LOAD: tempTypes[t] = memElemType(in->arg1, in->op); break;
+        case TAC_FUNC_CALL:   tempTypes[t] = getFunctionReturnType(in->arg1); break;
+        default:              tempTypes[t] = TYPE_VOID; break;
+        }
+    }
+}
+
+static void memForwardFunc(TACInstr** code, int n, int* callOf, int* paramOf,
+                           EscapeObject* objs, int nObjs, int* dead) {
+    static VarType tempTypes[8192];
+    int nTemps = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+    MemState st;
+    st.n = 0;
+    st.objs = objs;
+    st.nObjs = nObjs;
+
+    enterFunction(code[0]->arg1);
+    memInferTempTypes(code, n, tempTypes, nTemps);
+
+    for (int i = 1; i < n; i++) {
+        TACInstr* in = code[i];
+        switch (in->op) {
+        case TAC_LABEL:
+            st.n = 0;             /* other predecessors know nothing */
+            break;
+
+        case TAC_GOTO:
+        case TAC_IF_FALSE:
+            /* the target may read anything that was stored */
+            for (int k = 0; k < st.n; k++) st.e[k].storeIdx = -1;
+            break;
+
+        case TAC_RETURN:
+            /* frame memory dies here: unread local stores are dead */
+            for (int k = 0; k < st.n; k++)
+                if (st.e[k].storeIdx >= 0 && st.e[k].isLocal) {
+                    dead[st.e[k].storeIdx] = 1;
+                    g_deadCodeElimCount++;
+                }
+            st.n = 0;
+            break;
+
+        case TAC_ARRAY_READ:
+        case TAC_MEMBER_LOAD: {
+            int hit = -1;
+            for (int k = 0; k < st.n; k++)
+                if (memCompare(&st, st.e[k].base, st.e[k].index, in->arg1, in->arg2) == 1)
+                    hit = k;
+            if (hit >= 0) {
+                fprintf(stderr, "\n⚡ Optimizer [mem-forward]: load %s[%s] -> %s"
+                        " replaced by copy of %s\n\n",
+                        in->arg1, in->arg2, in->result, st.e[hit].value);
+                in->op = TAC_ASSIGN;
+                optSet(&in->arg1, st.e[hit].value);
+                optSet(&in->arg2, NULL);
+                memKillName(&st, in->result);
+                break;
+            }
+            /* the load really happens: earlier stores it may see are live */
+            for (int k = 0; k < st.n; k++)
+                if (memCompare(&st, st.e[k].base, st.e[k].index, in->arg1, in->arg2) != 0)
+                    st.e[k].storeIdx = -1;
+            memKillName(&st, in->result);
+            if (st.n < MEM_MAX_ENTRIES && !optSame(in->result, in->arg2) &&
+                !optSame(in->result, in->arg1)) {
+                MemEntry* e = &st.e[st.n++];
+                e->base = in->arg1;
+                e->index = in->arg2;
+                e->value = in->result;
+                e->isLocal = memIsLocal(&st, in->arg1);
+                e->storeIdx = -1;
+            }
+            break;
+        }
+
+        case TAC_ARRAY_WRITE:
+        case TAC_MEMBER_STORE: {
+            VarType elem = memElemType(in->arg1, in->op);
+            VarType vt = memOperandType(in->result, tempTypes, nTemps);
+            for (int k = st.n - 1; k >= 0; k--) {
+                int c = memCompare(&st, st.e[k].base, st.e[k].index, in->arg1, in->arg2);
+                if (c == 0) continue;
+                if (c == 1 && st.e[k].storeIdx >= 0) {
+                    fprintf(stderr, "\n⚡ Optimizer [dead-store]: earlier store to %s[%s] overwritten\n\n",
+                            in->arg1, in->arg2);
+                    dead[st.e[k].storeIdx] = 1;
+                    g_deadCodeElimCount++;
+                }
+                memDrop(&st, k);
+            }
+            /* Only remember values the backend would load back unchanged */
+            if (st.n < MEM_MAX_ENTRIES && vt == elem) {
+                MemEntry* e = &st.e[st.n++];
+                e->base = in->arg1;
+                e->index = in->arg2;
+                e->value = in->result;
+                e->isLocal = memIsLocal(&st, in->arg1);
+                e->storeIdx = i;
+            }
+            break;
+        }
+
+        case TAC_FUNC_CALL: {
+            /* Which memory can the callee reach?  Only what its
+             * pointer/array arguments lead to. */
+            EscapeSummary* callee = escFindSummary(in->arg1);
+            for (int k = st.n - 1; k >= 0; k--) {
+                MemEntry* e = &st.e[k];
+                int reads = 0, writes = 0;
+                if (!callee) {
+                    reads = writes = 1;
+                } else {
+                    for (int a = 1; a < i; a++) {
+                        if (callOf[a] != i) continue;
+                        int touches;
+                        if (e->isLocal) {
+                            EscapeObject* o = memFindObject(&st, e->base);
+                            touches = escIsAlias(o, code[a]->arg1);
+                        } else {
+                            /* pointers may lead anywhere outside our locals */
+                            touches = !memIsLocal(&st, code[a]->arg1);
+                        }
+                        if (!touches) continue;
+                        reads  |= callee->reads[paramOf[a]];
+                        writes |= callee->writes[paramOf[a]];
+                    }
+                }
+                if (reads)  e->storeIdx = -1;
+                if (writes) memDrop(&st, k);
+            }
+            memKillName(&st, in->result);
+            break;
+        }
+
+        default:
+            if (optDefinesResult(in)) memKillName(&st, in->result);
+            break;
+        }
+    }
+    exitFunction();
+}
+
+static void memoryForwardingPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int callOf[OPT_MAX_FUNC_INSTRS], paramOf[OPT_MAX_FUNC_INSTRS];
+    static int dead[OPT_MAX_FUNC_INSTRS];
+    EscapeObject objs[ESC_MAX_OBJECTS];
+
+    escComputeSummaries();
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+        if (n < 0) continue;
+        optMatchArgs(code, n, callOf, paramOf);
+        int nObjs = escAnalyzeFunc(code, n, callOf, paramOf, objs);
+        for (int i = 0; i < n; i++) dead[i] = 0;
+        memForwardFunc(code, n, callOf, paramOf, objs, nObjs, dead);
+        optSweepFunc(code, n, dead);
+    }
+}
+
+/* =========================================================
+ * SCALAR REPLACEMENT OF ARRAY ELEMENTS
+ *
+ * An element a[k] that a loop keeps reading and writing, with k
+ * not changing inside the loop (accumulators such as
+ * sum[0] = sum[0] + x), is kept in a temp for the whole loop: it is
+ * loaded once in front of the loop and stored once at its exit.
+ *
+ *       ...                          ok = k in [0, size) / IF_FALSE ok Lp
+ *   Ls: ...                          tv = a[k]
+ *       t1 = a[k]                Lp: 
+ *       t2 = t1 + x          ──►  Ls: ...
+ *       a[k] = t2                     t1 = tv / t2 = t1 + x / tv = t2
+ *       GOTO Ls                       GOTO Ls
+ *   Le:                           Le: IF_FALSE ok Lq / a[k] = tv / Lq:
+ *
+ * Only local int arrays are promoted (their size is known, so the
+ * early load is guarded, and nothing else can reach them except a
+ * call that is passed the array).  A constant k needs no guard.  The
+ * loop must be entered only through its header and left only through
+ * the label after its back edge; an array accessed with two different
+ * indexes, at least one of them not constant, stays in memory.
+ * ========================================================= */
+#define PROMOTE_MAX_REFS 16
+
+typedef struct {
+    const char* array;
+    const char* index;
+    int writes;
+} PromoteRef;
+
+/* Is the label defined at code[at] jumped to from outside [head..tail]? */
+static int promoteJumpedFromOutside(TACInstr** code, int n, int head, int tail, const char* label) {
+    for (int i = 1; i < n; i++) {
+        if (i >= head && i <= tail) continue;
+        if ((code[i]->op == TAC_GOTO && optSame(code[i]->arg1, label)) ||
+            (code[i]->op == TAC_IF_FALSE && optSame(code[i]->result, label)))
+            return 1;
+    }
+    return 0;
+}
+
+static int promoteIsParam(TACInstr** code, int n, const char* name) {
+    for (int i = 1; i < n && code[i]->op == TAC_PARAM; i++)
+        if (optSame(code[i]->arg1, name)) return 1;
+    return 0;
+}
+
+/* Collect the promotable elements of the loop code[head..tail] */
+static int promoteCollect(TACInstr** code, int n, int head, int tail, PromoteRef* refs) {
+    int nRefs = 0;
+    for (int i = head + 1; i < tail; i++) {
+        TACInstr* in = code[i];
+        if (in->op != TAC_ARRAY_READ && in->op != TAC_ARRAY_WRITE) continue;
+        const char* a = in->arg1;
+        if (!isArrayVar((char*)a) || getVarType((char*)a) != TYPE_INT ||
+            getArraySize((char*)a) <= 0 || promoteIsParam(code, n, a))
+            continue;
+        int found = -1;
+        for (int r = 0; r < nRefs; r++)
+            if (optSame(refs[r].array, a) && optSame(refs[r].index, in->arg2)) found = r;
+        if (found < 0) {
+            if (nRefs == PROMOTE_MAX_REFS) continue;
+            refs[nRefs].array = a;
+            refs[nRefs].index = in->arg2;
+            refs[nRefs].writes = 0;
+            found = nRefs++;
+        }
+        refs[found].writes += in->op == TAC_ARRAY_WRITE;
+    }
+
+    /* drop what might overlap another access or change inside the loop */
+    int kept = 0;
+    for (int r = 0; r < nRefs; r++) {
+        PromoteRef* p = &refs[r];
+        int ok = 1;
+        for (int q = 0; q < nRefs && ok; q++)
+            if (q != r && optSame(refs[q].array, p->array) &&
+                !(isConst(p->index) && isConst(refs[q].index)))
+                ok = 0;
+        for (int i = head + 1; i < tail && ok; i++) {
+            TACInstr* in = code[i];
+            if (in->op == TAC_ARG && optSame(in->arg1, p->array)) ok = 0;
+            if (!isConst(p->index) && optDefinesResult(in) && optSame(in->result, p->index)) ok = 0;
+        }
+        for (int i = 1; i < n && ok && !isConst(p->index); i++)
+            if (code[i]->op == TAC_ADDR_OF && optSame(code[i]->arg1, p->index)) ok = 0;
+        if (ok && isConst(p->index)) {
+            int k = atoi(p->index);
+            ok = !strchr(p->index, '.') && k >= 0 && k < getArraySize((char*)p->array);
+        }
+        if (ok) refs[kept++] = *p;
+    }
+    return kept;
+}
+
+/* Promote the elements of the loop code[head..tail]; returns how many */
+static int promoteLoop(TACInstr** code, int n, int head, int tail) {
+    if (tail + 1 >= n || code[tail + 1]->op != TAC_LABEL) return 0;
+    const char* exitLabel = code[tail + 1]->arg1;
+
+    /* entered only at the header, left only through exitLabel */
+    if (promoteJumpedFromOutside(code, n, head, tail, code[head]->arg1) ||
+        promoteJumpedFromOutside(code, n, head, tail, exitLabel))
+        return 0;
+    for (int i = head + 1; i < tail; i++) {
+        TACInstr* in = code[i];
+        if (in->op == TAC_RETURN) return 0;
+        if (in->op == TAC_LABEL && promoteJumpedFromOutside(code, n, head, tail, in->arg1)) return 0;
+        const char* tgt = in->op == TAC_GOTO ? in->arg1 : in->op == TAC_IF_FALSE ? in->result : NULL;
+        if (!tgt || optSame(tgt, exitLabel)) continue;
+        int inside = 0;
+        for (int j = head; j <= tail && !inside; j++)
+            inside = code[j]->op == TAC_LABEL && optSame(code[j]->arg1, tgt);
+        if (!inside) return 0;
+    }
+
+    PromoteRef refs[PROMOTE_MAX_REFS];
+    int nRefs = promoteCollect(code, n, head, tail, refs);
+    TACInstr* pre = optPrev(code[0], code[head]);
+    TACInstr* post = code[tail + 1];
+    /* the rewrite frees the operand strings refs[] points into */
+    for (int r = 0; r < nRefs; r++) {
+        refs[r].array = strdup(refs[r].array);
+        refs[r].index = strdup(refs[r].index);
+    }
+    for (int r = 0; r < nRefs; r++) {
+        PromoteRef* p = &refs[r];
+        char* tv = newTemp();
+        char* ok = NULL;
+
+        /* the early load must stay inside the array */
+        if (!isConst(p->index)) {
+            char size[16];
+            snprintf(size, sizeof(size), "%d", getArraySize((char*)p->array));
+            char* lo = newTemp();
+            char* hi = newTemp();
+            char* skip = newLabel();
+            ok = newTemp();
+            TACInstr* seq[] = {
+                createTAC(TAC_GE, (char*)p->index, "0", lo),
+                createTAC(TAC_LT, (char*)p->index, size, hi),
+                createTAC(TAC_MULTIPLY, lo, hi, ok),
+                createTAC(TAC_IF_FALSE, ok, NULL, skip),
+                createTAC(TAC_ARRAY_READ, (char*)p->array, (char*)p->index, tv),
+                createTAC(TAC_LABEL, skip, NULL, NULL),
+            };
+            for (int s = 0; s < 6; s++) {
+                optInsertAfter(pre, seq[s]);
+                pre = seq[s];
+            }
+            free(lo);
+            free(hi);
+            free(skip);
+        } else {
+            TACInstr* load = createTAC(TAC_ARRAY_READ, (char*)p->array, (char*)p->index, tv);
+            optInsertAfter(pre, load);
+            pre = load;
+        }
+
+        for (int i = head + 1; i < tail; i++) {
+            TACInstr* in = code[i];
+            if ((in->op != TAC_ARRAY_READ && in->op != TAC_ARRAY_WRITE) ||
+                !optSame(in->arg1, p->array) || !optSame(in->arg2, p->index))
+                continue;
+            if (in->op == TAC_ARRAY_READ) {
+                optSet(&in->arg1, tv);
+            } else {
+                optSet(&in->arg1, in->result);
+                optSet(&in->result, tv);
+            }
+            optSet(&in->arg2, NULL);
+            in->op = TAC_ASSIGN;
+        }
+
+        if (p->writes > 0) {
+            TACInstr* store = createTAC(TAC_ARRAY_WRITE, (char*)p->array, (char*)p->index, tv);
+            if (ok) {
+                char* skip = newLabel();
+                TACInstr* seq[] = {
+                    createTAC(TAC_IF_FALSE, ok, NULL, skip),
+                    store,
+                    createTAC(TAC_LABEL, skip, NULL, NULL),
+                };
+                for (int s = 0; s < 3; s++) {
+                    optInsertAfter(post, seq[s]);
+                    post = seq[s];
+                }
+                free(skip);
+            } else {
+                optInsertAfter(post, store);
+                post = store;
+            }
+        }
+        fprintf(stderr, "\n⚡ Optimizer [promote]: %s[%s] kept in %s across loop %s in %s\n\n",
+                p->array, p->index, tv, code[head]->arg1, code[0]->arg1);
+        free(tv);
+        free(ok);
+    }
+    for (int r = 0; r < nRefs; r++) {
+        free((char*)refs[r].array);
+        free((char*)refs[r].index);
+    }
+    return nRefs;
+}
+
+static void scalarReplacementPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        /* innermost loops first: the loads and stores they leave behind
+         * can then be promoted by the enclosing loop */
+        int again = 1;
+        while (again) {
+            again = 0;
+            int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (n < 0) break;
+            for (int g = 1; g < n && !again; g++) {
+                if (code[g]->op != TAC_GOTO) continue;
+                int h = -1;
+                for (int j = 1; j < g; j++)
+                    if (code[j]->op == TAC_LABEL && optSame(code[j]->arg1, code[g]->arg1)) h = j;
+                if (h >= 0 && promoteLoop(code, n, h, g) > 0) again = 1;
+            }
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * LOOP FUSION
+ *
+ * A for loop lowers to a fixed shape (tac.c, NODE_FOR).  Two such
+ * loops in a row with the same counter, start, test and step are
+ * merged into one, so the counter is maintained once and the second
+ * body can reuse what the first one loaded:
+ *
+ *   i = 0                            i = 0
+ *   Ls1: t = i < n                   Ls1: t = i < n
+ *        IF_FALSE t Le1                   IF_FALSE t Le1
+ *        body1                            body1
+ *        i = i + 1                        body2
+ *        GOTO Ls1            ──►          i = i + 1
+ *   Le1: i = 0                            GOTO Ls1
+ *   Ls2: ... body2 ...               Le1:
+ *   Le2:                             Le2:
+ *
+ * The bodies must be straight-line code without calls or output.  A
+ * scalar one body writes must not be touched by the other, and every
+ * pair of accesses to one array (array parameters may alias each
+ * other) with a write among them must index it as i + c1 in body1 and
+ * i + c2 in body2 with the element reached by body1 first (c2 <= c1
+ * when counting up).  Pure instructions between the loops that do not
+ * interfere with the first one are moved in front of it; labels that
+ * nothing jumps to (left behind by an earlier fusion) are stepped over.
+ * ========================================================= */
+#define FUSE_MAX_BETWEEN 8
+
+typedef struct {
+    int init, head, test, update, back, exit;   /* indexes into code[] */
+    const char* iv;                              /* loop counter */
+    int step;
+} FuseLoop;
+
+static int fuseIsLabelOf(TACInstr* in, const char* label) {
+    return in->op == TAC_LABEL && optSame(in->arg1, label);
+}
+
+/* Number of jumps to label in code[] */
+static int fuseJumpsTo(TACInstr** code, int n, const char* label) {
+    int count = 0;
+    for (int i = 1; i < n; i++)
+        if ((code[i]->op == TAC_GOTO && optSame(code[i]->arg1, label)) ||
+            (code[i]->op == TAC_IF_FALSE && optSame(code[i]->result, label)))
+            count++;
+    return count;
+}
+
+/* Number of instructions in code[] that read name */
+static int fuseReads(TACInstr** code, int n, const char* name) {
+    int count = 0;
+    for (int i = 1; i < n; i++)
+        count += optSame(code[i]->arg1, name) || optSame(code[i]->arg2, name) ||
+                 (!optDefinesResult(code[i]) && optSame(code[i]->result, name));
+    return count;
+}
+
+/* Pure scalar instructions, which may sit between the two loops */
+static int fuseMovableOp(TACOp op) {
+    switch (op) {
+    case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+    case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int fuseBodyOp(TACOp op) {
+    switch (op) {
+    case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY: case TAC_DIVIDE:
+    case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+    case TAC_SELECT: case TAC_ARRAY_READ: case TAC_ARRAY_WRITE:
+    case TAC_BOUNDS_CHECK: case TAC_DIV_CHECK: case TAC_DECL:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Parse the loop whose header label is code[h]; 1 if it has the for shape */
+static int fuseParseLoop(TACInstr** code, int n, int h, FuseLoop* lp) {
+    if (h < 2 || h + 2 >= n || code[h]->op != TAC_LABEL) return 0;
+    TACInstr* init = code[h - 1];
+    TACInstr* cmp = code[h + 1];
+    TACInstr* test = code[h + 2];
+    if (init->op != TAC_ASSIGN || isTemporary(init->result)) return 0;
+    if (cmp->op != TAC_LT && cmp->op != TAC_LE && cmp->op != TAC_GT &&
+        cmp->op != TAC_GE && cmp->op != TAC_NE)
+        return 0;
+    if (!optSame(cmp->arg1, init->result) || !isTemporary(cmp->result)) return 0;
+    if (test->op != TAC_IF_FALSE || !optSame(test->arg1, cmp->result)) return 0;
+
+    int back = -1;
+    for (int j = h + 3; j + 1 < n && back < 0; j++)
+        if (code[j]->op == TAC_GOTO && optSame(code[j]->arg1, code[h]->arg1)) back = j;
+    if (back < 0 || !fuseIsLabelOf(code[back + 1], test->result)) return 0;
+
+    /* i = i + k, or t = i + k; i = t as the front end emits it */
+    const char* iv = init->result;
+    int update = back - 1, step;
+    TACInstr* upd = code[update];
+    if (upd->op == TAC_ASSIGN && optSame(upd->result, iv) && isTemporary(upd->arg1) &&
+        update - 1 > h + 2 && optSame(code[update - 1]->result, upd->arg1) &&
+        fuseReads(code, n, upd->arg1) == 1) {
+        update--;
+        upd = code[update];
+    } else if (!optSame(upd->result, iv)) {
+        return 0;
+    }
+    if (update <= h + 2) return 0;
+    if (upd->op == TAC_ADD && optSame(upd->arg1, iv) && isConst(upd->arg2))
+        step = atoi(upd->arg2);
+    else if (upd->op == TAC_ADD && optSame(upd->arg2, iv) && isConst(upd->arg1))
+        step = atoi(upd->arg1);
+    else if (upd->op == TAC_SUBTRACT && optSame(upd->arg1, iv) && isConst(upd->arg2))
+        step = -atoi(upd->arg2);
+    else
+        return 0;
+    if (step == 0 || strchr(upd->op == TAC_ADD && isConst(upd->arg1) ? upd->arg1 : upd->arg2, '.'))
+        return 0;
+
+    for (int j = h + 3; j < update; j++) {
+        if (!fuseBodyOp(code[j]->op)) return 0;
+        if (optDefinesResult(code[j]) &&
+            (optSame(code[j]->result, iv) || optSame(code[j]->result, cmp->arg2)))
+            return 0;
+    }
+    /* only the loop itself may jump to its labels or read its test */
+    if (fuseJumpsTo(code, n, code[h]->arg1) != 1 || fuseJumpsTo(code, n, test->result) != 1 ||
+        fuseReads(code, n, cmp->result) != 1)
+        return 0;
+
+    lp->init = h - 1;
+    lp->head = h;
+    lp->test = h + 2;
+    lp->update = update;
+    lp->back = back;
+    lp->exit = back + 1;
+    lp->iv = iv;
+    lp->step = step;
+    return 1;
+}
+
+static int fuseIsParam(TACInstr** code, int n, const char* name) {
+    for (int i = 1; i < n && code[i]->op == TAC_PARAM; i++)
+        if (optSame(code[i]->arg1, name)) return 1;
+    return 0;
+}
+
+/* Index of an array access as iv + *offset; 0 if not of that form */
+static int fuseOffset(TACInstr** code, int from, int at, const char* iv, const char* idx,
+                      int* offset) {
+    if (optSame(idx, iv)) {
+        *offset = 0;
+        return 1;
+    }
+    if (!idx || !isTemporary((char*)idx)) return 0;
+    int def = -1;
+    for (int j = from; j < at; j++)
+        if (optDefinesResult(code[j]) && optSame(code[j]->result, idx)) {
+            if (def >= 0) return 0;
+            def = j;
+        }
+    if (def < 0) return 0;
+    TACInstr* d = code[def];
+    if (d->op == TAC_ADD && optSame(d->arg1, iv) && isConst(d->arg2) && !strchr(d->arg2, '.'))
+        *offset = atoi(d->arg2);
+    else if (d->op == TAC_ADD && optSame(d->arg2, iv) && isConst(d->arg1) && !strchr(d->arg1, '.'))
+        *offset = atoi(d->arg1);
+    else if (d->op == TAC_SUBTRACT && optSame(d->arg1, iv) && isConst(d->arg2) && !strchr(d->arg2, '.'))
+        *offset = -atoi(d->arg2);
+    else
+        return 0;
+    return 1;
+}
+
+/* Does any instruction of code[from..to) write name / read name? */
+static int fuseWrites(TACInstr** code, int from, int to, const char* name) {
+    for (int j = from; j < to; j++)
+        if (optDefinesResult(code[j]) && code[j]->op != TAC_ARRAY_WRITE &&
+            optSame(code[j]->result, name))
+            return 1;
+    return 0;
+}
+
+static int fuseReadsIn(TACInstr** code, int from, int to, const char* name) {
+    for (int j = from; j < to; j++) {
+        TACInstr* in = code[j];
+        if (optSame(in->arg2, name) || (in->op != TAC_ARRAY_READ && optSame(in->arg1, name)) ||
+            (in->op == TAC_ARRAY_WRITE && optSame(in->result, name)))
+            return 1;
+    }
+    return 0;
+}
+
+/* Scalars: nothing one body writes may be touched by the other */
+static int fuseScalarsIndependent(TACInstr** code, int from1, int to1, int from2, int to2) {
+    for (int j = from1; j < to1; j++) {
+        TACInstr* in = code[j];
+        if (!optDefinesResult(in) || in->op == TAC_ARRAY_WRITE || in->op == TAC_DECL) continue;
+        if (fuseReadsIn(code, from2, to2, in->result) || fuseWrites(code, from2, to2, in->result))
+            return 0;
+    }
+    for (int j = from2; j < to2; j++) {
+        TACInstr* in = code[j];
+        if (!optDefinesResult(in) || in->op == TAC_ARRAY_WRITE || in->op == TAC_DECL) continue;
+        if (fuseReadsIn(code, from1, to1, in->result)) return 0;
+    }
+    return 1;
+}
+
+/* Arrays: no element may be reached by body2 before body1 is done with it */
+static int fuseArraysIndependent(TACInstr** code, int n, FuseLoop* a, FuseLoop* b) {
+    for (int x = a->test + 1; x < a->update; x++) {
+        TACInstr* p = code[x];
+        if (p->op != TAC_ARRAY_READ && p->op != TAC_ARRAY_WRITE) continue;
+        for (int y = b->test + 1; y < b->update; y++) {
+            TACInstr* q = code[y];
+            if (q->op != TAC_ARRAY_READ && q->op != TAC_ARRAY_WRITE) continue;
+            if (p->op == TAC_ARRAY_READ && q->op == TAC_ARRAY_READ) continue;
+            int alias = optSame(p->arg1, q->arg1) ||
+                        (fuseIsParam(code, n, p->arg1) && fuseIsParam(code, n, q->arg1));
+            if (!alias) continue;
+            int c1, c2;
+            if (!fuseOffset(code, a->test + 1, x, a->iv, p->arg2, &c1) ||
+                !fuseOffset(code, b->test + 1, y, b->iv, q->arg2, &c2))
+                return 0;
+            if (a->step > 0 ? c2 > c1 : c2 < c1) return 0;
+        }
+    }
+    return 1;
+}
+
+/* Try to fuse the loop at code[h] with the loop after it; 1 on success */
+static int fuseTryLoop(TACInstr** code, int n, int h) {
+    FuseLoop a, b;
+    if (!fuseParseLoop(code, n, h, &a)) return 0;
+
+    /* pure instructions between the loops, then loop b's counter init */
+    int k = a.exit + 1, between = 0;
+    while (k + 1 < n && !(code[k + 1]->op == TAC_LABEL && code[k]->op == TAC_ASSIGN &&
+                          optSame(code[k]->result, a.iv))) {
+        int idle = code[k]->op == TAC_LABEL && fuseJumpsTo(code, n, code[k]->arg1) == 0;
+        if (!idle && (!fuseMovableOp(code[k]->op) || ++between > FUSE_MAX_BETWEEN)) return 0;
+        k++;
+    }
+    if (k + 1 >= n || !fuseParseLoop(code, n, k + 1, &b)) return 0;
+
+    TACInstr* ca = code[a.head + 1];
+    TACInstr* cb = code[b.head + 1];
+    if (!optSame(b.iv, a.iv) || b.step != a.step || ca->op != cb->op ||
+        !optSame(ca->arg2, cb->arg2) || !optSame(code[a.init]->arg1, code[b.init]->arg1))
+        return 0;
+    /* the start and the bound must mean the same thing for both loops */
+    const char* start = code[a.init]->arg1;
+    const char* bound = ca->arg2;
+    if (fuseWrites(code, a.head, k, start) || fuseWrites(code, a.head, k, bound) ||
+        fuseWrites(code, b.head, b.exit, start) || fuseWrites(code, b.head, b.exit, bound))
+        return 0;
+
+    /* the instructions in between move in front of loop a */
+    for (int j = a.exit + 1; j < b.init; j++) {
+        TACInstr* in = code[j];
+        if (in->op == TAC_LABEL) continue;
+        if (optSame(in->result, a.iv) || fuseReadsIn(code, a.init, a.exit, in->result) ||
+            fuseWrites(code, a.init, a.exit, in->result))
+            return 0;
+        if ((!isConst(in->arg1) && fuseWrites(code, a.init, a.exit, in->arg1)) ||
+            (in->arg2 && !isConst(in->arg2) && fuseWrites(code, a.init, a.exit, in->arg2)))
+            return 0;
+    }
+
+    if (!fuseScalarsIndependent(code, a.test + 1, a.update, b.test + 1, b.update) ||
+        !fuseArraysIndependent(code, n, &a, &b))
+        return 0;
+
+    fprintf(stderr, "\n⚡ Optimizer [fusion]: loops %s and %s in %s fused\n\n",
+            code[a.head]->arg1, code[b.head]->arg1, code[0]->arg1);
+
+    TACInstr* fn = code[0];
+    TACInstr* pre = optPrev(fn, code[a.init]);
+    for (int j = a.exit + 1; j < b.init; j++) {
+        if (code[j]->op == TAC_LABEL) continue;
+        optUnlink(fn, code[j]);
+        optInsertAfter(pre, code[j]);
+        pre = code[j];
+    }
+    TACInstr* pos = code[a.update - 1];
+    for (int j = b.test + 1; j < b.update; j++) {
+        optUnlink(fn, code[j]);
+        optInsertAfter(pos, code[j]);
+        pos = code[j];
+    }
+    for (int j = b.init; j < b.exit; j++) {
+        if (j > b.test && j < b.update) continue;      /* body b, moved */
+        TACInstr* in = code[j];
+        optUnlink(fn, in);
+        free(in->arg1); free(in->arg2); free(in->result); free(in);
+    }
+    return 1;
+}
+
+static void loopFusionPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int dead[OPT_MAX_FUNC_INSTRS];
+
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        int changed = 0, again = 1;
+        while (again) {
+            again = 0;
+            int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (n < 0) break;
+            for (int h = 2; h < n && !again; h++)
+                if (fuseTryLoop(code, n, h)) changed = again = 1;
+        }
+        int n = changed ? optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS) : -1;
+        if (n >= 0) {
+            for (int i = 0; i < n; i++) dead[i] = 0;
+            g_deadCodeElimCount += optCleanupFunc(code, n, dead);
+            optSweepFunc(code, n, dead);
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * LOOP UNSWITCHING
+ *
+ * A loop (LABEL L ... GOTO L) whose body branches on a condition
+ * that cannot change inside the loop is duplicated: the condition
+ * is evaluated once in front of the loop and selects one of two
+ * copies, each with the branch resolved.  The unreachable half of
+ * the if/else is then dropped from both copies.
+ *
+ *   Ls: ...                          c = cond
+ *       IF_FALSE c Lx                IF_FALSE c Ls'
+ *       then                         Ls:  ... then ... GOTO Ls
+ *       ...               ──►        Ls': ... else ... GOTO Ls'
+ *       GOTO Ls                      Le:
+ *   Le:
+ *
+ * Duplication is limited to loops of unswitchMaxLoop instructions
+ * and unswitchBudget new instructions per function.
+ * ========================================================= */
+static int unswitchMaxLoop = 96;     /* profile: unswitch-max-loop */
+static int unswitchBudget  = 256;    /* profile: unswitch-budget */
+
+typedef struct {
+    TACInstr** code;
+    int n, head, tail;            /* loop is code[head..tail] */
+} UnswitchLoop;
+
+static int unsDefinedIn(UnswitchLoop* lp, const char* name, int* where) {
+    int count = 0;
+    for (int i = lp->head; i <= lp->tail; i++)
+        if (optDefinesResult(lp->code[i]) && optSame(lp->code[i]->result, name)) {
+            if (where) *where = i;
+            count++;
+        }
+    return count;
+}
+
+static int unsAddressTaken(UnswitchLoop* lp, const char* name) {
+    for (int i = 1; i < lp->n; i++)
+        if (lp->code[i]->op == TAC_ADDR_OF && optSame(lp->code[i]->arg1, name)) return 1;
+    return 0;
+}
+
+/* Can name be computed before the loop?  Temps defined in the loop by a
+ * pure instruction are followed back; their defining instructions are
+ * added to chain[] so they can be moved to the preheader.  The preheader
+ * runs even when the loop body does not, so the chain may only hold
+ * instructions that cannot trap: the backend's add and sub trap on
+ * overflow and stay in the loop. */
+static int unsInvariant(UnswitchLoop* lp, const char* name, int* chain, int* nChain,
+                        int depth) {
+    if (!name || isConst(name)) return name != NULL;
+    if (name[0] == '"' || depth > 8) return 0;
+    int d = -1;
+    int defs = unsDefinedIn(lp, name, &d);
+    if (defs == 0) {
+        if (isTemporary((char*)name)) return 1;
+        VarType vt = getVarType((char*)name);
+        return (vt == TYPE_INT || vt == TYPE_FLOAT || vt == TYPE_CHAR) &&
+               !unsAddressTaken(lp, name);
+    }
+    if (defs != 1 || !isTemporary((char*)name)) return 0;
+
+    TACInstr* in = lp->code[d];
+    switch (in->op) {
+    case TAC_ASSIGN: case TAC_MULTIPLY:
+    case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+        break;
+    default:
+        return 0;           /* loads, calls, divides, adds and subs stay put */
+    }
+    /* the temp must not also be written outside the loop */
+    for (int i = 1; i < lp->n; i++)
+        if ((i < lp->head || i > lp->tail) && optDefinesResult(lp->code[i]) &&
+            optSame(lp->code[i]->result, name))
+            return 0;
+    if (!unsInvariant(lp, in->arg1, chain, nChain, depth + 1)) return 0;
+    if (in->op != TAC_ASSIGN && !unsInvariant(lp, in->arg2, chain, nChain, depth + 1))
+        return 0;
+    for (int k = 0; k < *nChain; k++)
+        if (chain[k] == d) return 1;
+    chain[(*nChain)++] = d;
+    return 1;
+}
+
+/* Every read of a chain temp must be inside the chain or the branch */
+static int unsChainPrivate(UnswitchLoop* lp, int* chain, int nChain, int branch) {
+    for (int c = 0; c < nChain; c++) {
+        const char* tmp = lp->code[chain[c]]->result;
+        for (int i = 1; i < lp->n; i++) {
+            TACInstr* in = lp->code[i];
+            int reads = optSame(in->arg1, tmp) || optSame(in->arg2, tmp) ||
+                        (!optDefinesResult(in) && optSame(in->result, tmp));
+            if (!reads || i == branch) continue;
+            int inChain = 0;
+            for (int k = 0; k < nChain; k++) if (chain[k] == i) inChain = 1;
+            if (!inChain) return 0;
+        }
+    }
+    return 1;
+}
+
+typedef struct { char* from; char* to; } UnsRename;
+
+static const char* unsRenamed(UnsRename* map, int count, const char* name) {
+    for (int k = 0; k < count; k++)
+        if (optSame(map[k].from, name)) return map[k].to;
+    return name;
+}
+
+/* Try to unswitch the loop code[head..tail]; returns the number of
+ * instructions added (0 if nothing was done). */
+static int unsTryLoop(UnswitchLoop* lp, int budget) {
+    TACInstr** code = lp->code;
+    int size = 0;
+    for (int i = lp->head; i <= lp->tail; i++)
+        if (code[i]->op != TAC_DECL && code[i]->op != TAC_ARRAY_DECL) size++;
+    if (size > unswitchMaxLoop || size > budget) return 0;
+
+    /* No jumps into the middle of the loop from outside */
+    for (int i = 1; i < lp->n; i++) {
+        if (i >= lp->head && i <= lp->tail) continue;
+        const char* tgt = code[i]->op == TAC_GOTO ? code[i]->arg1 :
+                          code[i]->op == TAC_IF_FALSE ? code[i]->result : NULL;
+        if (!tgt) continue;
+        for (int j = lp->head; j <= lp->tail; j++)
+            if (code[j]->op == TAC_LABEL && optSame(code[j]->arg1, tgt)) return 0;
+    }
+
+    const char* exitLabel = (lp->tail + 1 < lp->n && code[lp->tail + 1]->op == TAC_LABEL)
+                            ? code[lp->tail + 1]->arg1 : NULL;
+    int chain[16], nChain = 0, branch = -1;
+    for (int i = lp->head + 1; i < lp->tail && branch < 0; i++) {
+        if (code[i]->op != TAC_IF_FALSE || optSame(code[i]->result, exitLabel)) continue;
+        nChain = 0;
+        if (isConst(code[i]->arg1)) continue;
+        if (unsInvariant(lp, code[i]->arg1, chain, &nChain, 0) &&
+            unsChainPrivate(lp, chain, nChain, i))
+            branch = i;
+    }
+    if (branch < 0) return 0;
+
+    /* Rename labels defined in the loop and temps that live only in it */
+    UnsRename map[OPT_MAX_FUNC_INSTRS / 4];
+    int nMap = 0;
+    for (int i = lp->head; i <= lp->tail && nMap < OPT_MAX_FUNC_INSTRS / 4; i++) {
+        TACInstr* in = code[i];
+        if (in->op == TAC_LABEL) {
+            map[nMap].from = in->arg1;
+            map[nMap++].to = newLabel();
+        } else if (optDefinesResult(in) && isTemporary(in->result) &&
+                   unsRenamed(map, nMap, in->result) == in->result) {
+            int outside = 0;
+            for (int j = 1; j < lp->n && !outside; j++) {
+                if (j >= lp->head && j <= lp->tail) continue;
+                outside = optSame(code[j]->arg1, in->result) || optSame(code[j]->arg2, in->result) ||
+                          optSame(code[j]->result, in->result);
+            }
+            if (!outside) {
+                map[nMap].from = in->result;
+                map[nMap++].to = newTemp();
+            }
+        }
+    }
+
+    /* Copy for the false outcome, placed right after the original loop */
+    int added = 0;
+    TACInstr* pos = code[lp->tail];
+    for (int i = lp->head; i <= lp->tail; i++) {
+        TACInstr* in = code[i];
+        int inChain = 0;
+        for (int k = 0; k < nChain; k++) if (chain[k] == i) inChain = 1;
+        if (inChain || in->op == TAC_DECL || in->op == TAC_ARRAY_DECL) continue;
+        TACInstr* copy;
+        if (i == branch)
+            copy = createTAC(TAC_GOTO, (char*)unsRenamed(map, nMap, in->result), NULL, NULL);
+        else
+            copy = createTAC(in->op, (char*)unsRenamed(map, nMap, in->arg1),
+                             (char*)unsRenamed(map, nMap, in->arg2),
+                             (char*)unsRenamed(map, nMap, in->result));
+        optInsertAfter(pos, copy);
+        pos = copy;
+        added++;
+    }
+
+    /* The condition moves in front of the loop and picks the copy */
+    TACInstr* pre = code[lp->head - 1];
+    for (int c = 0; c < nChain; c++) {
+        /* chain[] is in dependency order: operands first */
+        TACInstr* in = code[chain[c]];
+        optUnlink(code[0], in);
+        optInsertAfter(pre, in);
+        pre = in;
+    }
+    optInsertAfter(pre, createTAC(TAC_IF_FALSE, code[branch]->arg1, NULL,
+                                  (char*)unsRenamed(map, nMap, code[lp->head]->arg1)));
+    added++;
+
+    fprintf(stderr, "\n⚡ Optimizer [unswitch]: loop %s in %s unswitched on %s\n\n",
+            code[lp->head]->arg1, code[0]->arg1, code[branch]->arg1);
+
+    /* The original copy takes the true outcome: the branch falls through */
+    optUnlink(code[0], code[branch]);
+
+    for (int k = 0; k < nMap; k++) free(map[k].to);
+    return added;
+}
+
+static void loopUnswitchPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int dead[OPT_MAX_FUNC_INSTRS];
+
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        int budget = unswitchBudget, changed = 0, again = 1;
+        while (again) {
+            again = 0;
+            int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (n < 0) break;
+            /* Outer loops first: their header comes first */
+            for (int h = 1; h < n && !again; h++) {
+                if (code[h]->op != TAC_LABEL) continue;
+                int g = -1;
+                for (int j = h + 1; j < n; j++)
+                    if (code[j]->op == TAC_GOTO && optSame(code[j]->arg1, code[h]->arg1)) g = j;
+                if (g < 0) continue;
+                UnswitchLoop lp = { code, n, h, g };
+                int added = unsTryLoop(&lp, budget);
+                if (added > 0) {
+                    budget -= added;
+                    changed = again = 1;
+                }
+            }
+        }
+        int n = changed ? optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS) : -1;
+        if (n >= 0) {
+            for (int i = 0; i < n; i++) dead[i] = 0;
+            g_deadCodeElimCount += optCleanupFunc(code, n, dead);
+            optSweepFunc(code, n, dead);
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * REASSOCIATION
+ *
+ * The front end builds "x + 1 + 2" as t1 = x + 1; t2 = t1 + 2, so
+ * the constants never meet in one instruction.  A chain of int +
+ * (or *) instructions linked through single-use temps is flattened
+ * into its leaves and rebuilt in rank order:
+ *
+ *   rank 0  constants      — all folded into one
+ *   rank 1  loop-invariant — not written in the innermost loop
+ *   rank 2  everything else
+ *
+ * so invariant subterms are computed together (ready to be hoisted)
+ * and the folded constant comes last, or joins the invariant group
+ * inside a loop.  "e - c" counts as "e + -c".  Floats are left
+ * alone: their addition is not associative.
+ * ========================================================= */
+#define REASSOC_MAX_LEAVES 16
+
+typedef struct { const char* name; int rank; } RaLeaf;
+
+typedef struct {
+    TACInstr** code;
+    int n;
+    VarType* tempTypes;
+    int nTemps;
+    int loopStart, loopEnd;          /* innermost loop around the root, or -1 */
+    TACOp op;                        /* TAC_ADD or TAC_MULTIPLY */
+    RaLeaf leaves[REASSOC_MAX_LEAVES];
+    int nLeaves;
+    long constant;                   /* folded constant, always an int value */
+    int nConsts;
+    int chain[REASSOC_MAX_LEAVES];   /* absorbed instructions, root excluded */
+    int nChain;
+    int first;                       /* earliest chain instruction */
+} RaChain;
+
+static int raIntConst(const char* s, long* val) {
+    if (!s || !isConst(s)) return 0;
+    char* end;
+    *val = strtol(s, &end, 10);
+    return *end == '\0' && *val >= -2147483648L && *val <= 2147483647L;
+}
+
+/* Is code[i] part of an add (op == TAC_ADD) or multiply chain? */
+static int raInChain(TACInstr* in, TACOp op) {
+    long c;
+    if (op == TAC_ADD)
+        return in->op == TAC_ADD || (in->op == TAC_SUBTRACT && raIntConst(in->arg2, &c));
+    return in->op == op;
+}
+
+static int raUses(RaChain* ch, const char* name) {
+    int uses = 0;
+    for (int i = 1; i < ch->n; i++) {
+        TACInstr* in = ch->code[i];
+        if (optSame(in->arg1, name) || optSame(in->arg2, name) ||
+            (!optDefinesResult(in) && optSame(in->result, name)))
+            uses++;
+    }
+    return uses;
+}
+
+static int raRank(RaChain* ch, const char* name) {
+    if (ch->loopStart < 0) return 1;
+    for (int i = ch->loopStart; i <= ch->loopEnd; i++)
+        if (optDefinesResult(ch->code[i]) && optSame(ch->code[i]->result, name)) return 2;
+    return 1;
+}
+
+static int raAddLeaf(RaChain* ch, const char* op, int negate) {
+    long c;
+    if (raIntConst(op, &c)) {
+        /* products wrap like the 32-bit multiply they replace; a sum
+         * that leaves int range is not folded, the chain as written may
+         * still stay in range for the values it meets at run time */
+        if (negate) c = -c;
+        if (ch->op == TAC_MULTIPLY) {
+            ch->constant = (int)((unsigned)ch->constant * (unsigned)c);
+        } else {
+            ch->constant += c;
+            if (ch->constant < -2147483648L || ch->constant > 2147483647L) return 0;
+        }
+        ch->nConsts++;
+        return 1;
+    }
+    VarType vt = memOperandType(op, ch->tempTypes, ch->nTemps);
+    if ((vt != TYPE_INT && vt != TYPE_CHAR) || ch->nLeaves >= REASSOC_MAX_LEAVES) return 0;
+    ch->leaves[ch->nLeaves].name = op;
+    ch->leaves[ch->nLeaves++].rank = raRank(ch, op);
+    return 1;
+}
+
+/* Collect the leaves of the chain rooted at code[i] */
+static int raFlatten(RaChain* ch, int i) {
+    TACInstr* in = ch->code[i];
+    const char* ops[2] = { in->arg1, in->arg2 };
+    for (int f = 0; f < 2; f++) {
+        const char* o = ops[f];
+        int negate = (f == 1 && in->op == TAC_SUBTRACT);
+        /* a single-use temp computed by the same kind of op in the same
+         * block is absorbed into the chain */
+        int d = -1;
+        if (!negate && isTemporary((char*)o) && raUses(ch, o) == 1) {
+            for (int j = i - 1; j >= 1; j--) {
+                TACOp jop = ch->code[j]->op;
+                if (jop == TAC_LABEL || jop == TAC_GOTO || jop == TAC_IF_FALSE) break;
+                if (optDefinesResult(ch->code[j]) && optSame(ch->code[j]->result, o)) {
+                    if (raInChain(ch->code[j], ch->op)) d = j;
+                    break;
+                }
+            }
+        }
+        if (d >= 0 && ch->nChain < REASSOC_MAX_LEAVES - 1) {
+            ch->chain[ch->nChain++] = d;
+            if (d < ch->first) ch->first = d;
+            if (!raFlatten(ch, d)) return 0;
+        } else if (!raAddLeaf(ch, o, negate)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void raFindLoop(RaChain* ch, int root) {
+    ch->loopStart = ch->loopEnd = -1;
+    for (int g = root; g < ch->n; g++) {
+        if (ch->code[g]->op != TAC_GOTO) continue;
+        for (int l = 1; l <= root; l++)
+            if (ch->code[l]->op == TAC_LABEL && optSame(ch->code[l]->arg1, ch->code[g]->arg1) &&
+                (ch->loopStart < 0 || l > ch->loopStart)) {
+                ch->loopStart = l;
+                ch->loopEnd = g;
+            }
+    }
+}
+
+/* Rebuild the chain rooted at code[root]; returns 1 if it was rewritten */
+static int raRewrite(RaChain* ch, int root) {
+    TACInstr* rootIn = ch->code[root];
+    TACOp op = rootIn->op == TAC_MULTIPLY ? TAC_MULTIPLY : TAC_ADD;
+    VarType rt = memOperandType(rootIn->result, ch->tempTypes, ch->nTemps);
+    if (rt != TYPE_INT && rt != TYPE_CHAR) return 0;
+
+    ch->op = op;
+    ch->nLeaves = ch->nConsts = ch->nChain = 0;
+    ch->constant = (op == TAC_MULTIPLY) ? 1 : 0;
+    ch->first = root;
+    raFindLoop(ch, root);
+    if (!raFlatten(ch, root)) return 0;
+
+    /* Leaves are re-read at the root: none may change in between */
+    for (int i = ch->first; i < root; i++) {
+        if (!optDefinesResult(ch->code[i])) continue;
+        for (int k = 0; k < ch->nLeaves; k++)
+            if (optSame(ch->code[i]->result, ch->leaves[k].name)) return 0;
+    }
+
+    long identity = (op == TAC_MULTIPLY) ? 1 : 0;
+    int useConst = ch->nConsts > 0 && ch->constant != identity;
+    int nInv = 0, nVar = 0;
+    for (int k = 0; k < ch->nLeaves; k++) {
+        if (ch->leaves[k].rank == 1) nInv++; else nVar++;
+    }
+    int before = ch->nChain + 1;
+    int after = (ch->nLeaves > 0 ? ch->nLeaves - 1 : 0) + (useConst ? 1 : 0);
+    if (after == 0) after = 1;                              /* a copy */
+    int zero = (op == TAC_MULTIPLY && ch->nConsts > 0 && ch->constant == 0);
+    int grouping = ch->loopStart >= 0 && nVar > 0 && nInv + useConst >= 2;
+    if (after >= before && !grouping && !zero) return 0;
+
+    /* Order: invariants, [constant,] variants, [constant] */
+    const char* order[REASSOC_MAX_LEAVES + 1];
+    int nOrder = 0;
+    char constBuf[32];
+    snprintf(constBuf, sizeof(constBuf), "%ld", ch->constant);
+    int constEarly = useConst && ch->loopStart >= 0 && nVar > 0;
+    for (int k = 0; k < ch->nLeaves; k++)
+        if (ch->leaves[k].rank == 1) order[nOrder++] = ch->leaves[k].name;
+    if (constEarly) order[nOrder++] = constBuf;
+    for (int k = 0; k < ch->nLeaves; k++)
+        if (ch->leaves[k].rank == 2) order[nOrder++] = ch->leaves[k].name;
+    if (useConst && !constEarly) order[nOrder++] = constBuf;
+
+    /* Names must be copied before the absorbed instructions are freed */
+    char* names[REASSOC_MAX_LEAVES + 1];
+    for (int k = 0; k < nOrder; k++) names[k] = strdup(order[k]);
+    TACInstr* pos = ch->code[root - 1];
+    for (int c = 0; c < ch->nChain; c++) {
+        TACInstr* dead = ch->code[ch->chain[c]];
+        if (pos == dead) pos = optPrev(ch->code[0], dead);
+        optUnlink(ch->code[0], dead);
+    }
+
+    if (zero) {
+        rootIn->op = TAC_ASSIGN;
+        optSet(&rootIn->arg1, "0");
+        optSet(&rootIn->arg2, NULL);
+    } else if (nOrder == 0) {
+        rootIn->op = TAC_ASSIGN;
+        optSet(&rootIn->arg1, op == TAC_MULTIPLY ? "1" : "0");
+        optSet(&rootIn->arg2, NULL);
+    } else if (nOrder == 1) {
+        rootIn->op = TAC_ASSIGN;
+        optSet(&rootIn->arg1, names[0]);
+        optSet(&rootIn->arg2, NULL);
+    } else {
+        char* acc = strdup(names[0]);
+        for (int k = 1; k < nOrder - 1; k++) {
+            char* tmp = newTemp();
+            TACInstr* step = createTAC(op, acc, names[k], tmp);
+            optInsertAfter(pos, step);
+            pos = step;
+            free(acc);
+            acc = tmp;
+        }
+        const char* last = names[nOrder - 1];
+        long c;
+        TACOp lastOp = op;
+        char negBuf[32];
+        if (op == TAC_ADD && useConst && !constEarly && raIntConst(last, &c) && c < 0) {
+            snprintf(negBuf, sizeof(negBuf), "%ld", -c);
+            last = negBuf;
+            lastOp = TAC_SUBTRACT;
+        }
+        rootIn->op = lastOp;
+        optSet(&rootIn->arg1, acc);
+        optSet(&rootIn->arg2, last);
+        free(acc);
+    }
+    for (int k = 0; k < nOrder; k++) free(names[k]);
+    g_constFoldCount += ch->nConsts > 1 ? ch->nConsts - 1 : 0;
+    return 1;
+}
+
+static void reassociationPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static VarType tempTypes[8192];
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        RaChain ch;
+        ch.code = code;
+        ch.tempTypes = tempTypes;
+        ch.nTemps = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+        ch.n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+        if (ch.n < 0) {
+            exitFunction();
+            continue;
+        }
+        memInferTempTypes(code, ch.n, tempTypes, ch.nTemps);
+        int rewritten = 0;
+        for (int i = ch.n - 1; i >= 1; i--) {
+            TACInstr* in = code[i];
+            if (!raInChain(in, TAC_ADD) && !raInChain(in, TAC_MULTIPLY)) continue;
+            /* roots only: skip instructions a later chain will absorb */
+            if (isTemporary(in->result) && raUses(&ch, in->result) == 1) {
+                int absorbed = 0;
+                TACOp kind = in->op == TAC_MULTIPLY ? TAC_MULTIPLY : TAC_ADD;
+                for (int j = i + 1; j < ch.n; j++) {
+                    TACInstr* u = code[j];
+                    if (u->op == TAC_LABEL || u->op == TAC_GOTO || u->op == TAC_IF_FALSE) break;
+                    if (optSame(u->arg1, in->result) ||
+                        (optSame(u->arg2, in->result) && u->op != TAC_SUBTRACT)) {
+                        absorbed = raInChain(u, kind);
+                        break;
+                    }
+                }
+                if (absorbed) continue;
+            }
+            if (raRewrite(&ch, i)) {
+                rewritten++;
+                ch.n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+                if (ch.n < 0) break;
+                memInferTempTypes(code, ch.n, tempTypes, ch.nTemps);
+                /* carry on above the root; the new steps are absorbed */
+                for (i = 1; i < ch.n && code[i] != in; i++) {}
+            }
+        }
+        if (rewritten)
+            fprintf(stderr, "\n⚡ Optimizer [reassoc]: %s — %d expression chain(s) regrouped\n\n",
+                    fn->arg1, rewritten);
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * E-GRAPH REWRITING (EQUALITY SATURATION)
+ *
+ * For each basic block with a few int computations, the values the
+ * block computes are entered into an e-graph: nodes are operations
+ * over e-classes, and an e-class is a set of expressions known to
+ * be equal.  Rewrite rules (commutativity, identities, constant
+ * folding and re-grouping, x*k1 + x*k2 = x*(k1+k2), comparison
+ * mirroring and x + k1 == k2 → x == k2 - k1) only ever add
+ * equalities, so the order they fire in does not matter.  They run
+ * until nothing new appears or the node budget is spent.
+ *
+ * Each computation in the block is then re-derived from the
+ * cheapest member of its e-class under a MIPS cost model, where
+ * a value already held by some name costs one load:
+ *
+ *   name / constant 1 (lw / li)     +, -, <, >, <=, >=   1
+ *   x * 2^k         1 (sll)         ==, !=               2
+ *   x * y           2 (mult, mflo)
+ *
+ * A computation whose value is already in its own result is
+ * dropped; one whose value is in another name becomes a copy.
+ * ========================================================= */
+#define EG_MAX_NODES  512
+#define EG_MAX_NAMES  256
+#define EG_INF        1000000
+
+static int egraphRounds = 8;         /* profile: egraph-rounds */
+
+typedef enum { EG_CONST, EG_LEAF, EG_ADD, EG_SUB, EG_MUL,
+               EG_EQ, EG_NE, EG_LT, EG_GT, EG_LE, EG_GE } EgOp;
+
+typedef struct { EgOp op; int a, b; long val; } EgNode;    /* val: constant or leaf id */
+
+typedef struct {
+    EgNode node[EG_MAX_NODES];
+    int    cls[EG_MAX_NODES];        /* e-class of each node */
+    int    parent[EG_MAX_NODES];     /* union-find over class ids */
+    int    n;
+    int    nLeaves;
+} EGraph;
+
+/* Which name holds which e-class at the current point of the block */
+typedef struct {
+    char* name[EG_MAX_NAMES];
+    int   cls[EG_MAX_NAMES];
+    int   n;
+} EgHolders;
+
+static int egFind(EGraph* g, int c) {
+    if (c < 0) return -1;
+    while (g->parent[c] != c) c = g->parent[c] = g->parent[g->parent[c]];
+    return c;
+}
+
+static int egAdd(EGraph* g, EgOp op, int a, int b, long val) {
+    if ((op != EG_CONST && op != EG_LEAF) && (a < 0 || b < 0)) return -1;
+    a = egFind(g, a);
+    b = egFind(g, b);
+    for (int i = 0; i < g->n; i++) {
+        EgNode* nd = &g->node[i];
+        if (nd->op == op && nd->val == val && egFind(g, nd->a) == a && egFind(g, nd->b) == b)
+            return egFind(g, g->cls[i]);
+    }
+    if (g->n >= EG_MAX_NODES) return -1;
+    int k = g->n++;
+    g->node[k].op = op;
+    g->node[k].a = a;
+    g->node[k].b = b;
+    g->node[k].val = val;
+    g->cls[k] = g->parent[k] = k;
+    return k;
+}
+
+static int egConstNode(EGraph* g, long v) { return egAdd(g, EG_CONST, -1, -1, (long)(int)v); }
+static int egNewLeaf(EGraph* g) { return egAdd(g, EG_LEAF, -1, -1, g->nLeaves++); }
+
+static int egMerge(EGraph* g, int x, int y) {
+    x = egFind(g, x);
+    y = egFind(g, y);
+    if (x < 0 || y < 0 || x == y) return 0;
+    g->parent[y] = x;
+    return 1;
+}
+
+/* Restore congruence: nodes with equal operands belong to one class */
+static void egRebuild(EGraph* g) {
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < g->n; i++)
+            for (int j = i + 1; j < g->n; j++) {
+                EgNode* p = &g->node[i];
+                EgNode* q = &g->node[j];
+                if (p->op == q->op && p->val == q->val &&
+                    egFind(g, p->a) == egFind(g, q->a) && egFind(g, p->b) == egFind(g, q->b))
+                    changed |= egMerge(g, g->cls[i], g->cls[j]);
+            }
+    }
+}
+
+static int egConstOf(EGraph* g, int c, long* val) {
+    c = egFind(g, c);
+    for (int i = 0; i < g->n; i++)
+        if (g->node[i].op == EG_CONST && egFind(g, g->cls[i]) == c) {
+            *val = g->node[i].val;
+            return 1;
+        }
+    return 0;
+}
+
+static int egEval(EgOp op, long a, long b, long* v) {
+    unsigned ua = (unsigned)a, ub = (unsigned)b;
+    switch (op) {
+    case EG_ADD: *v = (int)(ua + ub); return 1;
+    case EG_SUB: *v = (int)(ua - ub); return 1;
+    case EG_MUL: *v = (int)(ua * ub); return 1;
+    case EG_EQ:  *v = a == b; return 1;
+    case EG_NE:  *v = a != b; return 1;
+    case EG_LT:  *v = a <  b; return 1;
+    case EG_GT:  *v = a >  b; return 1;
+    case EG_LE:  *v = a <= b; return 1;
+    case EG_GE:  *v = a >= b; return 1;
+    default:     return 0;
+    }
+}
+
+static EgOp egFromTac(TACOp op) {
+    switch (op) {
+    case TAC_ADD: return EG_ADD;  case TAC_SUBTRACT: return EG_SUB;
+    case TAC_MULTIPLY: return EG_MUL;
+    case TAC_EQ: return EG_EQ;    case TAC_NE: return EG_NE;
+    case TAC_LT: return EG_LT;    case TAC_GT: return EG_GT;
+    case TAC_LE: return EG_LE;    default: return EG_GE;
+    }
+}
+
+static TACOp egToTac(EgOp op) {
+    switch (op) {
+    case EG_ADD: return TAC_ADD;  case EG_SUB: return TAC_SUBTRACT;
+    case EG_MUL: return TAC_MULTIPLY;
+    case EG_EQ: return TAC_EQ;    case EG_NE: return TAC_NE;
+    case EG_LT: return TAC_LT;    case EG_GT: return TAC_GT;
+    case EG_LE: return TAC_LE;    default: return TAC_GE;
+    }
+}
+
+static EgOp egMirror(EgOp op) {
+    switch (op) {
+    case EG_LT: return EG_GT;  case EG_GT: return EG_LT;
+    case EG_LE: return EG_GE;  case EG_GE: return EG_LE;
+    default:    return op;
+    }
+}
+
+/* Apply the rule set until saturation or the node budget */
+static void egSaturate(EGraph* g) {
+    for (int round = 0; round < egraphRounds; round++) {
+        int before = g->n, merged = 0, count = g->n;
+#define EG_SAME(x) do { int _x = (x); if (_x >= 0) merged |= egMerge(g, c, _x); } while (0)
+        for (int i = 0; i < count; i++) {
+            EgNode nd = g->node[i];
+            if (nd.op == EG_CONST || nd.op == EG_LEAF) continue;
+            int c = egFind(g, g->cls[i]), A = egFind(g, nd.a), B = egFind(g, nd.b);
+            long ka = 0, kb = 0, v;
+            int hasA = egConstOf(g, A, &ka), hasB = egConstOf(g, B, &kb);
+            if (hasA && hasB) {
+                if (egEval(nd.op, ka, kb, &v)) EG_SAME(egConstNode(g, v));
+                continue;
+            }
+            switch (nd.op) {
+            case EG_ADD:
+                EG_SAME(egAdd(g, EG_ADD, B, A, 0));
+                if (hasB && kb == 0) EG_SAME(A);
+                if (A == B) EG_SAME(egAdd(g, EG_MUL, A, egConstNode(g, 2), 0));
+                for (int j = 0; j < g->n; j++) {
+                    EgNode* m = &g->node[j];
+                    if (egFind(g, g->cls[j]) != A) continue;
+                    long k1, k2;
+                    /* (x + k1) + k2 = x + (k1 + k2) */
+                    if (hasB && m->op == EG_ADD && egConstOf(g, m->b, &k1))
+                        EG_SAME(egAdd(g, EG_ADD, m->a, egConstNode(g, k1 + kb), 0));
+                    /* (x - y) + y = x */
+                    if (m->op == EG_SUB && egFind(g, m->b) == B) EG_SAME(m->a);
+                    if (m->op != EG_MUL || !egConstOf(g, m->b, &k1)) continue;
+                    /* x*k1 + x = x*(k1 + 1) */
+                    if (egFind(g, m->a) == B)
+                        EG_SAME(egAdd(g, EG_MUL, m->a, egConstNode(g, k1 + 1), 0));
+                    /* x*k1 + x*k2 = x*(k1 + k2) */
+                    for (int q = 0; q < g->n; q++) {
+                        EgNode* o = &g->node[q];
+                        if (egFind(g, g->cls[q]) == B && o->op == EG_MUL &&
+                            egFind(g, o->a) == egFind(g, m->a) && egConstOf(g, o->b, &k2))
+                            EG_SAME(egAdd(g, EG_MUL, m->a, egConstNode(g, k1 + k2), 0));
+                    }
+                }
+                break;
+            case EG_SUB:
+                if (hasB) EG_SAME(egAdd(g, EG_ADD, A, egConstNode(g, -kb), 0));
+                if (A == B) EG_SAME(egConstNode(g, 0));
+                for (int j = 0; j < g->n; j++) {
+                    EgNode* m = &g->node[j];
+                    long k1;
+                    if (egFind(g, g->cls[j]) != A) continue;
+                    /* x*k1 - x = x*(k1 - 1) */
+                    if (m->op == EG_MUL && egFind(g, m->a) == B && egConstOf(g, m->b, &k1))
+                        EG_SAME(egAdd(g, EG_MUL, m->a, egConstNode(g, k1 - 1), 0));
+                    if (m->op != EG_ADD) continue;
+                    /* (x + y) - y = x,  (x + y) - x = y */
+                    if (egFind(g, m->b) == B) EG_SAME(m->a);
+                    if (egFind(g, m->a) == B) EG_SAME(m->b);
+                }
+                break;
+            case EG_MUL:
+                EG_SAME(egAdd(g, EG_MUL, B, A, 0));
+                if (hasB && kb == 1) EG_SAME(A);
+                if (hasB && kb == 0) EG_SAME(egConstNode(g, 0));
+                for (int j = 0; hasB && j < g->n; j++) {
+                    EgNode* m = &g->node[j];
+                    long k1;
+                    /* (x * k1) * k2 = x * (k1 * k2) */
+                    if (egFind(g, g->cls[j]) == A && m->op == EG_MUL && egConstOf(g, m->b, &k1))
+                        EG_SAME(egAdd(g, EG_MUL, m->a, egConstNode(g, k1 * kb), 0));
+                }
+                break;
+            case EG_EQ: case EG_NE:
+                EG_SAME(egAdd(g, nd.op, B, A, 0));
+                if (A == B) EG_SAME(egConstNode(g, nd.op == EG_EQ));
+                for (int j = 0; hasB && j < g->n; j++) {
+                    EgNode* m = &g->node[j];
+                    long k1;
+                    if (egFind(g, g->cls[j]) != A) continue;
+                    /* x + k1 == k2  →  x == k2 - k1  (exact under wrap-around) */
+                    if (m->op == EG_ADD && egConstOf(g, m->b, &k1))
+                        EG_SAME(egAdd(g, nd.op, m->a, egConstNode(g, kb - k1), 0));
+                    /* x - y == 0  →  x == y */
+                    if (m->op == EG_SUB && kb == 0)
+                        EG_SAME(egAdd(g, nd.op, m->a, m->b, 0));
+                }
+                break;
+            default:                                   /* <, >, <=, >= */
+                EG_SAME(egAdd(g, egMirror(nd.op), B, A, 0));
+                if (A == B) EG_SAME(egConstNode(g, nd.op == EG_LE || nd.op == EG_GE));
+                break;
+            }
+        }
+#undef EG_SAME
+        egRebuild(g);
+        if ((!merged && g->n == before) || g->n >= EG_MAX_NODES - 16) break;
+    }
+}
+
+static int egPow2(EGraph* g, int c) {
+    long k;
+    if (!egConstOf(g, c, &k) || k < 1 || (k & (k - 1))) return -1;
+    int s = 0;
+    while ((1L << s) < k) s++;
+    return s;
+}
+
+static int egNodeCost(EGraph* g, int i, int* cost) {
+    EgNode* nd = &g->node[i];
+    if (nd->op == EG_CONST) return 1;
+    if (nd->op == EG_LEAF) return EG_INF;
+    int ca = cost[egFind(g, nd->a)], cb = cost[egFind(g, nd->b)];
+    int c;
+    if (nd->op == EG_MUL && egPow2(g, nd->b) >= 0)      c = 1 + ca;
+    else if (nd->op == EG_MUL && egPow2(g, nd->a) >= 0) c = 1 + cb;
+    else if (nd->op == EG_MUL)                          c = 2 + ca + cb;
+    else if (nd->op == EG_EQ || nd->op == EG_NE)        c = 2 + ca + cb;
+    else                                                c = 1 + ca + cb;
+    return c < EG_INF ? c : EG_INF;
+}
+
+static const char* egHolder(EGraph* g, EgHolders* h, int c) {
+    c = egFind(g, c);
+    for (int k = 0; k < h->n; k++)
+        if (egFind(g, h->cls[k]) == c) return h->name[k];
+    return NULL;
+}
+
+static void egSetHolder(EgHolders* h, const char* name, int c) {
+    for (int k = 0; k < h->n; k++)
+        if (optSame(h->name[k], name)) {
+            h->cls[k] = c;
+            return;
+        }
+    if (h->n < EG_MAX_NAMES) {
+        h->name[h->n] = strdup(name);
+        h->cls[h->n++] = c;
+    }
+}
+
+/* Cheapest cost of every class, given what the holders already have;
+ * exclude hides one name (the result about to be overwritten) */
+static void egCosts(EGraph* g, EgHolders* h, const char* exclude, int* cost) {
+    for (int i = 0; i < g->n; i++) cost[i] = EG_INF;
+    for (int k = 0; k < h->n; k++)
+        if (!optSame(h->name[k], exclude)) cost[egFind(g, h->cls[k])] = 1;
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (int i = 0; i < g->n; i++) {
+            int c = egFind(g, g->cls[i]);
+            int nc = egNodeCost(g, i, cost);
+            if (nc < cost[c]) {
+                cost[c] = nc;
+                changed = 1;
+            }
+        }
+    }
+}
+
+static int egBestNode(EGraph* g, int c, int* cost) {
+    c = egFind(g, c);
+    for (int i = 0; i < g->n; i++)
+        if (egFind(g, g->cls[i]) == c && g->node[i].op != EG_LEAF &&
+            egNodeCost(g, i, cost) == cost[c])
+            return i;
+    return -1;
+}
+
+/* Name or constant holding class c, emitting temps in front of at */
+static char* egOperand(EGraph* g, EgHolders* h, int c, int* cost, TACInstr* fn, TACInstr* at,
+                       const char* exclude) {
+    const char* held = NULL;
+    for (int k = 0; k < h->n; k++)
+        if (egFind(g, h->cls[k]) == egFind(g, c) && !optSame(h->name[k], exclude))
+            held = h->name[k];
+    if (held) return strdup(held);
+    int i = egBestNode(g, c, cost);
+    char buf[32];
+    if (g->node[i].op == EG_CONST) {
+        snprintf(buf, sizeof(buf), "%ld", g->node[i].val);
+        return strdup(buf);
+    }
+    char* a = egOperand(g, h, g->node[i].a, cost, fn, at, exclude);
+    char* b = egOperand(g, h, g->node[i].b, cost, fn, at, exclude);
+    char* tmp = newTemp();
+    optInsertAfter(optPrev(fn, at), createTAC(egToTac(g->node[i].op), a, b, tmp));
+    egSetHolder(h, tmp, c);
+    free(a);
+    free(b);
+    return tmp;
+}
+
+static int egIsPureOp(TACOp op) {
+    return op == TAC_ASSIGN || op == TAC_ADD || op == TAC_SUBTRACT || op == TAC_MULTIPLY ||
+           (op >= TAC_EQ && op <= TAC_GE);
+}
+
+/* Rewrite the block blk[0..m); returns the number of instructions changed */
+static int egBlock(TACInstr* fn, TACInstr** blk, int m, VarType* tempTypes, int nTemps) {
+    static EGraph g;
+    static int valueCls[OPT_MAX_FUNC_INSTRS], cost[EG_MAX_NODES];
+    static int pure[OPT_MAX_FUNC_INSTRS];
+    EgHolders cur, entry;
+    cur.n = entry.n = 0;
+    g.n = g.nLeaves = 0;
+
+    /* ── Build: value numbering into the e-graph ── */
+    int nPure = 0, ok = 1;
+    for (int k = 0; k < m && ok; k++) {
+        TACInstr* in = blk[k];
+        valueCls[k] = -1;
+        pure[k] = 0;
+        if (!optDefinesResult(in)) continue;
+        int isPure = egIsPureOp(in->op);
+        const char* ops[2] = { in->arg1, in->op == TAC_ASSIGN ? NULL : in->arg2 };
+        VarType rt = memOperandType(in->result, tempTypes, nTemps);
+        if (rt != TYPE_INT && rt != TYPE_CHAR) isPure = 0;
+        int cls[2] = { -1, -1 };
+        for (int f = 0; f < 2 && isPure; f++) {
+            if (!ops[f]) continue;
+            long v;
+            VarType vt = memOperandType(ops[f], tempTypes, nTemps);
+            if ((vt != TYPE_INT && vt != TYPE_CHAR) || ops[f][0] == '"') { isPure = 0; break; }
+            if (raIntConst(ops[f], &v)) { cls[f] = egConstNode(&g, v); continue; }
+            const char* held = NULL;
+            for (int q = 0; q < cur.n; q++)
+                if (optSame(cur.name[q], ops[f])) { held = cur.name[q]; cls[f] = cur.cls[q]; }
+            if (!held) {
+                cls[f] = egNewLeaf(&g);
+                egSetHolder(&cur, ops[f], cls[f]);
+                egSetHolder(&entry, ops[f], cls[f]);
+            }
+        }
+        int c;
+        if (!isPure)                    c = egNewLeaf(&g);
+        else if (in->op == TAC_ASSIGN)  c = cls[0];
+        else                            c = egAdd(&g, egFromTac(in->op), cls[0], cls[1], 0);
+        if (c < 0) { ok = 0; break; }
+        pure[k] = isPure;
+        nPure += isPure && in->op != TAC_ASSIGN;
+        valueCls[k] = c;
+        egSetHolder(&cur, in->result, c);
+    }
+    for (int q = 0; q < cur.n; q++) free(cur.name[q]);
+    if (!ok || nPure < 3) {
+        for (int q = 0; q < entry.n; q++) free(entry.name[q]);
+        return 0;
+    }
+
+    egSaturate(&g);
+
+    /* ── Extract: re-derive every computation from its cheapest form ── */
+    int changed = 0;
+    EgHolders* h = &entry;
+    for (int k = 0; k < m; k++) {
+        TACInstr* in = blk[k];
+        if (valueCls[k] < 0) continue;
+        int c = egFind(&g, valueCls[k]);
+        if (pure[k]) {
+            int origCost;
+            if (in->op == TAC_ASSIGN) {
+                origCost = 1;
+            } else {
+                long kv;
+                int shift = in->op == TAC_MULTIPLY &&
+                            ((raIntConst(in->arg2, &kv) && kv > 0 && !(kv & (kv - 1))) ||
+                             (raIntConst(in->arg1, &kv) && kv > 0 && !(kv & (kv - 1))));
+                origCost = shift ? 2 :
+                           (in->op == TAC_MULTIPLY || in->op == TAC_EQ || in->op == TAC_NE) ? 4 : 3;
+            }
+            const char* self = egHolder(&g, h, c);
+            int selfHeld = 0;
+            for (int q = 0; q < h->n; q++)
+                if (optSame(h->name[q], in->result) && egFind(&g, h->cls[q]) == c) selfHeld = 1;
+            if (selfHeld) {
+                /* the result already holds this value */
+                optUnlink(fn, in);
+                free(in->arg1); free(in->arg2); free(in->result); free(in);
+                changed++;
+                continue;
+            }
+            egCosts(&g, h, in->result, cost);
+            if (self && cost[c] == 1 && origCost > 1) {
+                in->op = TAC_ASSIGN;
+                optSet(&in->arg1, self);
+                optSet(&in->arg2, NULL);
+                changed++;
+            } else if (cost[c] < origCost) {
+                int i = egBestNode(&g, c, cost);
+                if (g.node[i].op == EG_CONST) {
+                    char buf[32];
+                    snprintf(buf, sizeof(buf), "%ld", g.node[i].val);
+                    in->op = TAC_ASSIGN;
+                    optSet(&in->arg1, buf);
+                    optSet(&in->arg2, NULL);
+                } else {
+                    char* a = egOperand(&g, h, g.node[i].a, cost, fn, in, in->result);
+                    char* b = egOperand(&g, h, g.node[i].b, cost, fn, in, in->result);
+                    in->op = egToTac(g.node[i].op);
+                    optSet(&in->arg1, a);
+                    optSet(&in->arg2, b);
+                    free(a);
+                    free(b);
+                }
+                changed++;
+            }
+        }
+        egSetHolder(h, in->result, c);
+    }
+    for (int q = 0; q < h->n; q++) free(h->name[q]);
+    return changed;
+}
+
+/* Drop pure computations into temps nobody reads any more */
+static int egSweepTemps(TACInstr** code, int n) {
+    static int dead[OPT_MAX_FUNC_INSTRS];
+    int removed = 0, again = 1;
+    for (int i = 0; i < n; i++) dead[i] = 0;
+    while (again) {
+        again = 0;
+        for (int i = 1; i < n; i++) {
+            TACInstr* in = code[i];
+            if (dead[i] || !egIsPureOp(in->op) || !isTemporary(in->result)) continue;
+            int used = 0;
+            for (int j = 1; j < n && !used; j++)
+                if (!dead[j] && j != i &&
+                    (optSame(code[j]->arg1, in->result) || optSame(code[j]->arg2, in->result) ||
+                     (!optDefinesResult(code[j]) && optSame(code[j]->result, in->result))))
+                    used = 1;
+            if (!used) {
+                dead[i] = 1;
+                removed++;
+                again = 1;
+            }
+        }
+    }
+    optSweepFunc(code, n, dead);
+    return removed;
+}
+
+static void egraphPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static TACInstr* blk[OPT_MAX_FUNC_INSTRS];
+    static VarType tempTypes[8192];
+    int nTemps = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+        if (n < 0) {
+            exitFunction();
+            continue;
+        }
+        memInferTempTypes(code, n, tempTypes, nTemps);
+        int changed = 0;
+        /* blocks are cut at labels and after jumps */
+        int start = 1;
+        for (int i = 1; i <= n; i++) {
+            int cut = (i == n) || code[i]->op == TAC_LABEL ||
+                      code[i - 1]->op == TAC_GOTO || code[i - 1]->op == TAC_IF_FALSE ||
+                      code[i - 1]->op == TAC_RETURN;
+            if (!cut || i == start) continue;
+            int m = 0;
+            for (int k = start; k < i; k++) blk[m++] = code[k];
+            changed += egBlock(fn, blk, m, tempTypes, nTemps);
+            start = i;
+        }
+        if (changed) {
+            n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            int swept = n < 0 ? 0 : egSweepTemps(code, n);
+            g_deadCodeElimCount += swept;
+            fprintf(stderr, "\n⚡ Optimizer [egraph]: %s — %d computation(s) re-derived,"
+                    " %d dead temp(s) removed\n\n", fn->arg1, changed, swept);
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * PARTIAL REDUNDANCY ELIMINATION (LAZY CODE MOTION)
+ *
+ * An expression computed on some paths into a point and again after
+ * it (e.g. in the then-arm and after the merge label) is computed
+ * once per path instead: a new temp receives the value on the paths
+ * that lacked it, and the later computations become copies of it.
+ *
+ * This is the four-pass formulation (anticipated, available,
+ * postponable, used) over basic blocks.  Critical edges get a node
+ * of their own so code can be placed on them; an edge node that
+ * receives code becomes a real block.  Placement is the latest
+ * point that still removes the redundancy, which keeps the new
+ * temps' live ranges short.
+ *
+ * Only int +, -, * and comparisons on scalars whose address is
+ * never taken are moved; they cannot trap.
+ * ========================================================= */
+#define LCM_MAX_EXPRS 256
+#define LCM_WORDS     (LCM_MAX_EXPRS / 32)
+
+typedef struct { unsigned w[LCM_WORDS]; } LcmSet;
+
+typedef struct { TACOp op; char* a; char* b; char* temp; } LcmExpr;   /* owns a, b */
+
+typedef struct {
+    int start, end;          /* code[start..end) for blocks; empty for edge nodes */
+    int succ[2], nSucc;
+    int from, to;            /* edge nodes: the CFG edge they sit on */
+    int fallthrough;         /* edge node on the not-taken side of an IF_FALSE */
+    LcmSet use, kill;
+    LcmSet antIn, antOut, avIn, avOut, earliest, postIn, postOut, latest, usedIn, usedOut;
+} LcmNode;
+
+static void lcmFill(LcmSet* s, int full) {
+    for (int k = 0; k < LCM_WORDS; k++) s->w[k] = full ? ~0u : 0u;
+}
+static int  lcmHas(const LcmSet* s, int x) { return (s->w[x / 32] >> (x % 32)) & 1u; }
+static void lcmAdd(LcmSet* s, int x)       { s->w[x / 32] |= 1u << (x % 32); }
+static int  lcmEqual(const LcmSet* a, const LcmSet* b) {
+    return memcmp(a->w, b->w, sizeof(a->w)) == 0;
+}
+
+static int lcmIsCandidateOp(TACOp op) {
+    return op == TAC_ADD || op == TAC_SUBTRACT || op == TAC_MULTIPLY ||
+           op == TAC_EQ || op == TAC_NE || op == TAC_LT || op == TAC_GT ||
+           op == TAC_LE || op == TAC_GE;
+}
+
+static const char* lcmOpSymbol(TACOp op) {
+    switch (op) {
+    case TAC_ADD: return "+";       case TAC_SUBTRACT: return "-";
+    case TAC_MULTIPLY: return "*";  case TAC_EQ: return "==";
+    case TAC_NE: return "!=";       case TAC_LT: return "<";
+    case TAC_GT: return ">";        case TAC_LE: return "<=";
+    default: return ">=";
+    }
+}
+
+/* Name written by code[i] (results and incoming params), or NULL */
+static const char* lcmDefined(TACInstr* in) {
+    if (optDefinesResult(in)) return in->result;
+    if (in->op == TAC_PARAM) return in->arg1;
+    return NULL;
+}
+
+static int lcmFindExpr(LcmExpr* ex, int nEx, TACInstr* in) {
+    for (int x = 0; x < nEx; x++)
+        if (ex[x].op == in->op && optSame(ex[x].a, in->arg1) && optSame(ex[x].b, in->arg2))
+            return x;
+    return -1;
+}
+
+static int lcmKills(LcmExpr* e, const char* def) {
+    return def && (optSame(e->a, def) || optSame(e->b, def));
+}
+
+static void lcmFunc(TACInstr** code, int n) {
+    static LcmExpr ex[LCM_MAX_EXPRS];
+    static VarType tempTypes[8192];
+    int nTemps = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+    int nEx = 0;
+    memInferTempTypes(code, n, tempTypes, nTemps);
+
+    /* ── Expression universe ── */
+    for (int i = 1; i < n && nEx < LCM_MAX_EXPRS; i++) {
+        TACInstr* in = code[i];
+        if (!lcmIsCandidateOp(in->op) || lcmFindExpr(ex, nEx, in) >= 0) continue;
+        if (isConst(in->arg1) && isConst(in->arg2)) continue;
+        int ok = 1;
+        const char* ops[2] = { in->arg1, in->arg2 };
+        for (int f = 0; f < 2 && ok; f++) {
+            VarType vt = memOperandType(ops[f], tempTypes, nTemps);
+            if (vt != TYPE_INT && vt != TYPE_CHAR) ok = 0;
+            for (int j = 1; j < n && ok; j++)
+                if (code[j]->op == TAC_ADDR_OF && optSame(code[j]->arg1, ops[f])) ok = 0;
+        }
+        if (!ok) continue;
+        ex[nEx].op = in->op;
+        ex[nEx].a = strdup(in->arg1);
+        ex[nEx].b = strdup(in->arg2);
+        ex[nEx].temp = NULL;
+        nEx++;
+    }
+    if (nEx == 0) return;
+
+    /* ── Basic blocks ── */
+    int* blockOf = malloc(sizeof(int) * n);
+    int nb = 0;
+    for (int i = 1; i < n; i++) {
+        TACOp pop = code[i - 1]->op;
+        if (i == 1 || code[i]->op == TAC_LABEL ||
+            pop == TAC_GOTO || pop == TAC_IF_FALSE || pop == TAC_RETURN) nb++;
+        blockOf[i] = nb - 1;
+    }
+    int maxNodes = 3 * nb;
+    LcmNode* nd = calloc(maxNodes, sizeof(LcmNode));
+    int* nPred = calloc(maxNodes, sizeof(int));
+    for (int i = 1; i < n; i++) {
+        LcmNode* b = &nd[blockOf[i]];
+        if (i == 1 || blockOf[i] != blockOf[i - 1]) b->start = i;
+        b->end = i + 1;
+    }
+    for (int k = 0; k < nb; k++) {
+        LcmNode* b = &nd[k];
+        TACInstr* last = code[b->end - 1];
+        b->from = b->to = -1;
+        const char* target = last->op == TAC_GOTO ? last->arg1 :
+                             last->op == TAC_IF_FALSE ? last->result : NULL;
+        if (last->op != TAC_GOTO && last->op != TAC_RETURN && k + 1 < nb)
+            b->succ[b->nSucc++] = k + 1;
+        if (target)
+            for (int j = 1; j < n; j++)
+                if (code[j]->op == TAC_LABEL && optSame(code[j]->arg1, target)) {
+                    if (b->nSucc == 0 || b->succ[0] != blockOf[j])
+                        b->succ[b->nSucc++] = blockOf[j];
+                    break;
+                }
+        for (int s = 0; s < b->nSucc; s++) nPred[b->succ[s]]++;
+    }
+    /* Split critical edges */
+    int nn = nb;
+    for (int k = 0; k < nb; k++) {
+        if (nd[k].nSucc < 2) continue;
+        for (int s = 0; s < 2; s++) {
+            int to = nd[k].succ[s];
+            if (nPred[to] < 2) continue;
+            if (code[nd[to].start]->op != TAC_LABEL) goto done;    /* not expected */
+            LcmNode* e = &nd[nn];
+            e->start = e->end = 0;
+            e->from = k;
+            e->to = to;
+            e->fallthrough = (to == k + 1 && s == 0);
+            e->succ[0] = to;
+            e->nSucc = 1;
+            nd[k].succ[s] = nn++;
+        }
+    }
+
+    /* ── Local sets: upward-exposed uses and kills ── */
+    for (int k = 0; k < nb; k++) {
+        LcmNode* b = &nd[k];
+        for (int i = b->start; i < b->end; i++) {
+            TACInstr* in = code[i];
+            int x = lcmIsCandidateOp(in->op) ? lcmFindExpr(ex, nEx, in) : -1;
+            if (x >= 0 && !lcmHas(&b->kill, x)) lcmAdd(&b->use, x);
+            const char* def = lcmDefined(in);
+            for (int y = 0; y < nEx; y++)
+                if (lcmKills(&ex[y], def)) lcmAdd(&b->kill, y);
+        }
+    }
+
+    /* ── The four dataflow problems ── */
+    int changed;
+    for (int k = 0; k < nn; k++) {
+        lcmFill(&nd[k].antOut, nd[k].nSucc > 0);
+        lcmFill(&nd[k].antIn, 1);
+        lcmFill(&nd[k].avIn, k != 0);
+        lcmFill(&nd[k].avOut, 1);
+    }
+    do {                                   /* anticipated: backward, meet = ∩ */
+        changed = 0;
+        for (int k = nn - 1; k >= 0; k--) {
+            LcmNode* b = &nd[k];
+            LcmSet out;
+            lcmFill(&out, b->nSucc > 0);
+            for (int s = 0; s < b->nSucc; s++)
+                for (int w = 0; w < LCM_WORDS; w++) out.w[w] &= nd[b->succ[s]].antIn.w[w];
+            LcmSet in;
+            for (int w = 0; w < LCM_WORDS; w++)
+                in.w[w] = b->use.w[w] | (out.w[w] & ~b->kill.w[w]);
+            if (!lcmEqual(&in, &b->antIn) || !lcmEqual(&out, &b->antOut)) changed = 1;
+            b->antIn = in;
+            b->antOut = out;
+        }
+    } while (changed);
+    do {                                   /* available: forward, meet = ∩ */
+        changed = 0;
+        for (int k = 0; k < nn; k++) {
+            LcmNode* b = &nd[k];
+            LcmSet out;
+            for (int w = 0; w < LCM_WORDS; w++)
+                out.w[w] = (b->antIn.w[w] | b->avIn.w[w]) & ~b->kill.w[w];
+            if (!lcmEqual(&out, &b->avOut)) changed = 1;
+            b->avOut = out;
+        }
+        for (int k = 1; k < nn; k++) lcmFill(&nd[k].avIn, 1);
+        for (int k = 0; k < nn; k++)
+            for (int s = 0; s < nd[k].nSucc; s++) {
+                LcmNode* t = &nd[nd[k].succ[s]];
+                if (t == &nd[0]) continue;
+                for (int w = 0; w < LCM_WORDS; w++) t->avIn.w[w] &= nd[k].avOut.w[w];
+            }
+    } while (changed);
+    for (int k = 0; k < nn; k++) {
+        for (int w = 0; w < LCM_WORDS; w++)
+            nd[k].earliest.w[w] = nd[k].antIn.w[w] & ~nd[k].avIn.w[w];
+        lcmFill(&nd[k].postIn, k != 0);
+        lcmFill(&nd[k].postOut, 1);
+    }
+    do {                                   /* postponable: forward, meet = ∩ */
+        changed = 0;
+        for (int k = 0; k < nn; k++) {
+            LcmNode* b = &nd[k];
+            LcmSet out;
+            for (int w = 0; w < LCM_WORDS; w++)
+                out.w[w] = (b->earliest.w[w] | b->postIn.w[w]) & ~b->use.w[w];
+            if (!lcmEqual(&out, &b->postOut)) changed = 1;
+            b->postOut = out;
+        }
+        for (int k = 1; k < nn; k++) lcmFill(&nd[k].postIn, 1);
+        for (int k = 0; k < nn; k++)
+            for (int s = 0; s < nd[k].nSucc; s++) {
+                LcmNode* t = &nd[nd[k].succ[s]];
+                if (t == &nd[0]) continue;
+                for (int w = 0; w < LCM_WORDS; w++) t->postIn.w[w] &= nd[k].postOut.w[w];
+            }
+    } while (changed);
+    for (int k = 0; k < nn; k++) {
+        LcmNode* b = &nd[k];
+        LcmSet allSucc;
+        lcmFill(&allSucc, 1);
+        for (int s = 0; s < b->nSucc; s++)
+            for (int w = 0; w < LCM_WORDS; w++)
+                allSucc.w[w] &= nd[b->succ[s]].earliest.w[w] | nd[b->succ[s]].postIn.w[w];
+        if (b->nSucc == 0) lcmFill(&allSucc, 0);
+        for (int w = 0; w < LCM_WORDS; w++)
+            b->latest.w[w] = (b->earliest.w[w] | b->postIn.w[w]) &
+                             (b->use.w[w] | ~allSucc.w[w]);
+    }
+    do {                                   /* used: backward, meet = ∪ */
+        changed = 0;
+        for (int k = nn - 1; k >= 0; k--) {
+            LcmNode* b = &nd[k];
+            LcmSet out, in;
+            lcmFill(&out, 0);
+            for (int s = 0; s < b->nSucc; s++)
+                for (int w = 0; w < LCM_WORDS; w++) out.w[w] |= nd[b->succ[s]].usedIn.w[w];
+            for (int w = 0; w < LCM_WORDS; w++)
+                in.w[w] = (b->use.w[w] | out.w[w]) & ~b->latest.w[w];
+            if (!lcmEqual(&in, &b->usedIn) || !lcmEqual(&out, &b->usedOut)) changed = 1;
+            b->usedIn = in;
+            b->usedOut = out;
+        }
+    } while (changed);
+
+    /* ── Rewrite ── */
+    int* inserted = calloc(nEx, sizeof(int));
+    int* removed = calloc(nEx, sizeof(int));
+    for (int x = 0; x < nEx; x++) {
+        for (int k = 0; k < nn; k++)
+            if (lcmHas(&nd[k].latest, x) && lcmHas(&nd[k].usedOut, x)) inserted[x]++;
+        for (int k = 0; k < nb; k++)
+            if (lcmHas(&nd[k].use, x) &&
+                !(lcmHas(&nd[k].latest, x) && !lcmHas(&nd[k].usedOut, x))) removed[x]++;
+        /* Moving a single computation somewhere else gains nothing */
+        if (removed[x] == 0 || (inserted[x] == 1 && removed[x] == 1)) {
+            inserted[x] = removed[x] = 0;
+            continue;
+        }
+        ex[x].temp = newTemp();
+    }
+
+    /* Replace upward-exposed computations by copies of the temp */
+    for (int k = 0; k < nb; k++) {
+        LcmNode* b = &nd[k];
+        for (int x = 0; x < nEx; x++) {
+            if (!ex[x].temp || !lcmHas(&b->use, x)) continue;
+            if (lcmHas(&b->latest, x) && !lcmHas(&b->usedOut, x)) continue;
+            for (int i = b->start; i < b->end; i++) {
+                TACInstr* in = code[i];
+                int killsNow = lcmKills(&ex[x], lcmDefined(in));
+                if (in->op == ex[x].op && optSame(in->arg1, ex[x].a) && optSame(in->arg2, ex[x].b)) {
+                    in->op = TAC_ASSIGN;
+                    optSet(&in->arg2, NULL);
+                    optSet(&in->arg1, ex[x].temp);
+                }
+                if (killsNow) break;
+            }
+        }
+    }
+
+    /* Place the computations: fall-through edges, then taken edges, then
+     * block entries (the order the edge blocks rely on) */
+    for (int pass = 0; pass < 3; pass++)
+        for (int k = 0; k < nn; k++) {
+            LcmNode* b = &nd[k];
+            if ((k < nb ? 2 : b->fallthrough ? 0 : 1) != pass) continue;
+            TACInstr* pos = NULL;
+            for (int x = 0; x < nEx; x++) {
+                if (!ex[x].temp || !lcmHas(&b->latest, x) || !lcmHas(&b->usedOut, x)) continue;
+                if (!pos) {
+                    if (pass == 0) {
+                        pos = code[nd[b->from].end - 1];
+                    } else if (pass == 1) {
+                        /* a new block just in front of the target's label */
+                        TACInstr* lbl = code[nd[b->to].start];
+                        TACInstr* br = code[nd[b->from].end - 1];
+                        char* name = newLabel();
+                        pos = optPrev(code[0], lbl);
+                        if (pos->op != TAC_GOTO && pos->op != TAC_RETURN) {
+                            TACInstr* jump = createTAC(TAC_GOTO, lbl->arg1, NULL, NULL);
+                            optInsertAfter(pos, jump);
+                            pos = jump;
+                        }
+                        TACInstr* newLbl = createTAC(TAC_LABEL, name, NULL, NULL);
+                        optInsertAfter(pos, newLbl);
+                        pos = newLbl;
+                        optSet(&br->result, name);
+                        free(name);
+                    } else {
+                        /* after the block's label and declarations */
+                        int i = b->start, lead = b->start - 1;
+                        while (i < b->end && (code[i]->op == TAC_LABEL || code[i]->op == TAC_PARAM ||
+                                              code[i]->op == TAC_DECL || code[i]->op == TAC_ARRAY_DECL))
+                            lead = i++;
+                        pos = code[lead];
+                    }
+                }
+                TACInstr* comp = createTAC(ex[x].op, ex[x].a, ex[x].b, ex[x].temp);
+                optInsertAfter(pos, comp);
+                pos = comp;
+            }
+        }
+
+    for (int x = 0; x < nEx; x++) {
+        if (!ex[x].temp) continue;
+        fprintf(stderr, "\n⚡ Optimizer [pre]: %s %s %s in %s — %d computation(s) → "
+                "%d on the paths that need it\n\n", ex[x].a, lcmOpSymbol(ex[x].op), ex[x].b,
+                code[0]->arg1, removed[x], inserted[x]);
+        free(ex[x].temp);
+    }
+    free(inserted);
+    free(removed);
+done:
+    for (int x = 0; x < nEx; x++) {
+        free(ex[x].a);
+        free(ex[x].b);
+    }
+    free(nPred);
+    free(nd);
+    free(blockOf);
+}
+
+/* The rewrite leaves "t1 = tE" copies; when t1 is a single-use
+ * temp read later in the same block, read tE there directly. */
+static void lcmForwardCopies(TACInstr** code, int n, int firstTemp) {
+    static int dead[OPT_MAX_FUNC_INSTRS];
+    for (int i = 0; i < n; i++) dead[i] = 0;
+    for (int i = 1; i < n; i++) {
+        TACInstr* cp = code[i];
+        if (cp->op != TAC_ASSIGN || !isTemporary(cp->result) || !isTemporary(cp->arg1) ||
+            atoi(cp->arg1 + 1) < firstTemp)
+            continue;
+        int useAt = -1, others = 0;
+        for (int j = 1; j < n; j++) {
+            if (j == i) continue;
+            TACInstr* in = code[j];
+            if (optSame(in->arg1, cp->result) || optSame(in->arg2, cp->result) ||
+                optSame(in->result, cp->result)) {
+                if (useAt < 0 && j > i) useAt = j; else others++;
+            }
+        }
+        if (useAt < 0 || others > 0 || optSame(code[useAt]->result, cp->result)) continue;
+        int ok = 1;
+        for (int j = i + 1; j < useAt && ok; j++) {
+            TACOp op = code[j]->op;
+            if (op == TAC_LABEL || op == TAC_GOTO || op == TAC_IF_FALSE || op == TAC_RETURN ||
+                (optDefinesResult(code[j]) && optSame(code[j]->result, cp->arg1)))
+                ok = 0;
+        }
+        if (!ok) continue;
+        TACInstr* use = code[useAt];
+        if (optSame(use->arg1, cp->result)) optSet(&use->arg1, cp->arg1);
+        if (optSame(use->arg2, cp->result)) optSet(&use->arg2, cp->arg1);
+        dead[i] = 1;
+    }
+    optSweepFunc(code, n, dead);
+}
+
+static void partialRedundancyPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        int firstTemp = tacList.tempCount;
+        int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+        if (n >= 0) lcmFunc(code, n);
+        if (tacList.tempCount > firstTemp) {
+            n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (n >= 0) lcmForwardCopies(code, n, firstTemp);
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * PARTIAL DEAD CODE ELIMINATION (SINKING)
+ *
+ * A value computed in front of an IF_FALSE that only one side
+ * reads is moved to the start of that side (when the branch is its
+ * only way in), so the other path skips the work and its store.
+ * A value neither side reads is removed.  Blocks are processed
+ * bottom-up, so chains such as "t = a * b; u = t + 7" follow each
+ * other down.
+ * ========================================================= */
+#define SINK_MAX_ROUNDS 64
+
+static int sinkIsScalar(const char* name) {
+    if (!isVarDeclared((char*)name) || isArrayVar((char*)name)) return 0;
+    VarType vt = getVarType((char*)name);
+    return vt != TYPE_STRUCT && vt != TYPE_VOID;
+}
+
+static int sinkIsPure(TACOp op) {
+    switch (op) {
+    case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+    case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Index of the first instruction of the side starting at code[s], if
+ * code[from] is its only predecessor; -1 otherwise */
+static int sinkEntry(TACInstr** code, int n, int from, int s) {
+    if (s < 0 || s >= n) return -1;
+    if (code[s]->op == TAC_LABEL) {
+        for (int j = 1; j < n; j++) {
+            if (j == from) continue;
+            if ((code[j]->op == TAC_GOTO && optSame(code[j]->arg1, code[s]->arg1)) ||
+                (code[j]->op == TAC_IF_FALSE && optSame(code[j]->result, code[s]->arg1)))
+                return -1;
+        }
+        /* reached by falling through from above, unless that is the branch */
+        TACOp pop = code[s - 1]->op;
+        if (s - 1 != from && pop != TAC_GOTO && pop != TAC_RETURN) return -1;
+    }
+    while (s < n && (code[s]->op == TAC_LABEL || code[s]->op == TAC_DECL ||
+                     code[s]->op == TAC_ARRAY_DECL))
+        s++;
+    return s;
+}
+
+static int sinkMentions(TACInstr* in, const char* name) {
+    return optSame(in->arg1, name) || optSame(in->arg2, name) || optSame(in->result, name);
+}
+
+/* Sink or delete one instruction of the function; 1 if something moved */
+static int sinkOne(TACInstr** code, int n, int* deleted) {
+    LiveInfo L;
+    liveAnalyze(&L, code, n, sinkIsScalar);
+    int done = 0;
+    for (int k = 1; k < n && !done; k++) {
+        if (code[k]->op != TAC_IF_FALSE) continue;
+        int target = -1;
+        for (int j = 1; j < n; j++)
+            if (code[j]->op == TAC_LABEL && optSame(code[j]->arg1, code[k]->result)) target = j;
+        if (target < 0 || k + 1 >= n) continue;
+
+        for (int i = k - 1; i >= 1 && !done; i--) {
+            TACInstr* in = code[i];
+            if (in->op == TAC_LABEL || in->op == TAC_GOTO || in->op == TAC_IF_FALSE ||
+                in->op == TAC_RETURN || in->op == TAC_FUNC_CALL)
+                break;                              /* block (or call window) ends */
+            if (!sinkIsPure(in->op)) continue;
+            int x = liveNameIndex(&L, in->result);
+            if (x < 0) continue;
+            /* nothing below it in the block may touch its result or inputs */
+            int blocked = 0;
+            for (int j = i + 1; j <= k && !blocked; j++) {
+                TACInstr* later = code[j];
+                if (sinkMentions(later, in->result)) blocked = 1;
+                if (optDefinesResult(later) &&
+                    (optSame(later->result, in->arg1) || optSame(later->result, in->arg2)))
+                    blocked = 1;
+                if (later->op == TAC_ARG &&
+                    (optSame(later->arg1, in->arg1) || optSame(later->arg1, in->arg2)))
+                    blocked = 1;
+            }
+            if (blocked) continue;
+
+            int words = L.words;
+            int liveFall  = liveIsSet(L.liveIn + (size_t)(k + 1) * words, x);
+            int liveTaken = liveIsSet(L.liveIn + (size_t)target * words, x);
+            if (liveFall && liveTaken) continue;
+            if (!liveFall && !liveTaken) {
+                optUnlink(code[0], in);
+                (*deleted)++;
+                done = 1;
+                break;
+            }
+            int at = sinkEntry(code, n, k, liveFall ? k + 1 : target);
+            if (at < 0 || at >= n) continue;
+            optUnlink(code[0], in);
+            optInsertAfter(code[at - 1], in);
+            done = 1;
+        }
+    }
+    liveFree(&L);
+    return done;
+}
+
+static void partialDeadCodePass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        int moved = 0, deleted = 0;
+        for (int round = 0; round < SINK_MAX_ROUNDS; round++) {
+            int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (n < 0 || !sinkOne(code, n, &deleted)) break;
+            moved++;
+        }
+        moved -= deleted;
+        g_deadCodeElimCount += deleted;
+        if (moved || deleted)
+            fprintf(stderr, "\n⚡ Optimizer [sink]: %s — %d computation(s) sunk into a branch,"
+                    " %d removed\n\n", fn->arg1, moved, deleted);
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * IF-CONVERSION
+ *
+ * Small diamonds and triangles that only compute one int value
+ * become a TAC_SELECT, which the backend lowers to movn:
+ *
+ *   IF_FALSE c Le                    <then temps> <else temps>
+ *   <then temps>; m = a              m = b
+ *   GOTO Lj               ──►        m = c ? a : m     (SELECT)
+ *   Le: <else temps>; m = b
+ *   Lj:
+ *
+ * Both arms run unconditionally afterwards, so they may only hold
+ * ifconvMaxArm side-effect-free, non-trapping int instructions
+ * writing temps private to the arm, followed by the copy into m.
+ * The backend's add and sub trap on overflow, so an arm may only add
+ * or subtract values whose bounds it knows: constants, compare
+ * results and what it computed from them.
+ * ========================================================= */
+static int ifconvMaxArm = 3;         /* profile: ifconv-max-arm */
+
+typedef struct {
+    TACInstr** code;
+    int n;
+    VarType* tempTypes;
+    int nTemps;
+} IfcFunc;
+
+static int ifcIsInt(IfcFunc* f, const char* op) {
+    if (!op || op[0] == '"') return 0;
+    VarType vt = memOperandType(op, f->tempTypes, f->nTemps);
+    return vt == TYPE_INT || vt == TYPE_CHAR;
+}
+
+/* Number of instructions other than code[skip] that mention name */
+static int ifcMentions(IfcFunc* f, const char* name, int from, int to) {
+    int count = 0;
+    for (int i = 1; i < f->n; i++) {
+        if (i >= from && i < to) continue;
+        TACInstr* in = f->code[i];
+        if (optSame(in->arg1, name) || optSame(in->arg2, name) || optSame(in->result, name))
+            count++;
+    }
+    return count;
+}
+
+/* Largest |value| op can hold at code[at] of the arm starting at from,
+ * given bound[] for the arm's earlier instructions; -1 if unknown */
+static double ifcBound(IfcFunc* f, const char* op, int from, int at, const double* bound) {
+    if (isConst(op)) {
+        double v = atof(op);
+        return v < 0 ? -v : v;
+    }
+    for (int k = at - 1; k >= from; k--)
+        if (optSame(f->code[k]->result, op)) return bound[k - from];
+    return -1;
+}
+
+/* Is code[from..to) a speculable arm ending in "dst = val"? */
+static int ifcArm(IfcFunc* f, int from, int to, const char** dst, const char** val) {
+    if (to - from < 1 || to - from > ifconvMaxArm) return 0;
+    double bound[to - from];
+    for (int i = from; i < to; i++) {
+        TACInstr* in = f->code[i];
+        switch (in->op) {
+        case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+        case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+            break;
+        default:
+            return 0;
+        }
+        if (!ifcIsInt(f, in->arg1) || (in->op != TAC_ASSIGN && !ifcIsInt(f, in->arg2)))
+            return 0;
+        double a = ifcBound(f, in->arg1, from, i, bound);
+        double b = in->op == TAC_ASSIGN ? 0 : ifcBound(f, in->arg2, from, i, bound);
+        double* r = &bound[i - from];
+        if (in->op == TAC_ASSIGN)
+            *r = a;
+        else if (in->op == TAC_ADD || in->op == TAC_SUBTRACT)
+            *r = (a < 0 || b < 0 || a + b > 2147483647.0) ? -1 : a + b;
+        else if (in->op == TAC_MULTIPLY)                 /* mult/mflo: wraps */
+            *r = (a < 0 || b < 0 || a * b > 2147483647.0) ? -1 : a * b;
+        else
+            *r = 1;
+        if ((in->op == TAC_ADD || in->op == TAC_SUBTRACT) && *r < 0) return 0;
+        if (i == to - 1) break;
+        /* temps computed on the way must not be seen outside the arm */
+        if (!isTemporary(in->result) || ifcMentions(f, in->result, from, to) > 0) return 0;
+    }
+    TACInstr* last = f->code[to - 1];
+    if (last->op != TAC_ASSIGN || isTemporary(last->result)) return 0;
+    VarType vt = getVarType(last->result);
+    if (vt != TYPE_INT && vt != TYPE_CHAR) return 0;
+    *dst = last->result;
+    *val = last->arg1;
+    return 1;
+}
+
+static int ifcLabelAt(IfcFunc* f, int i, const char* name) {
+    return i < f->n && f->code[i]->op == TAC_LABEL && optSame(f->code[i]->arg1, name);
+}
+
+/* Convert the first diamond or triangle found; returns 1 if one was */
+static int ifcConvertOne(IfcFunc* f) {
+    static int dead[OPT_MAX_FUNC_INSTRS];
+    TACInstr** code = f->code;
+    for (int i = 1; i < f->n; i++) {
+        TACInstr* br = code[i];
+        if (br->op != TAC_IF_FALSE || !ifcIsInt(f, br->arg1) || isConst(br->arg1)) continue;
+        const char* cond = br->arg1;
+        const char* le = br->result;
+
+        /* then-arm runs up to the GOTO (diamond) or to Le (triangle) */
+        int e = i + 1;
+        while (e < f->n && e - i <= ifconvMaxArm + 1 &&
+               code[e]->op != TAC_GOTO && code[e]->op != TAC_LABEL) e++;
+        if (e >= f->n) continue;
+
+        const char *m, *a, *m2 = NULL, *b = NULL;
+        if (!ifcArm(f, i + 1, e, &m, &a)) continue;
+        if (optSame(m, cond) || optSame(a, m)) continue;
+
+        int j = -1;
+        if (code[e]->op == TAC_GOTO) {
+            /* diamond: GOTO Lj; Le: <else arm>; Lj: */
+            const char* lj = code[e]->arg1;
+            if (!ifcLabelAt(f, e + 1, le)) continue;
+            j = e + 2;
+            while (j < f->n && j - e <= ifconvMaxArm + 2 && code[j]->op != TAC_LABEL) j++;
+            if (!ifcLabelAt(f, j, lj) || !ifcArm(f, e + 2, j, &m2, &b) || !optSame(m, m2))
+                continue;
+            if (ifcMentions(f, lj, e, e + 1) != 1) continue;     /* only the label */
+        } else if (!ifcLabelAt(f, e, le)) {
+            continue;
+        }
+        if (ifcMentions(f, le, i, i + 1) != 1) continue;
+
+        for (int k = 0; k < f->n; k++) dead[k] = 0;
+        dead[i] = dead[e] = 1;
+        TACInstr* sel = code[e - 1];               /* then-arm's "m = a" */
+        sel->op = TAC_SELECT;
+        optSet(&sel->arg2, a);                     /* a is sel->arg1 itself */
+        optSet(&sel->arg1, cond);
+        if (j >= 0) {
+            dead[e + 1] = dead[j] = 1;
+            /* the select goes after the else-arm's "m = b" */
+            TACInstr* after = code[j - 1];
+            dead[e - 1] = 1;
+            optSweepFunc(code, f->n, dead);
+            sel->next = NULL;
+            optInsertAfter(after, sel);
+        } else {
+            optSweepFunc(code, f->n, dead);
+        }
+        fprintf(stderr, "\n⚡ Optimizer [if-convert]: %s in %s → select on %s\n\n",
+                m, code[0]->arg1, cond);
+        return 1;
+    }
+    return 0;
+}
+
+static void ifConversionPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static VarType tempTypes[8192];
+
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        IfcFunc f = { code, 0, tempTypes, tacList.tempCount < 8192 ? tacList.tempCount : 8192 };
+        for (;;) {
+            f.n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+            if (f.n < 0) break;
+            memInferTempTypes(code, f.n, tempTypes, f.nTemps);
+            if (!ifcConvertOne(&f)) break;
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * SUPEROPTIMIZER PEEPHOLE
+ *
+ * Applies the generated rewrite table (see superopt.c) to short
+ * windows of int TAC.  With --superopt, windows the table does not
+ * cover are searched here and the winners added to it.
+ * ========================================================= */
+static VarType soTempTypes[8192];
+static int     soNumTempTypes;
+
+static int soIsIntOperand(const char* s) {
+    VarType t = memOperandType(s, soTempTypes, soNumTempTypes);
+    return t == TYPE_INT || t == TYPE_CHAR;
+}
+
+static void superoptPass(void) {
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int dead[OPT_MAX_FUNC_INSTRS];
+    soNumTempTypes = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        enterFunction(fn->arg1);
+        int n = optCollectFunc(fn, code, OPT_MAX_FUNC_INSTRS);
+        if (n < 0) {
+            exitFunction();
+            continue;
+        }
+        memInferTempTypes(code, n, soTempTypes, soNumTempTypes);
+        for (int i = 0; i < n; i++) dead[i] = 0;
+        int rewrites = superoptPeephole(code, n, soIsIntOperand, dead);
+        if (rewrites) {
+            int removed = 0;
+            for (int i = 0; i < n; i++) removed += dead[i];
+            optSweepFunc(code, n, dead);
+            g_deadCodeElimCount += removed;
+            fprintf(stderr, "\n⚡ Optimizer [superopt]: %s — %d window(s) rewritten,"
+                    " %d instruction(s) saved\n\n", fn->arg1, rewrites, removed);
+        }
+        exitFunction();
+    }
+}
+
+/* =========================================================
+ * PARTIAL EVALUATION (opt-in: --peval)
+ *
+ * Programs read no input, so main computes the same thing on every
+ * run.  The evaluator interprets main's TAC, calls included, until
+ * it finishes, reaches something it does not model (floats, chars,
+ * structs, division, overflow, out-of-bounds indexes) or spends its
+ * step or memory budget.  Main then starts with the output produced
+ * so far as constant PRINTs, followed by the state at the stop point
+ * (live scalars and written array cells of main) and a jump to the
+ * residual code:
+ *
+ *   FUNC main                      FUNC main
+ *   ... 40k steps ...      ──►     PRINT 55 / PRINT 89 / ...
+ *   Ls: <stop point>               i = 12 / a[0] = 1 / ... GOTO Lr
+ *                                  ... unreachable code removed ...
+ *                                  Lr: <stop point>
+ *
+ * A call either runs to completion or is not evaluated at all; if it
+ * stops, its output and array writes are rolled back and main stops
+ * at the call (at its first ARG).
+ * ========================================================= */
+#define PEVAL_MAX_DEPTH    64
+#define PEVAL_MAX_SLOTS    128       /* names bound in one frame */
+#define PEVAL_MAX_ARRAYS   256
+#define PEVAL_MAX_OUTPUT   1024
+#define PEVAL_MAX_UNDO     8192
+#define PEVAL_MAX_RESIDUAL 512       /* state materialized at the stop point */
+
+static int pevalSteps = 0;           /* profile: peval-steps (0 = off) */
+static int pevalCells = 4096;        /* profile: peval-cells */
+
+typedef struct {
+    TACInstr*  fn;
+    TACInstr** code;
+    int        n;
+    int*       ok;                   /* code[i] only involves modelled values */
+    int*       target;               /* jump target index, or array size for ARRAY_DECL */
+    int        nParams;
+    const char* params[4];
+} PeFunc;
+
+typedef struct {
+    const char* name;
+    int value;
+    int array;                       /* >= 0: bound to this array */
+} PeSlot;
+
+typedef struct {
+    PeFunc* f;
+    PeSlot  slots[PEVAL_MAX_SLOTS];
+    int     nSlots;
+} PeFrame;
+
+typedef struct { int base, size; } PeArray;
+typedef struct { int cell, old; unsigned char written; } PeUndo;
+typedef struct { const char* text; int value; TACOp op; } PeOutput;
+
+typedef struct {
+    PeFunc*   funcs;
+    int       nFuncs;
+    PeFrame   frames[PEVAL_MAX_DEPTH];
+    PeArray   arrays[PEVAL_MAX_ARRAYS];
+    int       nArrays;
+    int*      cells;
+    unsigned char* written;
+    int       nCells;
+    PeUndo    undo[PEVAL_MAX_UNDO];
+    int       nUndo;
+    int       logging;               /* record array writes for roll-back */
+    PeOutput  out[PEVAL_MAX_OUTPUT];
+    int       nOut;
+    long      steps;
+    int       fatal;                 /* a committed effect could not be recorded */
+} PeState;
+
+enum { PE_DONE, PE_STOP };
+
+static PeSlot* peSlot(PeFrame* fr, const char* name, int create) {
+    for (int i = 0; i < fr->nSlots; i++)
+        if (strcmp(fr->slots[i].name, name) == 0) return &fr->slots[i];
+    if (!create || fr->nSlots >= PEVAL_MAX_SLOTS) return NULL;
+    PeSlot* s = &fr->slots[fr->nSlots++];
+    s->name = name;
+    s->value = 0;
+    s->array = -1;
+    return s;
+}
+
+static int peValue(PeFrame* fr, const char* op, int* v) {
+    if (!op) return 0;
+    if (isConst(op)) {
+        char* end;
+        long x = strtol(op, &end, 10);
+        if (*end != '\0' || x != (int)x) return 0;
+        *v = (int)x;
+        return 1;
+    }
+    PeSlot* s = peSlot(fr, op, 0);
+    if (!s || s->array >= 0) return 0;
+    *v = s->value;
+    return 1;
+}
+
+static int peSet(PeFrame* fr, const char* name, int v) {
+    PeSlot* s = peSlot(fr, name, 1);
+    if (!s) return 0;
+    s->value = v;
+    s->array = -1;
+    return 1;
+}
+
+static PeState pe;
+
+/* Cell of arr[idx], or -1 when the index is out of bounds */
+static int peCell(PeFrame* fr, const char* arr, int idx) {
+    PeSlot* s = peSlot(fr, arr, 0);
+    if (!s || s->array < 0) return -1;
+    PeArray* a = &pe.arrays[s->array];
+    return (idx >= 0 && idx < a->size) ? a->base + idx : -1;
+}
+
+static int peStore(int cell, int v) {
+    if (pe.logging) {
+        if (pe.nUndo >= PEVAL_MAX_UNDO) return 0;
+        PeUndo* u = &pe.undo[pe.nUndo++];
+        u->cell = cell;
+        u->old = pe.cells[cell];
+        u->written = pe.written[cell];
+    }
+    pe.cells[cell] = v;
+    pe.written[cell] = 1;
+    return 1;
+}
+
+static int peArith(TACOp op, int a, int b, int* r) {
+    long long x = a, y = b, v;
+    switch (op) {
+    case TAC_ADD:      v = x + y; break;       /* add/sub trap on overflow */
+    case TAC_SUBTRACT: v = x - y; break;
+    case TAC_MULTIPLY: *r = (int)((unsigned)a * (unsigned)b); return 1;
+    case TAC_EQ: *r = a == b; return 1;
+    case TAC_NE: *r = a != b; return 1;
+    case TAC_LT: *r = a <  b; return 1;
+    case TAC_GT: *r = a >  b; return 1;
+    case TAC_LE: *r = a <= b; return 1;
+    case TAC_GE: *r = a >= b; return 1;
+    default: return 0;
+    }
+    if (v != (int)v) return 0;
+    *r = (int)v;
+    return 1;
+}
+
+static PeFunc* peFindFunc(const char* name) {
+    for (int i = 0; i < pe.nFuncs; i++)
+        if (strcmp(pe.funcs[i].fn->arg1, name) == 0) return &pe.funcs[i];
+    return NULL;
+}
+
+static int peIsInt(const char* op, VarType* tempTypes, int nTemps) {
+    if (!op) return 1;
+    if (op[0] == '\'' || op[0] == '"') return 0;
+    return memOperandType(op, tempTypes, nTemps) == TYPE_INT;
+}
+
+/* Does the evaluator model every value code[i] touches? */
+static int peModelled(TACInstr* in, VarType* tempTypes, int nTemps) {
+#define PE_INT(x) peIsInt((x), tempTypes, nTemps)
+    switch (in->op) {
+    case TAC_LABEL: case TAC_DECL: case TAC_PARAM: case TAC_GOTO:
+        return 1;
+    case TAC_DIV_CHECK: case TAC_IF_FALSE: case TAC_RETURN:
+        return PE_INT(in->arg1);
+    case TAC_ARRAY_DECL:
+        return getVarType(in->arg1) == TYPE_INT;
+    case TAC_BOUNDS_CHECK: case TAC_ARRAY_READ: case TAC_ARRAY_WRITE:
+        return getVarType(in->arg1) == TYPE_INT && PE_INT(in->arg2) &&
+               (in->op == TAC_BOUNDS_CHECK || PE_INT(in->result));
+    case TAC_ASSIGN: case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+    case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+    case TAC_SELECT:
+        return PE_INT(in->arg1) && PE_INT(in->arg2) && PE_INT(in->result);
+    case TAC_PRINT: case TAC_WRITE:
+        return in->arg1 && (in->arg1[0] == '"' || PE_INT(in->arg1));
+    case TAC_ARG:
+        return isArrayVar(in->arg1) ? getVarType(in->arg1) == TYPE_INT : PE_INT(in->arg1);
+    case TAC_FUNC_CALL:
+        return !in->result || getFunctionReturnType(in->arg1) == TYPE_INT;
+    default:
+        return 0;
+    }
+#undef PE_INT
+}
+
+/* Interpret frames[depth] from its first instruction.  On PE_STOP,
+ * *stopAt is the instruction that was not evaluated; on PE_DONE it is
+ * the RETURN taken (or n when control fell off the end). */
+static int peRun(int depth, int* stopAt, int* ret, int* hasRet) {
+    PeFrame* fr = &pe.frames[depth];
+    PeFunc* f = fr->f;
+    const char* args[10];
+    int nArgs = 0, argStart = -1;
+    *hasRet = 0;
+    for (int i = 1; i < f->n; ) {
+        TACInstr* in = f->code[i];
+        int a, b, r, c;
+        *stopAt = i;
+        if (++pe.steps > pevalSteps || !f->ok[i]) goto stop;
+        switch (in->op) {
+        case TAC_LABEL: case TAC_DECL: case TAC_PARAM:
+            break;
+        case TAC_ARRAY_DECL: {
+            PeSlot* s = peSlot(fr, in->arg1, 1);
+            int size = f->target[i];
+            if (!s) goto stop;
+            if (s->array >= 0) break;                 /* re-declared in a loop: same storage */
+            if (pe.nArrays >= PEVAL_MAX_ARRAYS || size <= 0 || pe.nCells + size > pevalCells)
+                goto stop;
+            pe.arrays[pe.nArrays].base = pe.nCells;
+            pe.arrays[pe.nArrays].size = size;
+            memset(&pe.written[pe.nCells], 0, size);
+            pe.nCells += size;
+            s->array = pe.nArrays++;
+            break;
+        }
+        case TAC_BOUNDS_CHECK:
+            if (!peValue(fr, in->arg2, &a) || peCell(fr, in->arg1, a) < 0) goto stop;
+            break;
+        case TAC_DIV_CHECK:
+            if (!peValue(fr, in->arg1, &a) || a == 0) goto stop;
+            break;
+        case TAC_ASSIGN:
+            if (!peValue(fr, in->arg1, &a) || !peSet(fr, in->result, a)) goto stop;
+            break;
+        case TAC_ADD: case TAC_SUBTRACT: case TAC_MULTIPLY:
+        case TAC_EQ: case TAC_NE: case TAC_LT: case TAC_GT: case TAC_LE: case TAC_GE:
+            if (!peValue(fr, in->arg1, &a) || !peValue(fr, in->arg2, &b) ||
+                !peArith(in->op, a, b, &r) || !peSet(fr, in->result, r))
+                goto stop;
+            break;
+        case TAC_SELECT:
+            if (!peValue(fr, in->arg1, &a)) goto stop;
+            if (a && (!peValue(fr, in->arg2, &b) || !peSet(fr, in->result, b))) goto stop;
+            break;
+        case TAC_ARRAY_READ:
+            if (!peValue(fr, in->arg2, &a) || (c = peCell(fr, in->arg1, a)) < 0 ||
+                !pe.written[c] || !peSet(fr, in->result, pe.cells[c]))
+                goto stop;
+            break;
+        case TAC_ARRAY_WRITE:
+            if (!peValue(fr, in->arg2, &a) || !peValue(fr, in->result, &b) ||
+                (c = peCell(fr, in->arg1, a)) < 0 || !peStore(c, b))
+                goto stop;
+            break;
+        case TAC_PRINT: case TAC_WRITE: {
+            PeOutput* o = &pe.out[pe.nOut];
+            if (pe.nOut >= PEVAL_MAX_OUTPUT) goto stop;
+            o->text = in->arg1[0] == '"' ? in->arg1 : NULL;
+            if (!o->text && !peValue(fr, in->arg1, &o->value)) goto stop;
+            o->op = in->op;
+            pe.nOut++;
+            break;
+        }
+        case TAC_ARG:
+            if (nArgs == 0) argStart = i;
+            if (nArgs < 10) args[nArgs++] = in->arg1;
+            break;
+        case TAC_FUNC_CALL: {
+            /* the backend loads $a0.. from the ARGs since the last call, last one first */
+            PeFunc* g = peFindFunc(in->arg1);
+            PeFrame* callee = &pe.frames[depth + 1];
+            if (!g || depth + 1 >= PEVAL_MAX_DEPTH || nArgs > 4 || g->nParams != nArgs) goto stop;
+            callee->f = g;
+            callee->nSlots = 0;
+            for (int k = 0; k < nArgs; k++) {
+                const char* arg = args[nArgs - 1 - k];
+                PeSlot* src = isConst(arg) ? NULL : peSlot(fr, arg, 0);
+                PeSlot* dst = peSlot(callee, g->params[k], 1);
+                if (src && src->array >= 0) dst->array = src->array;
+                else if (!peValue(fr, arg, &dst->value)) goto stop;
+            }
+            int undoMark = pe.nUndo, outMark = pe.nOut, wasLogging = pe.logging;
+            int arrayMark = pe.nArrays, cellMark = pe.nCells;
+            int subStop, value, has;
+            pe.logging = 1;
+            int status = peRun(depth + 1, &subStop, &value, &has);
+            pe.logging = wasLogging;
+            pe.nArrays = arrayMark;                     /* the callee's arrays die with it */
+            pe.nCells = cellMark;
+            if (status != PE_DONE) {
+                while (pe.nUndo > undoMark) {
+                    PeUndo* u = &pe.undo[--pe.nUndo];
+                    pe.cells[u->cell] = u->old;
+                    pe.written[u->cell] = u->written;
+                }
+                pe.nOut = outMark;
+                goto stop;
+            }
+            if (!wasLogging) pe.nUndo = undoMark;       /* committed */
+            nArgs = 0;
+            argStart = -1;
+            if (in->result) {
+                PeSlot* s = peSlot(fr, in->result, 1);
+                if (!s) {
+                    pe.fatal = 1;
+                    return PE_STOP;
+                }
+                s->array = -1;
+                s->value = value;
+                if (!has) s->name = "";                 /* no value returned: unbind */
+            }
+            break;
+        }
+        case TAC_RETURN:
+            if (in->arg1) {
+                if (!peValue(fr, in->arg1, ret)) goto stop;
+                *hasRet = 1;
+            }
+            return PE_DONE;
+        case TAC_GOTO:
+            i = f->target[i];
+            continue;
+        case TAC_IF_FALSE:
+            if (!peValue(fr, in->arg1, &a)) goto stop;
+            if (!a) {
+                i = f->target[i];
+                continue;
+            }
+            break;
+        default:
+            goto stop;
+        }
+        i++;
+    }
+    *stopAt = f->n;
+    return PE_DONE;
+stop:
+    if (argStart >= 0) *stopAt = argStart;              /* re-run the whole argument list */
+    return PE_STOP;
+}
+
+/* Values the residual code restores at the stop: scalars, and the
+ * fields and elements scalar replacement made into variables ("s.a",
+ * "a[1]"), which the evaluator folds like any other int */
+static int peIsRestored(const char* name) {
+    return name[0] != '\'' && (sinkIsScalar(name) || strchr(name, '.') || strchr(name, '['));
+}
+
+static void peAppend(TACInstr** first, TACInstr** last, TACInstr* in) {
+    if (*last) (*last)->next = in;
+    else       *first = in;
+    *last = in;
+}
+
+/* Rebuild main: outputs, state at the stop point, jump to the rest */
+static void peResidualize(PeFunc* m, int status, int stop, int ret, int hasRet) {
+    PeFrame* fr = &pe.frames[0];
+    TACInstr* first = NULL;
+    TACInstr* last = NULL;
+    char buf[32], idx[32];
+    int count = 0, finished = status == PE_DONE && stop < m->n;
+    if (pe.nOut == 0 && !finished) return;
+
+    for (int k = 0; k < pe.nOut; k++, count++) {
+        if (!pe.out[k].text) snprintf(buf, sizeof(buf), "%d", pe.out[k].value);
+        peAppend(&first, &last, createTAC(pe.out[k].op, pe.out[k].text ? (char*)pe.out[k].text : buf,
+                                          NULL, NULL));
+    }
+    char* resume = NULL;
+    if (finished) {
+        snprintf(buf, sizeof(buf), "%d", ret);
+        peAppend(&first, &last, createTAC(TAC_RETURN, hasRet ? buf : NULL, NULL, NULL));
+        count++;
+    } else {
+        if (stop < m->n) {
+            LiveInfo L;
+            liveAnalyze(&L, m->code, m->n, peIsRestored);
+            const unsigned* in = L.liveIn + (size_t)stop * L.words;
+            for (int k = 0; k < L.nNames; k++) {
+                PeSlot* s = liveIsSet(in, k) ? peSlot(fr, L.names[k], 0) : NULL;
+                if (!s || s->array >= 0) continue;
+                snprintf(buf, sizeof(buf), "%d", s->value);
+                peAppend(&first, &last, createTAC(TAC_ASSIGN, buf, NULL, L.names[k]));
+                count++;
+            }
+            liveFree(&L);
+        }
+        for (int k = 0; k < fr->nSlots; k++) {
+            PeSlot* s = &fr->slots[k];
+            if (s->array < 0) continue;
+            PeArray* a = &pe.arrays[s->array];
+            for (int e = 0; e < a->size && count <= PEVAL_MAX_RESIDUAL; e++) {
+                if (!pe.written[a->base + e]) continue;
+                snprintf(idx, sizeof(idx), "%d", e);
+                snprintf(buf, sizeof(buf), "%d", pe.cells[a->base + e]);
+                peAppend(&first, &last, createTAC(TAC_ARRAY_WRITE, (char*)s->name, idx, buf));
+                count++;
+            }
+        }
+        resume = newLabel();
+        peAppend(&first, &last, createTAC(TAC_GOTO, resume, NULL, NULL));
+        count++;
+    }
+
+    /* only worth it when the residual state is smaller than the work done */
+    if (count > PEVAL_MAX_RESIDUAL || count >= pe.steps) {
+        while (first) {
+            TACInstr* next = first->next;
+            free(first->arg1); free(first->arg2); free(first->result); free(first);
+            first = next;
+        }
+        free(resume);
+        return;
+    }
+    if (resume) {
+        TACInstr* label = createTAC(TAC_LABEL, resume, NULL, NULL);
+        optInsertAfter(stop < m->n ? optPrev(m->fn, m->code[stop]) : m->code[m->n - 1], label);
+        free(resume);
+    }
+    last->next = NULL;
+    TACInstr* after = m->fn;                         /* keep the declarations first */
+    while (after->next && (after->next->op == TAC_DECL || after->next->op == TAC_ARRAY_DECL))
+        after = after->next;
+    for (TACInstr* in = first; in; ) {
+        TACInstr* next = in->next;
+        optInsertAfter(after, in);
+        after = in;
+        in = next;
+    }
+
+    static TACInstr* code[OPT_MAX_FUNC_INSTRS];
+    static int dead[OPT_MAX_FUNC_INSTRS];
+    int n = optCollectFunc(m->fn, code, OPT_MAX_FUNC_INSTRS);
+    int removed = 0;
+    if (n >= 0) {
+        for (int i = 0; i < n; i++) dead[i] = 0;
+        removed = optCleanupFunc(code, n, dead);
+        optSweepFunc(code, n, dead);
+    }
+    g_deadCodeElimCount += removed;
+    if (finished)
+        fprintf(stderr, "\n⚡ Optimizer [peval]: main evaluated completely in %ld steps —"
+                " %d output(s) folded, %d instruction(s) removed\n\n", pe.steps, pe.nOut, removed);
+    else
+        fprintf(stderr, "\n⚡ Optimizer [peval]: main evaluated for %ld steps —"
+                " %d output(s) folded, %d state value(s) restored, %d instruction(s) removed\n\n",
+                pe.steps, pe.nOut, count - pe.nOut - 1, removed);
+}
+
+static void pevalPass(void) {
+    static VarType tempTypes[8192];
+    int nTemps = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+    if (pevalSteps <= 0) return;
+
+    int nFuncs = 0;
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next)
+        nFuncs += fn->op == TAC_FUNC_DEF;
+    memset(&pe, 0, sizeof(pe));
+    pe.funcs = calloc(nFuncs + 1, sizeof(PeFunc));
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next) {
+        if (fn->op != TAC_FUNC_DEF) continue;
+        PeFunc* f = &pe.funcs[pe.nFuncs++];
+        f->fn = fn;
+        f->n = optFuncLength(fn);
+        f->code = malloc(sizeof(TACInstr*) * f->n);
+        optCollectFunc(fn, f->code, f->n);
+        f->ok = calloc(f->n, sizeof(int));
+        f->target = calloc(f->n, sizeof(int));
+        enterFunction(fn->arg1);
+        memInferTempTypes(f->code, f->n, tempTypes, nTemps);
+        for (int i = 1; i < f->n; i++) {
+            TACInstr* in = f->code[i];
+            f->ok[i] = peModelled(in, tempTypes, nTemps);
+            if (in->op == TAC_PARAM) {
+                if (f->nParams < 4) f->params[f->nParams] = in->arg1;
+                f->nParams++;
+            } else if (in->op == TAC_ARRAY_DECL) {
+                f->target[i] = getArraySize(in->arg1);
+            } else if (in->op == TAC_GOTO || in->op == TAC_IF_FALSE) {
+                const char* label = in->op == TAC_GOTO ? in->arg1 : in->result;
+                f->ok[i] = 0;
+                for (int j = 1; j < f->n; j++)
+                    if (f->code[j]->op == TAC_LABEL && optSame(f->code[j]->arg1, label)) {
+                        f->target[i] = j;
+                        f->ok[i] = f->ok[i] || in->op == TAC_GOTO || peIsInt(in->arg1, tempTypes, nTemps);
+                    }
+            }
+        }
+        exitFunction();
+    }
+
+    PeFunc* m = peFindFunc("main");
+    if (m) {
+        pe.cells = malloc(sizeof(int) * pevalCells);
+        pe.written = malloc(pevalCells);
+        pe.frames[0].f = m;
+        int stop, ret, hasRet;
+        int status = peRun(0, &stop, &ret, &hasRet);
+        if (!pe.fatal) {
+            enterFunction("main");
+            peResidualize(m, status, stop, ret, hasRet);
+            exitFunction();
+        }
+        free(pe.cells);
+        free(pe.written);
+    }
+    for (int i = 0; i < pe.nFuncs; i++) {
+        free(pe.funcs[i].code);
+        free(pe.funcs[i].ok);
+        free(pe.funcs[i].target);
+    }
+    free(pe.funcs);
+}
+
+/* =========================================================
+ * MEMOIZATION (opt-in: --memo)
+ *
+ * A pure int function (int parameters, no output, calls only to pure
+ * functions) that calls itself more than once recomputes the same
+ * results over and over; naive fib makes an exponential number of
+ * calls.  Such a function gets a value table and a filled-flag table
+ * in .data.  On entry, when every argument is in [0, D), the tables
+ * are consulted; every return of a value in range fills them:
+ *
+ *   FUNC fib                       FUNC fib
+ *   PARAM n                        PARAM n
+ *   ...                    ──►     t1 = n >= 0 / t2 = n < D / tin = t1 * t2
+ *   RETURN t9                      IF_FALSE tin goto Lb
+ *                                  th = memoset.fib[n] / IF_FALSE th goto Lb
+ *                                  tv = memo.fib[n] / RETURN tv
+ *                                  Lb: ...
+ *                                  IF_FALSE tin goto Ls
+ *                                  memo.fib[n] = t9 / memoset.fib[n] = 1
+ *                                  Ls: RETURN t9
+ *
+ * Functions with one or two parameters are handled; memo-size bounds
+ * the entries of one table (D = memo-size, or its square root for two
+ * parameters).  The table names cannot clash with source identifiers.
+ * ========================================================= */
+#define MEMO_MAX_TABLES 64
+
+static int memoSize = 0;             /* profile: memo-size (0 = off) */
+
+typedef struct {
+    char* name;                      /* "memo.<fn>" or "memoset.<fn>" */
+    int   size;                      /* entries */
+} MemoTable;
+
+static MemoTable memoTables[MEMO_MAX_TABLES];
+static int memoNumTables = 0;
+
+/* Entries of the memo table called name, 0 if it is not one */
+static int memoTableSize(const char* name) {
+    for (int i = 0; name && i < memoNumTables; i++)
+        if (strcmp(memoTables[i].name, name) == 0) return memoTables[i].size;
+    return 0;
+}
+
+typedef struct {
+    TACInstr* fn;
+    int       pure;
+    int       selfCalls;
+    int       nParams;
+    char*     params[4];
+} MemoFunc;
+
+/* Pure as far as this function's own instructions go */
+static void memoScanFunc(MemoFunc* f) {
+    const char* name = f->fn->arg1;
+    f->pure = strcmp(name, "main") != 0 && getFunctionReturnType((char*)name) == TYPE_INT;
+    enterFunction((char*)name);
+    for (TACInstr* in = f->fn->next; in && in->op != TAC_FUNC_DEF; in = in->next) {
+        switch (in->op) {
+        case TAC_PARAM:
+            if (f->nParams < 4) f->params[f->nParams] = in->arg1;
+            f->nParams++;
+            if (getVarType(in->arg1) != TYPE_INT || isArrayVar(in->arg1)) f->pure = 0;
+            break;
+        case TAC_PRINT: case TAC_WRITE:
+            f->pure = 0;
+            break;
+        case TAC_FUNC_CALL:
+            f->selfCalls += strcmp(in->arg1, name) == 0;
+            break;
+        default:
+            break;
+        }
+    }
+    exitFunction();
+}
+
+static TACInstr* memoEmit(TACInstr* after, TACOp op, char* arg1, char* arg2, char* result) {
+    TACInstr* in = createTAC(op, arg1, arg2, result);
+    optInsertAfter(after, in);
+    return in;
+}
+
+/* Put the table lookup at the entry of f and a table fill at each RETURN */
+static void memoRewrite(MemoFunc* f, char* table, char* filled, int dim) {
+    int n = optFuncLength(f->fn);
+    TACInstr** code = malloc(sizeof(TACInstr*) * n);
+    optCollectFunc(f->fn, code, n);
+    char bound[16];
+    snprintf(bound, sizeof(bound), "%d", dim);
+
+    TACInstr* at = f->fn;
+    while (at->next && (at->next->op == TAC_PARAM || at->next->op == TAC_DECL ||
+                        at->next->op == TAC_ARRAY_DECL))
+        at = at->next;
+
+    /* tin = every argument in [0, dim) */
+    char* in = NULL;
+    for (int k = 0; k < f->nParams; k++) {
+        char* lo = newTemp();
+        char* hi = newTemp();
+        char* both = newTemp();
+        at = memoEmit(at, TAC_GE, f->params[k], "0", lo);
+        at = memoEmit(at, TAC_LT, f->params[k], bound, hi);
+        at = memoEmit(at, TAC_MULTIPLY, lo, hi, both);
+        free(lo);
+        free(hi);
+        if (in) {
+            char* all = newTemp();
+            at = memoEmit(at, TAC_MULTIPLY, in, both, all);
+            free(in);
+            free(both);
+            both = all;
+        }
+        in = both;
+    }
+
+    /* the key is copied so the body may reassign its parameters */
+    char* key = newTemp();
+    char* body = newLabel();
+    char* hit = newTemp();
+    char* value = newTemp();
+    at = memoEmit(at, TAC_IF_FALSE, in, NULL, body);
+    if (f->nParams == 1) {
+        at = memoEmit(at, TAC_ASSIGN, f->params[0], NULL, key);
+    } else {
+        char* row = newTemp();
+        at = memoEmit(at, TAC_MULTIPLY, f->params[0], bound, row);
+        at = memoEmit(at, TAC_ADD, row, f->params[1], key);
+        free(row);
+    }
+    at = memoEmit(at, TAC_ARRAY_READ, filled, key, hit);
+    at = memoEmit(at, TAC_IF_FALSE, hit, NULL, body);
+    at = memoEmit(at, TAC_ARRAY_READ, table, key, value);
+    at = memoEmit(at, TAC_RETURN, value, NULL, NULL);
+    memoEmit(at, TAC_LABEL, body, NULL, NULL);
+
+    for (int i = 1; i < n; i++) {
+        if (code[i]->op != TAC_RETURN || !code[i]->arg1) continue;
+        char* skip = newLabel();
+        TACInstr* pos = optPrev(f->fn, code[i]);
+        pos = memoEmit(pos, TAC_IF_FALSE, in, NULL, skip);
+        pos = memoEmit(pos, TAC_ARRAY_WRITE, table, key, code[i]->arg1);
+        pos = memoEmit(pos, TAC_ARRAY_WRITE, filled, key, "1");
+        memoEmit(pos, TAC_LABEL, skip, NULL, NULL);
+        free(skip);
+    }
+    free(code);
+    free(in);
+    free(key);
+    free(body);
+    free(hit);
+    free(value);
+}
+
+static void memoizationPass(void) {
+    if (memoSize <= 0) return;
+    int nFuncs = 0;
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next)
+        nFuncs += fn->op == TAC_FUNC_DEF;
+    MemoFunc* funcs = calloc(nFuncs + 1, sizeof(MemoFunc));
+    nFuncs = 0;
+    for (TACInstr* fn = optimizedList.head; fn; fn = fn->next)
+        if (fn->op == TAC_FUNC_DEF) {
+            funcs[nFuncs].fn = fn;
+            memoScanFunc(&funcs[nFuncs++]);
+        }
+
+    /* a call to an impure (or unknown) function makes the caller impure */
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = 0; i < nFuncs; i++) {
+            if (!funcs[i].pure) continue;
+            for (TACInstr* in = funcs[i].fn->next; in && in->op != TAC_FUNC_DEF; in = in->next) {
+                if (in->op != TAC_FUNC_CALL) continue;
+                int callee = -1;
+                for (int j = 0; j < nFuncs; j++)
+                    if (strcmp(funcs[j].fn->arg1, in->arg1) == 0) callee = j;
+                if (callee < 0 || !funcs[callee].pure) {
+                    funcs[i].pure = 0;
+                    changed = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < nFuncs; i++) {
+        MemoFunc* f = &funcs[i];
+        if (!f->pure || f->selfCalls < 2 || f->nParams < 1 || f->nParams > 2) continue;
+        if (memoNumTables + 2 > MEMO_MAX_TABLES) break;
+        int dim = memoSize;
+        if (f->nParams == 2)
+            for (dim = 1; (dim + 1) * (dim + 1) <= memoSize; dim++) ;
+        int size = f->nParams == 2 ? dim * dim : dim;
+        char name[128];
+        snprintf(name, sizeof(name), "memo.%s", f->fn->arg1);
+        memoTables[memoNumTables].name = strdup(name);
+        memoTables[memoNumTables++].size = size;
+        snprintf(name, sizeof(name), "memoset.%s", f->fn->arg1);
+        memoTables[memoNumTables].name = strdup(name);
+        memoTables[memoNumTables++].size = size;
+        memoRewrite(f, memoTables[memoNumTables - 2].name, memoTables[memoNumTables - 1].name, dim);
+        fprintf(stderr, "\n⚡ Optimizer [memo]: %s memoized for arguments in [0, %d)"
+                " (%d-entry table)\n\n", f->fn->arg1, dim, size);
+    }
+    free(funcs);
+}
+
+/* =========================================================
+ * OPTIMIZATION PROFILES
+ *
+ * The post-pass order and the pass thresholds can come from a
+ * profile file (the autotuner, minicompiler --tune, writes one):
+ *
+ *   # comment
+ *   passes = fusion,unswitch,escape,memfwd,reassoc,egraph,pre,sink,ifconv,promote,superopt,peval,memo
+ *   unswitch-max-loop = 96
+ *
+ * Passes left out of the list do not run.
+ * ========================================================= */
+#define OPT_MAX_PASSES 16
+
+typedef struct {
+    const char* name;
+    void (*run)(void);
+} OptPass;
+
+static const OptPass optPasses[] = {
+    { "fusion",   loopFusionPass },
+    { "unswitch", loopUnswitchPass },
+    { "escape",   escapeAnalysisPass },
+    { "memfwd",   memoryForwardingPass },
+    { "reassoc",  reassociationPass },
+    { "egraph",   egraphPass },
+    { "pre",      partialRedundancyPass },
+    { "sink",     partialDeadCodePass },
+    { "ifconv",   ifConversionPass },
+    { "promote",  scalarReplacementPass },
+    { "superopt", superoptPass },
+    { "peval",    pevalPass },
+    { "memo",     memoizationPass },
+};
+#define OPT_NUM_PASSES ((int)(sizeof(optPasses) / sizeof(optPasses[0])))
+
+typedef struct {
+    const char* key;
+    int*        value;
+    int         min, max;
+    int         target;     /* describes the target, not the pass pipeline */
+} OptParam;
+
+/* MIPS backend register allocator: 0 = stack slots only, 1 = linear
+ * scan, 2 = graph coloring (-O2) */
+static int regAlloc = 1;
+
+/* Target executes the instruction after each branch (delay slots) */
+static int delaySlots = 0;
+
+static const OptParam optParams[] = {
+    { "unswitch-max-loop", &unswitchMaxLoop, 0, 4096,      0 },
+    { "unswitch-budget",   &unswitchBudget,  0, 65536,     0 },
+    { "ifconv-max-arm",    &ifconvMaxArm,    0, 16,        0 },
+    { "egraph-rounds",     &egraphRounds,    0, 64,        0 },
+    { "peval-steps",       &pevalSteps,      0, 100000000, 0 },
+    { "peval-cells",       &pevalCells,      1, 1 << 20,   0 },
+    { "memo-size",         &memoSize,        0, 1 << 16,   0 },
+    { "regalloc",          &regAlloc,        0, 2,         1 },
+    { "delay-slots",       &delaySlots,      0, 1,         1 },
+};
+#define OPT_NUM_PARAMS ((int)(sizeof(optParams) / sizeof(optParams[0])))
+
+static int optPassOrder[OPT_MAX_PASSES];
+static int optNumPassOrder = -1;             /* -1: table order */
+
+static void optDefaultPassOrder(void) {
+    if (optNumPassOrder >= 0) return;
+    for (int i = 0; i < OPT_NUM_PASSES; i++) optPassOrder[i] = i;
+    optNumPassOrder = OPT_NUM_PASSES;
+}
+
+static char* optTrim(char* s) {
+    while (isspace((unsigned char)*s)) s++;
+    char* e = s + strlen(s);
+    while (e > s && isspace((unsigned char)e[-1])) *--e = '\0';
+    return s;
+}
+
+int optSetProfileOption(const char* key, const char* value) {
+    if (strcmp(key, "passes") == 0) {
+        int order[OPT_MAX_PASSES], n = 0;
+        char buf[512];
+        snprintf(buf, sizeof(buf), "%s", value);
+        for (char* tok = strtok(buf, ","); tok; tok = strtok(NULL, ",")) {
+            char* name = optTrim(tok);
+            if (*name == '\0') continue;
+            int k = 0;
+            while (k < OPT_NUM_PASSES && strcmp(optPasses[k].name, name) != 0) k++;
+            if (k == OPT_NUM_PASSES || n == OPT_MAX_PASSES) return -1;
+            for (int q = 0; q < n; q++)
+                if (order[q] == k) return -1;
+            order[n++] = k;
+        }
+        memcpy(optPassOrder, order, sizeof(int) * n);
+        optNumPassOrder = n;
+        return 0;
+    }
+    for (int i = 0; i < OPT_NUM_PARAMS; i++) {
+        if (strcmp(optParams[i].key, key) != 0) continue;
+        char* end;
+        long v = strtol(value, &end, 10);
+        if (end == value || *end != '\0' || v < optParams[i].min || v > optParams[i].max) return -1;
+        *optParams[i].value = (int)v;
+        return 0;
+    }
+    return -1;
+}
+
+int optGetProfileOption(const char* key, int* value) {
+    for (int i = 0; i < OPT_NUM_PARAMS; i++)
+        if (strcmp(optParams[i].key, key) == 0) {
+            *value = *optParams[i].value;
+            return 0;
+        }
+    return -1;
+}
+
+int optNumProfilePasses(void) {
+    optDefaultPassOrder();
+    return optNumPassOrder;
+}
+
+const char* optProfilePass(int i) {
+    optDefaultPassOrder();
+    return (i >= 0 && i < optNumPassOrder) ? optPasses[optPassOrder[i]].name : NULL;
+}
+
+int optLoadProfile(const char* path) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Error: Cannot open profile '%s'\n", path);
+        return -1;
+    }
+    char line[512];
+    int lineNo = 0, errors = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineNo++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        char* s = optTrim(line);
+        if (*s == '\0') continue;
+        char* eq = strchr(s, '=');
+        if (eq) *eq = '\0';
+        if (!eq || optSetProfileOption(optTrim(s), optTrim(eq + 1)) != 0) {
+            fprintf(stderr, "Error: %s:%d: invalid profile entry\n", path, lineNo);
+            errors++;
+        }
+    }
+    fclose(f);
+    return errors ? -1 : 0;
+}
+
+void optWriteProfile(FILE* out, int target) {
+    optDefaultPassOrder();
+    if (!target) {
+        fprintf(out, "passes = ");
+        for (int i = 0; i < optNumPassOrder; i++)
+            fprintf(out, "%s%s", i ? "," : "", optPasses[optPassOrder[i]].name);
+        fprintf(out, "\n");
+    }
+    for (int i = 0; i < OPT_NUM_PARAMS; i++)
+        if (optParams[i].target == target)
+            fprintf(out, "%s = %d\n", optParams[i].key, *optParams[i].value);
+}
+
 /* =========================================================
  * optimizeTAC2  —  Main optimizer pass
  *
@@ -397,6 +4574,11 @@ void optimizeTAC2() {
         if (newInstr) appendOptimizedTAC(newInstr);
         curr = nextCurr;
     } /* end while */
+
+    /* ── STEP 3: Post-passes over the optimized list, in profile order ── */
+    optDefaultPassOrder();
+    for (int i = 0; i < optNumPassOrder; i++)
+        optPasses[optPassOrder[i]].run();
 }
 
 /* ─── MIPS Code Generation Helpers ─── */
@@ -404,25 +4586,107 @@ void optimizeTAC2() {
 // Variable tracking for MIPS generation (per-function)
 typedef struct {
     char name[64];
-    int  offset;        // offset from $fp
+    int  offset;        // offset from the frame base (mgFrameReg)
     int  isLocalArray;  // 1 if declared with ARRAY_DECL (data lives on stack)
     int  isParam;       // 1 if function parameter (could be a pointer if used as array)
     int  isLocalStruct; // 1 if local struct variable
     int  isStructPtr;   // 1 if variable contains struct pointer value
+    int  isMemoTable;   // 1 if a memo table in .data (base address via la)
+    int  reg;           // allocated register (index into mgRegNames), or -1
     VarType type;       // scalar type used for codegen decisions
 } MIPSGenVar;
 
 static MIPSGenVar mgVars[100];
 static int mgVarCount;
 static int mgNextOffset;
-static int mgTempBase;   // temps start here on the stack
 static int mgFrameSize;
-static VarType mgTempTypes[1024];
+static const char* mgFrameReg = "$fp";  // frame base: $fp, or $sp when omitted
+static int mgFrameLink;      // 1 if the frame holds $ra (and $fp)
+
+// Temps are numbered program-wide; these are indexed by temp number and
+// only hold meaningful values for the temps of the current function.
+static int*     mgTempOffsets;
+static int*     mgTempRegs;
+static VarType* mgTempTypes;
+static int      mgTempCap;
+
+/* Registers the allocator hands out: MG_NUM_REGS int registers, then
+ * MG_NUM_FREGS float registers.  $t0-$t3, $t9, $f0-$f2 and $f12 stay
+ * scratch for the instruction patterns below.  $t and $f4-$f11 are
+ * clobbered by calls; $s and $f20-$f27 are preserved by saving them
+ * in the callee's frame. */
+#define MG_NUM_REGS     13
+#define MG_FIRST_SAVED  5
+#define MG_NUM_FREGS    16
+#define MG_FIRST_FSAVED 8
+static const char* mgRegNames[MG_NUM_REGS + MG_NUM_FREGS] = {
+    "$t4", "$t5", "$t6", "$t7", "$t8",
+    "$s0", "$s1", "$s2", "$s3", "$s4", "$s5", "$s6", "$s7",
+    "$f4", "$f5", "$f6", "$f7", "$f8", "$f9", "$f10", "$f11",
+    "$f20", "$f21", "$f22", "$f23", "$f24", "$f25", "$f26", "$f27"
+};
+static int mgUseRegs;        // allocate registers (optimized output only)
+static int mgLastCount = -1; // instructions in the last emitted program
+static int mgSavedUsed;      // bitmask of $s registers used by the function
+static int mgFSavedUsed;     // bitmask of $f20-$f27 used by the function
+static int mgSaveBase;       // frame offset of the callee-saved area
+
+/* Int values converted to float within the current basic block, kept
+ * in $f28-$f31 so each operand is converted once (see mgConvert) */
+#define MG_NUM_CONV 4
+static struct {
+    char key[64];
+    int  valid;
+} mgConv[MG_NUM_CONV];
+static int mgConvNext;
+static const char* mgConvRegs[MG_NUM_CONV] = { "$f28", "$f29", "$f30", "$f31" };
 
 static void mgReset(void) {
     mgVarCount = 0;
     mgNextOffset = 0;
-    for (int i = 0; i < 1024; i++) mgTempTypes[i] = TYPE_INT;
+    mgSavedUsed = 0;
+    mgFSavedUsed = 0;
+    for (int i = 0; i < mgTempCap; i++) {
+        mgTempTypes[i] = TYPE_INT;
+        mgTempOffsets[i] = -1;
+        mgTempRegs[i] = -1;
+    }
+}
+
+/* Instructions go into the MIPSList as typed MIPSInstr nodes.  Operand
+ * strings follow the layout in mips.c's opcode table (result, arg1,
+ * arg2; "off(base)" for memory operands) and are copied by createMIPS. */
+static void mgEmit(MIPSList* out, MIPSOp op, const char* result, const char* arg1, const char* arg2) {
+    appendMIPS(out, createMIPS(op, result, arg1, arg2, NULL));
+}
+
+static void mgDirective(MIPSList* out, const char* label, const char* text) {
+    appendMIPS(out, createMIPS(MIPS_DIRECTIVE, label, text, NULL, NULL));
+}
+
+/* printf into one of a ring of buffers, for immediates and memory
+ * operands that only need to live until the next mgEmit copies them */
+static const char* mgFmt(const char* fmt, ...) {
+    static char ring[16][64];
+    static int next;
+    char* buf = ring[next];
+    next = (next + 1) % 16;
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(ring[0]), fmt, ap);
+    va_end(ap);
+    return buf;
+}
+
+/* Calling convention: argument i travels in $a<i>, except that float
+ * arguments 0 and 1 use $f12 and $f14.  Arguments from the fifth on
+ * go in the caller's outgoing area at 4*(i-4)($sp), which the callee
+ * reads above its own frame.  Returns NULL for stack arguments. */
+static const char* mgArgReg(int i, int isFloat) {
+    static const char* aRegs[4] = { "$a0", "$a1", "$a2", "$a3" };
+    static const char* fRegs[2] = { "$f12", "$f14" };
+    if (isFloat && i < 2) return fRegs[i];
+    return i < 4 ? aRegs[i] : NULL;
 }
 
 static int mgAddVar(const char* name, int size, int isArr, int isPar, int isStruct, int isStructPtr, VarType type) {
@@ -434,6 +4698,8 @@ static int mgAddVar(const char* name, int size, int isArr, int isPar, int isStru
     mgVars[mgVarCount].isParam = isPar;
     mgVars[mgVarCount].isLocalStruct = isStruct;
     mgVars[mgVarCount].isStructPtr = isStructPtr;
+    mgVars[mgVarCount].isMemoTable = 0;
+    mgVars[mgVarCount].reg = -1;
     mgVars[mgVarCount].type = type;
     mgVarCount++;
     mgNextOffset += size;
@@ -446,6 +4712,24 @@ static int mgFind(const char* name) {
     return -1;
 }
 
+// .data label of a memo table: "memo.fib" -> "memo_fib"
+static void mgMemoLabel(const char* name, char* buf, int size) {
+    snprintf(buf, size, "%s", name);
+    for (char* c = buf; *c; c++)
+        if (*c == '.') *c = '_';
+}
+
+// $t3 = base address of a parameter array or a memo table
+static void mgArrayBase(MIPSList* out, int vi) {
+    if (mgVars[vi].isMemoTable) {
+        char label[80];
+        mgMemoLabel(mgVars[vi].name, label, sizeof(label));
+        mgEmit(out, MIPS_LA, "$t3", label, NULL);
+    } else {
+        mgEmit(out, MIPS_LW, "$t3", mgFmt("%d(%s)", mgVars[vi].offset, mgFrameReg), NULL);
+    }
+}
+
 // Check if string is a temp variable like "tN"
 static int mgIsTemp(const char* s) {
     if (!s || s[0] != 't' || s[1] == '\0') return 0;
@@ -453,6 +4737,10 @@ static int mgIsTemp(const char* s) {
     return 1;
 }
 static int mgTempNum(const char* s) { return atoi(s + 1); }
+static int mgTempOffset(const char* s) {
+    int t = mgTempNum(s);
+    return (t >= 0 && t < mgTempCap) ? mgTempOffsets[t] : 0;
+}
 
 // Check if string is a numeric constant
 static int mgIsConst(const char* s) {
@@ -466,11 +4754,34 @@ static int mgIsFloatConst(const char* s) {
     return strchr(s, '.') != NULL || strchr(s, 'e') != NULL || strchr(s, 'E') != NULL;
 }
 
+// Shift amount when s is an int constant 2^k (k >= 1), else -1
+static int mgPow2Const(const char* s) {
+    if (!mgIsConst(s) || mgIsFloatConst(s)) return -1;
+    int v = mgConstInt(s), k = 0;
+    if (v < 2 || (v & (v - 1))) return -1;
+    while ((1 << k) < v) k++;
+    return k;
+}
+
+// Allocated register of a temp or scalar, or NULL if it lives in its slot
+static const char* mgRegOf(const char* op) {
+    int r = -1;
+    if (!op) return NULL;
+    if (mgIsTemp(op)) {
+        int t = mgTempNum(op);
+        if (t >= 0 && t < mgTempCap) r = mgTempRegs[t];
+    } else if (!mgIsConst(op)) {
+        int idx = mgFind(op);
+        if (idx >= 0) r = mgVars[idx].reg;
+    }
+    return r >= 0 ? mgRegNames[r] : NULL;
+}
+
 static VarType mgOperandType(const char* op) {
     if (!op) return TYPE_INT;
     if (mgIsTemp(op)) {
         int t = mgTempNum(op);
-        if (t >= 0 && t < 1024) return mgTempTypes[t];
+        if (t >= 0 && t < mgTempCap) return mgTempTypes[t];
         return TYPE_INT;
     }
     if (mgIsConst(op)) {
@@ -486,7 +4797,7 @@ static int mgDefinesResult(TACOp op) {
            op == TAC_MULTIPLY || op == TAC_DIVIDE || op == TAC_EQ ||
            op == TAC_NE || op == TAC_LT || op == TAC_GT || op == TAC_LE ||
            op == TAC_GE || op == TAC_FUNC_CALL || op == TAC_ARRAY_READ ||
-           op == TAC_MEMBER_LOAD || op == TAC_ADDR_OF;
+           op == TAC_MEMBER_LOAD || op == TAC_ADDR_OF || op == TAC_SELECT;
 }
 
 static int mgWillUseTempAsFloat(TACInstr* start, const char* temp) {
@@ -509,79 +4820,848 @@ static int mgWillUseTempAsFloat(TACInstr* start, const char* temp) {
     return 0;
 }
 
+static int mgIsFloatReg(const char* r) {
+    return r && r[1] == 'f';
+}
+
+// Allocated int register of op, or NULL
+static const char* mgIntRegOf(const char* op) {
+    const char* r = mgRegOf(op);
+    return mgIsFloatReg(r) ? NULL : r;
+}
+
+static void mgConvReset(void) {
+    for (int c = 0; c < MG_NUM_CONV; c++) mgConv[c].valid = 0;
+}
+
+// name was redefined: its conversions are stale
+static void mgConvForget(const char* name) {
+    for (int c = 0; c < MG_NUM_CONV; c++)
+        if (name && mgConv[c].valid && strcmp(mgConv[c].key, name) == 0) mgConv[c].valid = 0;
+}
+
+static const char* mgSrc(MIPSList* f, const char* op, const char* scratch);
+
+/* $f register holding the int value op converted to float.  Repeated
+ * uses in one basic block reuse the first conversion. */
+static const char* mgConvert(MIPSList* f, const char* op) {
+    for (int c = 0; c < MG_NUM_CONV; c++)
+        if (mgConv[c].valid && strcmp(mgConv[c].key, op) == 0) return mgConvRegs[c];
+    int c = mgConvNext;
+    mgConvNext = (mgConvNext + 1) % MG_NUM_CONV;
+    if (mgIsConst(op)) {
+        mgEmit(f, MIPS_LI_S, mgConvRegs[c], mgFmt("%d.0", mgConstInt(op)), NULL);
+    } else {
+        mgEmit(f, MIPS_MTC1, mgConvRegs[c], mgSrc(f, op, "$t9"), NULL);
+        mgEmit(f, MIPS_CVT_S_W, mgConvRegs[c], mgConvRegs[c], NULL);
+    }
+    mgConv[c].valid = strlen(op) < sizeof(mgConv[c].key);
+    if (mgConv[c].valid) strcpy(mgConv[c].key, op);
+    return mgConvRegs[c];
+}
+
 // Emit: load a TAC operand into a MIPS register
-static void mgLoad(FILE* f, const char* op, const char* reg) {
-    if (mgIsTemp(op)) {
-        fprintf(f, "    lw %s, %d($fp)\n", reg, mgTempBase + mgTempNum(op) * 4);
+static void mgLoad(MIPSList* f, const char* op, const char* reg) {
+    const char* r = mgRegOf(op);
+    if (mgIsFloatReg(r)) {
+        mgEmit(f, MIPS_MFC1, reg, r, NULL);
+    } else if (r) {
+        if (strcmp(r, reg) != 0) mgEmit(f, MIPS_MOVE, reg, r, NULL);
+    } else if (mgIsTemp(op)) {
+        mgEmit(f, MIPS_LW, reg, mgFmt("%d(%s)", mgTempOffset(op), mgFrameReg), NULL);
     } else if (mgIsConst(op)) {
-        fprintf(f, "    li %s, %d\n", reg, mgConstInt(op));
+        mgEmit(f, MIPS_LI, reg, mgFmt("%d", mgConstInt(op)), NULL);
     } else {
         int idx = mgFind(op);
-        if (idx >= 0) fprintf(f, "    lw %s, %d($fp)\n", reg, mgVars[idx].offset);
+        if (idx >= 0) mgEmit(f, MIPS_LW, reg, mgFmt("%d(%s)", mgVars[idx].offset, mgFrameReg), NULL);
     }
 }
 
-static void mgLoadFloat(FILE* f, const char* op, const char* freg) {
-    if (mgIsTemp(op)) {
-        int t = mgTempNum(op);
-        if (t >= 0 && t < 1024 && mgTempTypes[t] == TYPE_FLOAT) {
-            fprintf(f, "    l.s %s, %d($fp)\n", freg, mgTempBase + t * 4);
-        } else {
-            fprintf(f, "    lw $t9, %d($fp)\n", mgTempBase + t * 4);
-            fprintf(f, "    mtc1 $t9, %s\n", freg);
-            fprintf(f, "    cvt.s.w %s, %s\n", freg, freg);
-        }
+/* Registers always hold exactly the bits the stack slot would, so an
+ * operand read in the other register file is moved across unchanged. */
+static void mgLoadFloat(MIPSList* f, const char* op, const char* freg) {
+    const char* r = mgRegOf(op);
+    int isFloat = mgOperandType(op) == TYPE_FLOAT;
+    if (mgIsFloatReg(r)) {
+        if (!isFloat) mgEmit(f, MIPS_CVT_S_W, freg, r, NULL);
+        else if (strcmp(r, freg) != 0) mgEmit(f, MIPS_MOV_S, freg, r, NULL);
+    } else if (!isFloat) {
+        mgEmit(f, MIPS_MOV_S, freg, mgConvert(f, op), NULL);
+    } else if (r) {
+        mgEmit(f, MIPS_MTC1, freg, r, NULL);
+    } else if (mgIsTemp(op)) {
+        mgEmit(f, MIPS_L_S, freg, mgFmt("%d(%s)", mgTempOffset(op), mgFrameReg), NULL);
     } else if (mgIsConst(op)) {
-        if (mgIsFloatConst(op)) {
-            fprintf(f, "    li.s %s, %s\n", freg, op);
-        } else {
-            fprintf(f, "    li $t9, %d\n", mgConstInt(op));
-            fprintf(f, "    mtc1 $t9, %s\n", freg);
-            fprintf(f, "    cvt.s.w %s, %s\n", freg, freg);
-        }
+        mgEmit(f, MIPS_LI_S, freg, op, NULL);
     } else {
         int idx = mgFind(op);
-        if (idx >= 0 && mgVars[idx].type == TYPE_FLOAT) {
-            fprintf(f, "    l.s %s, %d($fp)\n", freg, mgVars[idx].offset);
-        } else if (idx >= 0) {
-            fprintf(f, "    lw $t9, %d($fp)\n", mgVars[idx].offset);
-            fprintf(f, "    mtc1 $t9, %s\n", freg);
-            fprintf(f, "    cvt.s.w %s, %s\n", freg, freg);
-        }
+        if (idx >= 0) mgEmit(f, MIPS_L_S, freg, mgFmt("%d(%s)", mgVars[idx].offset, mgFrameReg), NULL);
     }
 }
 
 // Emit: store a MIPS register to a TAC destination
-static void mgStore(FILE* f, const char* dst, const char* reg) {
-    if (mgIsTemp(dst)) {
-        fprintf(f, "    sw %s, %d($fp)\n", reg, mgTempBase + mgTempNum(dst) * 4);
+static void mgStore(MIPSList* f, const char* dst, const char* reg) {
+    const char* r = mgRegOf(dst);
+    if (mgIsFloatReg(r)) {
+        mgEmit(f, MIPS_MTC1, r, reg, NULL);
+    } else if (r) {
+        if (strcmp(r, reg) != 0) mgEmit(f, MIPS_MOVE, r, reg, NULL);
+    } else if (mgIsTemp(dst)) {
+        mgEmit(f, MIPS_SW, reg, mgFmt("%d(%s)", mgTempOffset(dst), mgFrameReg), NULL);
     } else {
         int idx = mgFind(dst);
-        if (idx >= 0) fprintf(f, "    sw %s, %d($fp)\n", reg, mgVars[idx].offset);
+        if (idx >= 0) mgEmit(f, MIPS_SW, reg, mgFmt("%d(%s)", mgVars[idx].offset, mgFrameReg), NULL);
+    }
+}
+
+/* freg is scratch: an int destination truncates it in place */
+static void mgStoreFloat(MIPSList* f, const char* dst, const char* freg) {
+    const char* r = mgRegOf(dst);
+    int idx = mgIsTemp(dst) ? -1 : mgFind(dst);
+    if (mgIsTemp(dst)) mgTempTypes[mgTempNum(dst)] = TYPE_FLOAT;
+    if (idx >= 0 && mgVars[idx].type != TYPE_FLOAT) {
+        mgEmit(f, MIPS_TRUNC_W_S, freg, freg, NULL);
+        if (r) {
+            mgEmit(f, MIPS_MFC1, r, freg, NULL);
+        } else {
+            mgEmit(f, MIPS_MFC1, "$t9", freg, NULL);
+            mgEmit(f, MIPS_SW, "$t9", mgFmt("%d(%s)", mgVars[idx].offset, mgFrameReg), NULL);
+        }
+    } else if (mgIsFloatReg(r)) {
+        if (strcmp(r, freg) != 0) mgEmit(f, MIPS_MOV_S, r, freg, NULL);
+    } else if (r) {
+        mgEmit(f, MIPS_MFC1, r, freg, NULL);
+    } else if (mgIsTemp(dst)) {
+        mgEmit(f, MIPS_S_S, freg, mgFmt("%d(%s)", mgTempOffset(dst), mgFrameReg), NULL);
+    } else if (idx >= 0) {
+        mgEmit(f, MIPS_S_S, freg, mgFmt("%d(%s)", mgVars[idx].offset, mgFrameReg), NULL);
     }
 }
 
-static void mgStoreFloat(FILE* f, const char* dst, const char* freg) {
-    if (mgIsTemp(dst)) {
-        int t = mgTempNum(dst);
-        fprintf(f, "    s.s %s, %d($fp)\n", freg, mgTempBase + t * 4);
-        if (t >= 0 && t < 1024) mgTempTypes[t] = TYPE_FLOAT;
+/* Register holding op for reading: its own, or scratch after a load */
+static const char* mgSrc(MIPSList* f, const char* op, const char* scratch) {
+    const char* r = mgIntRegOf(op);
+    if (r) return r;
+    mgLoad(f, op, scratch);
+    return scratch;
+}
+
+/* Register an instruction should compute dst into; mgPut finishes it */
+static const char* mgDst(const char* dst, const char* scratch) {
+    const char* r = mgIntRegOf(dst);
+    return r ? r : scratch;
+}
+
+static void mgPut(MIPSList* f, const char* dst, const char* reg) {
+    if (!mgIntRegOf(dst)) mgStore(f, dst, reg);
+}
+
+/* The float counterparts: op read as a float (int values converted
+ * once per block), and where to compute a float result before
+ * mgStoreFloat */
+static const char* mgSrcFloat(MIPSList* f, const char* op, const char* scratch) {
+    const char* r = mgRegOf(op);
+    int isFloat = mgOperandType(op) == TYPE_FLOAT;
+    if (mgIsFloatReg(r) && isFloat) return r;
+    if (!isFloat && !mgIsFloatReg(r)) return mgConvert(f, op);
+    mgLoadFloat(f, op, scratch);
+    return scratch;
+}
+
+static const char* mgDstFloat(const char* dst, const char* scratch) {
+    const char* r = mgRegOf(dst);
+    return mgIsFloatReg(r) ? r : scratch;
+}
+
+static int mgIsScalarVar(const char* name) {
+    int idx = mgFind(name);
+    return idx >= 0 && !mgVars[idx].isLocalArray && !mgVars[idx].isLocalStruct &&
+           !mgVars[idx].isMemoTable;
+}
+
+static void mgSetSlot(const char* name, int offset) {
+    if (mgIsTemp(name)) {
+        int t = mgTempNum(name);
+        if (t >= 0 && t < mgTempCap) mgTempOffsets[t] = offset;
     } else {
-        int idx = mgFind(dst);
-        if (idx >= 0 && mgVars[idx].type == TYPE_FLOAT) {
-            fprintf(f, "    s.s %s, %d($fp)\n", freg, mgVars[idx].offset);
-        } else if (idx >= 0) {
-            fprintf(f, "    trunc.w.s %s, %s\n", freg, freg);
-            fprintf(f, "    mfc1 $t9, %s\n", freg);
-            fprintf(f, "    sw $t9, %d($fp)\n", mgVars[idx].offset);
+        int idx = mgFind(name);
+        if (idx >= 0) mgVars[idx].offset = offset;
+    }
+}
+
+/* Stack slot coloring: give every scalar of the function at fn (params,
+ * scalar locals, temps) a 4-byte slot above the arrays/structs.  Two
+ * scalars share a slot unless one is live where the other is written,
+ * so the frame only grows with the number of simultaneously live values.
+ * Returns the number of slots used. */
+static int mgAssignSlots(TACInstr* fn) {
+    int n = optFuncLength(fn);
+    TACInstr** code = malloc(sizeof(TACInstr*) * n);
+    optCollectFunc(fn, code, n);
+    LiveInfo L;
+    liveAnalyze(&L, code, n, mgIsScalarVar);
+
+    int N = L.nNames, words = L.words;
+    unsigned* adj = calloc((size_t)(N ? N : 1) * words, sizeof(unsigned));
+    for (int i = 0; i < n; i++) {
+        int d = L.def[i];
+        if (d < 0) continue;
+        /* a copy may share with its source: both hold the same value */
+        int src = (code[i]->op == TAC_ASSIGN) ? liveNameIndex(&L, code[i]->arg1) : -1;
+        unsigned* live = L.liveOut + (size_t)i * words;
+        for (int o = 0; o < N; o++) {
+            if (o == d || o == src || !liveIsSet(live, o)) continue;
+            adj[(size_t)d * words + o / 32] |= 1u << (o % 32);
+            adj[(size_t)o * words + d / 32] |= 1u << (d % 32);
+        }
+    }
+    /* the prologue stores all incoming params at once */
+    for (int a = 0; a < N; a++)
+        for (int b = 0; b < N; b++) {
+            int ia = mgFind(L.names[a]), ib = mgFind(L.names[b]);
+            if (a != b && ia >= 0 && ib >= 0 && mgVars[ia].isParam && mgVars[ib].isParam)
+                adj[(size_t)a * words + b / 32] |= 1u << (b % 32);
+        }
+
+    int nSlots = 0;
+    int* color = malloc(sizeof(int) * (N ? N : 1));
+    char* taken = malloc(N + 1);
+    for (int k = 0; k < N; k++) {
+        memset(taken, 0, N + 1);
+        for (int o = 0; o < k; o++)
+            if (liveIsSet(adj + (size_t)k * words, o)) taken[color[o]] = 1;
+        int c = 0;
+        while (taken[c]) c++;
+        color[k] = c;
+        if (c + 1 > nSlots) nSlots = c + 1;
+        mgSetSlot(L.names[k], mgNextOffset + c * 4);
+    }
+
+    /* Anything the analysis did not see still needs a home */
+    for (int i = 1; i < n; i++) {
+        const char* flds[] = { code[i]->arg1, code[i]->arg2, code[i]->result };
+        for (int f = 0; f < 3; f++) {
+            if (!flds[f] || liveNameIndex(&L, flds[f]) >= 0) continue;
+            if (mgIsTemp(flds[f]) && mgTempOffset(flds[f]) < 0)
+                mgSetSlot(flds[f], mgNextOffset + 4 * nSlots++);
+        }
+    }
+    for (int v = 0; v < mgVarCount; v++)
+        if (mgIsScalarVar(mgVars[v].name) && liveNameIndex(&L, mgVars[v].name) < 0)
+            mgVars[v].offset = mgNextOffset + 4 * nSlots++;
+
+    free(taken);
+    free(color);
+    free(adj);
+    liveFree(&L);
+    free(code);
+    return nSlots;
+}
+
+/* LINEAR SCAN REGISTER ALLOCATION
+ * Every scalar of the function gets one live interval: the span of
+ * program points, in instruction order, where liveness says it may
+ * hold a value.  Instruction i has a read point 2i and a write point
+ * 2i+1, so a value that dies at i can hand its register to the value
+ * defined there.  Intervals are visited by start; each takes a free
+ * register, and when none is left the interval ending furthest away is
+ * spilled back to its stack slot.  Spilled names keep the plain lw/sw
+ * code.  Int and float values are allocated separately, each from its
+ * own register file.  Names read straight from their slot (array and
+ * struct pointer parameters) are not allocated. */
+typedef struct {
+    int name;       /* liveness name index */
+    int start, end; /* program points */
+} MGInterval;
+
+static struct {
+    TACInstr** code;                 /* the whole function */
+    int        n;
+    LiveInfo   L;
+    int        haveLive;
+} mgRA;
+
+static int mgIntervalCmp(const void* a, const void* b) {
+    const MGInterval* x = a;
+    const MGInterval* y = b;
+    return x->start != y->start ? x->start - y->start : x->name - y->name;
+}
+
+/* Register file a name is allocated from: 0 = none, 1 = int, 2 = float */
+static int mgRegClass(const char* name, VarType* tempTypes, int nTemps) {
+    if (mgIsTemp(name)) {
+        int t = mgTempNum(name);
+        if (t >= mgTempCap) return 0;
+        return (t < nTemps && tempTypes[t] == TYPE_FLOAT) ? 2 : 1;
+    }
+    int idx = mgFind(name);
+    if (idx < 0 || mgVars[idx].isStructPtr || mgVars[idx].isMemoTable) return 0;
+    if (isArrayVar((char*)name)) return 0;
+    if (mgVars[idx].type == TYPE_FLOAT) return 2;
+    return mgVars[idx].type == TYPE_INT || mgVars[idx].type == TYPE_CHAR;
+}
+
+static void mgSetReg(const char* name, int r) {
+    if (mgIsTemp(name)) mgTempRegs[mgTempNum(name)] = r;
+    else mgVars[mgFind(name)].reg = r;
+}
+
+/* A register class: mgRegNames[base..base+count), of which the ones
+ * from firstSaved on are callee-saved */
+#define MG_MAX_CLASS 16
+typedef struct {
+    int base, count, firstSaved;
+} MGRegClass;
+
+/* First free register, preferring callee-saved ones when wantSaved
+ * and caller-saved ones otherwise; -1 if all are busy */
+static int mgPickReg(const MGRegClass* rc, const int* busy, int wantSaved) {
+    for (int pass = 0; pass < 2; pass++)
+        for (int r = 0; r < rc->count; r++)
+            if (!busy[r] && (pass || (r >= rc->firstSaved) == wantSaved)) return r;
+    return -1;
+}
+
+/* Loop depth of every instruction, counting backward CFG edges */
+static void mgLoopDepths(LiveInfo* L, int* depth) {
+    for (int i = 0; i < L->n; i++) depth[i] = 0;
+    for (int i = 0; i < L->n; i++)
+        for (int e = 0; e < 2; e++) {
+            int t = L->succ[2 * i + e];
+            if (t >= 0 && t <= i)
+                for (int j = t; j <= i; j++) depth[j]++;
+        }
+}
+
+static double mgDepthWeight(int depth) {
+    double w = 1;
+    for (int k = 0; k < depth && k < 8; k++) w *= 10;
+    return w;
+}
+
+/* Linear scan over the names with cand[k] set */
+static void mgLinearScan(LiveInfo* L, const char* cand, const char* wantSaved, const MGRegClass* rc) {
+    int N = L->nNames, words = L->words;
+    MGInterval* iv = malloc(sizeof(MGInterval) * (N ? N : 1));
+    for (int k = 0; k < N; k++) {
+        iv[k].name = k;
+        iv[k].start = -1;
+        iv[k].end = -1;
+    }
+    for (int i = 0; i < L->n; i++) {
+        unsigned* in  = L->liveIn  + (size_t)i * words;
+        unsigned* out = L->liveOut + (size_t)i * words;
+        for (int k = 0; k < N; k++) {
+            int lo = liveIsSet(in, k) ? 2 * i : 2 * i + 1;
+            if (!liveIsSet(in, k) && !liveIsSet(out, k) && L->def[i] != k) continue;
+            if (iv[k].start < 0) iv[k].start = lo;
+            iv[k].end = (liveIsSet(out, k) || L->def[i] == k) ? 2 * i + 1 : 2 * i;
+        }
+    }
+
+    int nIv = 0;
+    for (int k = 0; k < N; k++) {
+        if (iv[k].start < 0 || !cand[k]) continue;
+        int idx = mgIsTemp(L->names[k]) ? -1 : mgFind(L->names[k]);
+        /* the prologue writes every incoming parameter at once */
+        if (idx >= 0 && mgVars[idx].isParam) iv[k].start = 0;
+        iv[nIv++] = iv[k];
+    }
+    qsort(iv, nIv, sizeof(MGInterval), mgIntervalCmp);
+
+    int count = rc->count;
+    int active[MG_MAX_CLASS], busy[MG_MAX_CLASS];
+    for (int r = 0; r < count; r++) active[r] = -1;
+    for (int c = 0; c < nIv; c++) {
+        int r, victim = -1;
+        for (r = 0; r < count; r++) {
+            if (active[r] >= 0 && iv[active[r]].end < iv[c].start) active[r] = -1;
+            busy[r] = active[r] >= 0;
+        }
+        r = mgPickReg(rc, busy, wantSaved[iv[c].name]);
+        if (r < 0) {
+            for (int q = 0; q < count; q++)
+                if (victim < 0 || iv[active[q]].end > iv[active[victim]].end) victim = q;
+            if (iv[active[victim]].end <= iv[c].end) continue;   /* spill c */
+            mgSetReg(L->names[iv[active[victim]].name], -1);
+            r = victim;
+        }
+        active[r] = c;
+        mgSetReg(L->names[iv[c].name], rc->base + r);
+    }
+    free(iv);
+}
+
+/* GRAPH COLORING REGISTER ALLOCATION (-O2)
+ * Chaitin-Briggs over the same candidates as the linear scan.  A name
+ * written at i interferes with everything live after i, except that a
+ * copy does not interfere with its source; the prologue writes all
+ * parameters at once, so they interfere with each other.  Copies whose
+ * ends do not interfere are coalesced when the merged node has fewer
+ * than K neighbours of degree >= K (Briggs), so the copy disappears.
+ * Simplify removes nodes of degree < K; when none is left, the node
+ * with the lowest spill cost per neighbour is pushed optimistically.
+ * Each use and def costs 10 per enclosing loop.  Nodes that get no
+ * colour stay in their stack slots. */
+typedef struct {
+    LiveInfo*   L;
+    const char* cand;
+    int         N, words;
+    int         K;        /* registers in the class */
+    unsigned*   adj;      /* N x words bitsets, kept on alias roots */
+    int*        alias;    /* coalesced into, or -1 */
+    int*        deg;      /* neighbours that are roots */
+    double*     cost;
+} MGGraph;
+
+static int mgGraphRoot(MGGraph* g, int k) {
+    while (g->alias[k] >= 0) k = g->alias[k];
+    return k;
+}
+
+static int mgGraphAdj(MGGraph* g, int a, int b) {
+    return liveIsSet(g->adj + (size_t)a * g->words, b);
+}
+
+static void mgGraphEdge(MGGraph* g, int a, int b) {
+    if (a == b || mgGraphAdj(g, a, b)) return;
+    g->adj[(size_t)a * g->words + b / 32] |= 1u << (b % 32);
+    g->adj[(size_t)b * g->words + a / 32] |= 1u << (a % 32);
+    g->deg[a]++;
+    g->deg[b]++;
+}
+
+/* Briggs test for merging b into a */
+static int mgGraphCanCoalesce(MGGraph* g, int a, int b) {
+    int high = 0;
+    for (int n = 0; n < g->N; n++) {
+        if (n == a || n == b || !g->cand[n] || g->alias[n] >= 0) continue;
+        if ((mgGraphAdj(g, a, n) || mgGraphAdj(g, b, n)) && g->deg[n] >= g->K) high++;
+    }
+    return high < g->K;
+}
+
+static void mgGraphMerge(MGGraph* g, int a, int b) {
+    for (int n = 0; n < g->N; n++) {
+        if (!mgGraphAdj(g, b, n)) continue;
+        g->adj[(size_t)n * g->words + b / 32] &= ~(1u << (b % 32));
+        if (mgGraphAdj(g, a, n)) g->deg[n]--;
+        else mgGraphEdge(g, a, n), g->deg[n]--;
+    }
+    g->alias[b] = a;
+    g->cost[a] += g->cost[b];
+}
+
+static void mgColorGraph(LiveInfo* L, const char* cand, const char* wantSaved, const MGRegClass* rc) {
+    int K = rc->count;
+    int N = L->nNames, words = L->words;
+    MGGraph g;
+    g.L = L;
+    g.cand = cand;
+    g.N = N;
+    g.words = words;
+    g.K = K;
+    g.adj = calloc((size_t)(N ? N : 1) * words, sizeof(unsigned));
+    g.alias = malloc(sizeof(int) * (N ? N : 1));
+    g.deg = calloc(N ? N : 1, sizeof(int));
+    g.cost = calloc(N ? N : 1, sizeof(double));
+    for (int k = 0; k < N; k++) g.alias[k] = -1;
+
+    /* Build */
+    for (int i = 0; i < L->n; i++) {
+        int d = L->def[i];
+        if (d < 0 || !cand[d]) continue;
+        int src = (L->code[i]->op == TAC_ASSIGN) ? liveNameIndex(L, L->code[i]->arg1) : -1;
+        unsigned* live = L->liveOut + (size_t)i * words;
+        for (int o = 0; o < N; o++)
+            if (o != src && cand[o] && liveIsSet(live, o)) mgGraphEdge(&g, d, o);
+    }
+    for (int a = 0; a < N; a++) {
+        int ia = mgIsTemp(L->names[a]) ? -1 : mgFind(L->names[a]);
+        if (!cand[a] || ia < 0 || !mgVars[ia].isParam) continue;
+        for (int b = 0; b < a; b++) {
+            int ib = mgIsTemp(L->names[b]) ? -1 : mgFind(L->names[b]);
+            if (cand[b] && ib >= 0 && mgVars[ib].isParam) mgGraphEdge(&g, a, b);
+        }
+    }
+
+    /* Spill costs: 10^depth per reference, depth from backward edges */
+    int* depth = malloc(sizeof(int) * (L->n ? L->n : 1));
+    mgLoopDepths(L, depth);
+    for (int i = 0; i < L->n; i++) {
+        double w = mgDepthWeight(depth[i]);
+        int uses[LIVE_MAX_NAMES];
+        int nu = liveUses(L, i, uses);
+        for (int u = 0; u < nu; u++) g.cost[uses[u]] += w;
+        if (L->def[i] >= 0) g.cost[L->def[i]] += w;
+    }
+    free(depth);
+
+    /* Coalesce */
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = 0; i < L->n; i++) {
+            if (L->code[i]->op != TAC_ASSIGN || L->def[i] < 0) continue;
+            int s = liveNameIndex(L, L->code[i]->arg1);
+            if (s < 0 || !cand[s] || !cand[L->def[i]]) continue;
+            int a = mgGraphRoot(&g, L->def[i]), b = mgGraphRoot(&g, s);
+            if (a == b || mgGraphAdj(&g, a, b) || !mgGraphCanCoalesce(&g, a, b)) continue;
+            mgGraphMerge(&g, a, b);
+            changed = 1;
+        }
+    }
+
+    /* a coalesced node wants a callee-saved register if any of its names does */
+    char* groupSaved = calloc(N ? N : 1, 1);
+    for (int k = 0; k < N; k++)
+        if (cand[k] && wantSaved[k]) groupSaved[mgGraphRoot(&g, k)] = 1;
+
+    /* Simplify, pushing spill candidates optimistically */
+    int* stack = malloc(sizeof(int) * (N ? N : 1));
+    int* curDeg = malloc(sizeof(int) * (N ? N : 1));
+    char* removed = calloc(N ? N : 1, 1);
+    int nStack = 0, left = 0;
+    for (int k = 0; k < N; k++) {
+        curDeg[k] = g.deg[k];
+        if (cand[k] && g.alias[k] < 0) left++;
+        else removed[k] = 1;
+    }
+    while (left > 0) {
+        int pick = -1;
+        for (int k = 0; k < N && pick < 0; k++)
+            if (!removed[k] && curDeg[k] < K) pick = k;
+        if (pick < 0) {
+            double best = 0;
+            for (int k = 0; k < N; k++) {
+                if (removed[k]) continue;
+                double m = g.cost[k] / (curDeg[k] + 1);
+                if (pick < 0 || m < best) pick = k, best = m;
+            }
+        }
+        removed[pick] = 1;
+        left--;
+        stack[nStack++] = pick;
+        for (int n = 0; n < N; n++)
+            if (!removed[n] && mgGraphAdj(&g, pick, n)) curDeg[n]--;
+    }
+
+    /* Select */
+    int* color = malloc(sizeof(int) * (N ? N : 1));
+    for (int k = 0; k < N; k++) color[k] = -1;
+    while (nStack > 0) {
+        int k = stack[--nStack];
+        int taken[MG_MAX_CLASS] = { 0 };
+        for (int n = 0; n < N; n++)
+            if (color[n] >= 0 && mgGraphAdj(&g, k, n)) taken[color[n]] = 1;
+        color[k] = mgPickReg(rc, taken, groupSaved[k]);
+    }
+    for (int k = 0; k < N; k++) {
+        int c = color[mgGraphRoot(&g, k)];
+        if (cand[k]) mgSetReg(L->names[k], c < 0 ? -1 : rc->base + c);
+    }
+    free(groupSaved);
+
+    free(color);
+    free(removed);
+    free(curDeg);
+    free(stack);
+    free(g.cost);
+    free(g.deg);
+    free(g.alias);
+    free(g.adj);
+}
+
+static void mgAllocateRegisters(TACInstr* fn) {
+    static VarType tempTypes[8192];
+    if (mgRA.haveLive) liveFree(&mgRA.L);
+    free(mgRA.code);
+    mgRA.code = NULL;
+    mgRA.haveLive = 0;
+    if (!mgUseRegs || regAlloc == 0) return;
+
+    mgRA.n = optFuncLength(fn);
+    mgRA.code = malloc(sizeof(TACInstr*) * mgRA.n);
+    optCollectFunc(fn, mgRA.code, mgRA.n);
+    liveAnalyze(&mgRA.L, mgRA.code, mgRA.n, mgIsScalarVar);
+    mgRA.haveLive = 1;
+    LiveInfo* L = &mgRA.L;
+    int N = L->nNames;
+    int nTemps = tacList.tempCount < 8192 ? tacList.tempCount : 8192;
+
+    enterFunction(fn->arg1);
+    memInferTempTypes(mgRA.code, mgRA.n, tempTypes, nTemps);
+    char* cls = malloc(N ? N : 1);
+    char* cand = malloc(N ? N : 1);
+    for (int k = 0; k < N; k++) cls[k] = mgRegClass(L->names[k], tempTypes, nTemps);
+    exitFunction();
+
+    /* A caller-saved register costs a spill around each call the value
+     * lives across; a callee-saved one costs a save per invocation
+     * (none in main).  Prefer callee-saved registers for values that
+     * cross more than one call, weighting calls in loops by depth. */
+    double* crossed = calloc(N ? N : 1, sizeof(double));
+    int* depth = malloc(sizeof(int) * (mgRA.n ? mgRA.n : 1));
+    char* wantSaved = malloc(N ? N : 1);
+    mgLoopDepths(L, depth);
+    for (int i = 0; i < mgRA.n; i++) {
+        if (mgRA.code[i]->op != TAC_FUNC_CALL) continue;
+        unsigned* live = L->liveOut + (size_t)i * L->words;
+        for (int k = 0; k < N; k++)
+            if (L->def[i] != k && liveIsSet(live, k)) crossed[k] += mgDepthWeight(depth[i]);
+    }
+    int isMain = strcmp(fn->arg1, "main") == 0;
+    for (int k = 0; k < N; k++) wantSaved[k] = crossed[k] > (isMain ? 0 : 1);
+
+    static const MGRegClass classes[2] = {
+        { 0, MG_NUM_REGS, MG_FIRST_SAVED },
+        { MG_NUM_REGS, MG_NUM_FREGS, MG_FIRST_FSAVED },
+    };
+    for (int c = 1; c <= 2; c++) {
+        for (int k = 0; k < N; k++) cand[k] = cls[k] == c;
+        if (regAlloc == 2) mgColorGraph(L, cand, wantSaved, &classes[c - 1]);
+        else mgLinearScan(L, cand, wantSaved, &classes[c - 1]);
+    }
+
+    for (int k = 0; k < N; k++) {
+        if (!cls[k]) continue;
+        int r = mgIsTemp(L->names[k]) ? mgTempRegs[mgTempNum(L->names[k])]
+                                      : mgVars[mgFind(L->names[k])].reg;
+        if (r >= MG_FIRST_SAVED && r < MG_NUM_REGS)
+            mgSavedUsed |= 1 << (r - MG_FIRST_SAVED);
+        if (r >= MG_NUM_REGS + MG_FIRST_FSAVED)
+            mgFSavedUsed |= 1 << (r - MG_NUM_REGS - MG_FIRST_FSAVED);
+    }
+    free(wantSaved);
+    free(depth);
+    free(crossed);
+    free(cand);
+    free(cls);
+}
+
+/* Does any scalar or temp of the function live in its stack slot? */
+static int mgSlotsNeeded(void) {
+    for (int v = 0; v < mgVarCount; v++)
+        if (mgIsScalarVar(mgVars[v].name) && mgVars[v].reg < 0) return 1;
+    for (int t = 0; t < mgTempCap; t++)
+        if (mgTempOffsets[t] >= 0 && mgTempRegs[t] < 0) return 1;
+    return 0;
+}
+
+/* Caller-saved registers holding values that live across the call at
+ * instr go to their stack slots around the jal (save = 1 before it,
+ * save = 0 after it). */
+static void mgSaveAcrossCall(MIPSList* out, TACInstr* instr, int save) {
+    if (!mgRA.haveLive) return;
+    LiveInfo* L = &mgRA.L;
+    int i = 0;
+    while (i < mgRA.n && mgRA.code[i] != instr) i++;
+    if (i == mgRA.n) return;
+    unsigned* live = L->liveOut + (size_t)i * L->words;
+    for (int k = 0; k < L->nNames; k++) {
+        const char* name = L->names[k];
+        int r = mgIsTemp(name) ? mgTempRegs[mgTempNum(name)] : mgVars[mgFind(name)].reg;
+        int callerSaved = (r >= 0 && r < MG_FIRST_SAVED) ||
+                          (r >= MG_NUM_REGS && r < MG_NUM_REGS + MG_FIRST_FSAVED);
+        if (!callerSaved || L->def[i] == k || !liveIsSet(live, k)) continue;
+        int off = mgIsTemp(name) ? mgTempOffset(name) : mgVars[mgFind(name)].offset;
+        MIPSOp op = r < MG_NUM_REGS ? (save ? MIPS_SW : MIPS_LW) : (save ? MIPS_S_S : MIPS_L_S);
+        mgEmit(out, op, mgRegNames[r], mgFmt("%d(%s)", off, mgFrameReg), NULL);
+    }
+}
+
+/* Save (prologue) or restore (epilogue) the callee-saved registers the
+ * function uses, in the area at mgSaveBase */
+static void mgCalleeSaves(MIPSList* out, int save) {
+    int k = 0;
+    for (int r = 0; r < 8; r++)
+        if (mgSavedUsed & (1 << r))
+            mgEmit(out, save ? MIPS_SW : MIPS_LW, mgRegNames[MG_FIRST_SAVED + r],
+                   mgFmt("%d($sp)", mgSaveBase + 4 * k++), NULL);
+    for (int r = 0; r < 8; r++)
+        if (mgFSavedUsed & (1 << r))
+            mgEmit(out, save ? MIPS_S_S : MIPS_L_S, mgRegNames[MG_NUM_REGS + MG_FIRST_FSAVED + r],
+                   mgFmt("%d($sp)", mgSaveBase + 4 * k++), NULL);
+}
+
+/* ─── Instruction Selection ───
+ * Int add, subtract and compare, and a compare feeding the IF_FALSE
+ * right after it, are matched against a table of tree patterns.  The
+ * root is the TAC operator (plus the branch for a compare-and-branch
+ * tree), the leaf is what kind of operand arg2 is, and each rule
+ * carries its cost in real MIPS instructions.  The cheapest matching
+ * rule wins; a constant in a register leaf costs one more for its li.
+ * Operands are also tried swapped, with the operator mirrored. */
+enum {
+    MG_LEAF_REG,     // any operand, loaded into a register
+    MG_LEAF_ZERO,    // the constant 0
+    MG_LEAF_IMM,     // signed 16-bit constant c
+    MG_LEAF_IMM1,    // constant with c+1 signed 16-bit
+    MG_LEAF_NEGIMM,  // constant with -c signed 16-bit
+    MG_LEAF_UIMM     // unsigned 16-bit constant
+};
+
+/* Each rule emits up to two instructions.  Operands "%d" result,
+ * "%a" arg1, "%b" arg2, "%i" c, "%p" c+1, "%n" -c and "%L" branch
+ * target are filled in; anything else is a literal.  Branch rules
+ * branch when the compare is false and use $t0 as scratch. */
+typedef struct {
+    MIPSOp      op;
+    const char* result;
+    const char* arg1;
+    const char* arg2;
+} MGStep;
+
+typedef struct {
+    TACOp       op;
+    int         leaf;
+    int         branch;
+    int         cost;
+    MGStep      steps[2];
+} MGRule;
+
+static const MGRule mgRules[] = {
+    { TAC_ADD,        MG_LEAF_IMM,    0, 1, { { MIPS_ADDI, "%d", "%a", "%i" } } },
+    { TAC_ADD,        MG_LEAF_REG,    0, 1, { { MIPS_ADD, "%d", "%a", "%b" } } },
+    { TAC_SUBTRACT,   MG_LEAF_NEGIMM, 0, 1, { { MIPS_ADDI, "%d", "%a", "%n" } } },
+    { TAC_SUBTRACT,   MG_LEAF_REG,    0, 1, { { MIPS_SUB, "%d", "%a", "%b" } } },
+    { TAC_LT,         MG_LEAF_IMM,    0, 1, { { MIPS_SLTI, "%d", "%a", "%i" } } },
+    { TAC_LT,         MG_LEAF_REG,    0, 1, { { MIPS_SLT, "%d", "%a", "%b" } } },
+    { TAC_GT,         MG_LEAF_REG,    0, 1, { { MIPS_SGT, "%d", "%a", "%b" } } },
+    { TAC_GT,         MG_LEAF_IMM1,   0, 2, { { MIPS_SLTI, "%d", "%a", "%p" }, { MIPS_XORI, "%d", "%d", "1" } } },
+    { TAC_LE,         MG_LEAF_IMM1,   0, 1, { { MIPS_SLTI, "%d", "%a", "%p" } } },
+    { TAC_LE,         MG_LEAF_REG,    0, 2, { { MIPS_SLE, "%d", "%a", "%b" } } },
+    { TAC_GE,         MG_LEAF_IMM,    0, 2, { { MIPS_SLTI, "%d", "%a", "%i" }, { MIPS_XORI, "%d", "%d", "1" } } },
+    { TAC_GE,         MG_LEAF_REG,    0, 2, { { MIPS_SGE, "%d", "%a", "%b" } } },
+    { TAC_EQ,         MG_LEAF_ZERO,   0, 1, { { MIPS_SLTIU, "%d", "%a", "1" } } },
+    { TAC_EQ,         MG_LEAF_UIMM,   0, 2, { { MIPS_XORI, "%d", "%a", "%i" }, { MIPS_SLTIU, "%d", "%d", "1" } } },
+    { TAC_EQ,         MG_LEAF_REG,    0, 2, { { MIPS_SEQ, "%d", "%a", "%b" } } },
+    { TAC_NE,         MG_LEAF_ZERO,   0, 1, { { MIPS_SLTU, "%d", "$zero", "%a" } } },
+    { TAC_NE,         MG_LEAF_UIMM,   0, 2, { { MIPS_XORI, "%d", "%a", "%i" }, { MIPS_SLTU, "%d", "$zero", "%d" } } },
+    { TAC_NE,         MG_LEAF_REG,    0, 2, { { MIPS_SNE, "%d", "%a", "%b" } } },
+
+    { TAC_LT,         MG_LEAF_ZERO,   1, 1, { { MIPS_BGEZ, "%a", "%L", NULL } } },
+    { TAC_LT,         MG_LEAF_IMM,    1, 2, { { MIPS_SLTI, "$t0", "%a", "%i" }, { MIPS_BEQZ, "$t0", "%L", NULL } } },
+    { TAC_LT,         MG_LEAF_REG,    1, 2, { { MIPS_SLT, "$t0", "%a", "%b" }, { MIPS_BEQZ, "$t0", "%L", NULL } } },
+    { TAC_GT,         MG_LEAF_ZERO,   1, 1, { { MIPS_BLEZ, "%a", "%L", NULL } } },
+    { TAC_GT,         MG_LEAF_IMM1,   1, 2, { { MIPS_SLTI, "$t0", "%a", "%p" }, { MIPS_BNEZ, "$t0", "%L", NULL } } },
+    { TAC_GT,         MG_LEAF_REG,    1, 2, { { MIPS_SLT, "$t0", "%b", "%a" }, { MIPS_BEQZ, "$t0", "%L", NULL } } },
+    { TAC_LE,         MG_LEAF_ZERO,   1, 1, { { MIPS_BGTZ, "%a", "%L", NULL } } },
+    { TAC_LE,         MG_LEAF_IMM1,   1, 2, { { MIPS_SLTI, "$t0", "%a", "%p" }, { MIPS_BEQZ, "$t0", "%L", NULL } } },
+    { TAC_LE,         MG_LEAF_REG,    1, 2, { { MIPS_SLT, "$t0", "%b", "%a" }, { MIPS_BNEZ, "$t0", "%L", NULL } } },
+    { TAC_GE,         MG_LEAF_ZERO,   1, 1, { { MIPS_BLTZ, "%a", "%L", NULL } } },
+    { TAC_GE,         MG_LEAF_IMM,    1, 2, { { MIPS_SLTI, "$t0", "%a", "%i" }, { MIPS_BNEZ, "$t0", "%L", NULL } } },
+    { TAC_GE,         MG_LEAF_REG,    1, 2, { { MIPS_SLT, "$t0", "%a", "%b" }, { MIPS_BNEZ, "$t0", "%L", NULL } } },
+    { TAC_EQ,         MG_LEAF_ZERO,   1, 1, { { MIPS_BNEZ, "%a", "%L", NULL } } },
+    { TAC_EQ,         MG_LEAF_REG,    1, 1, { { MIPS_BNE, "%a", "%b", "%L" } } },
+    { TAC_NE,         MG_LEAF_ZERO,   1, 1, { { MIPS_BEQZ, "%a", "%L", NULL } } },
+    { TAC_NE,         MG_LEAF_REG,    1, 1, { { MIPS_BEQ, "%a", "%b", "%L" } } },
+};
+#define MG_NUM_RULES ((int)(sizeof(mgRules) / sizeof(mgRules[0])))
+
+static int mgFitsImm(long v) { return v >= -32768 && v <= 32767; }
+
+static int mgLeafMatches(int leaf, const char* op) {
+    if (leaf == MG_LEAF_REG) return 1;
+    /* the unoptimized baseline keeps every constant in a register */
+    if (!mgUseRegs || !mgIsConst(op) || mgIsFloatConst(op)) return 0;
+    long v = mgConstInt(op);
+    switch (leaf) {
+    case MG_LEAF_ZERO:   return v == 0;
+    case MG_LEAF_IMM:    return mgFitsImm(v);
+    case MG_LEAF_IMM1:   return mgFitsImm(v + 1);
+    case MG_LEAF_NEGIMM: return mgFitsImm(-v);
+    case MG_LEAF_UIMM:   return v >= 0 && v <= 65535;
+    }
+    return 0;
+}
+
+// Operator with its operands swapped (a OP b == b OP' a), or -1
+static int mgMirror(TACOp op) {
+    switch (op) {
+    case TAC_LT: return TAC_GT;
+    case TAC_GT: return TAC_LT;
+    case TAC_LE: return TAC_GE;
+    case TAC_GE: return TAC_LE;
+    case TAC_ADD: case TAC_EQ: case TAC_NE: return op;
+    default: return -1;
+    }
+}
+
+static const char* mgRuleOperand(const char* t, const char* d, const char* a,
+                                 const char* b, long c, const char* label) {
+    if (!t || t[0] != '%') return t;
+    switch (t[1]) {
+    case 'd': return d;
+    case 'a': return a;
+    case 'b': return b;
+    case 'i': return mgFmt("%ld", c);
+    case 'p': return mgFmt("%ld", c + 1);
+    case 'n': return mgFmt("%ld", -c);
+    default:  return label;
+    }
+}
+
+static void mgExpand(MIPSList* out, const MGRule* r, const char* d, const char* a,
+                     const char* b, long c, const char* label) {
+    for (int k = 0; k < 2 && r->steps[k].arg1; k++) {
+        const MGStep* st = &r->steps[k];
+        mgEmit(out, st->op, mgRuleOperand(st->result, d, a, b, c, label),
+               mgRuleOperand(st->arg1, d, a, b, c, label),
+               mgRuleOperand(st->arg2, d, a, b, c, label));
+    }
+}
+
+/* The IF_FALSE right after compare in, when in's result is read
+ * nowhere else, else NULL */
+static TACInstr* mgFusedBranch(TACInstr* in) {
+    TACInstr* br = in->next;
+    if (!br || br->op != TAC_IF_FALSE || !optSame(br->arg1, in->result)) return NULL;
+    if (!mgRA.haveLive) return NULL;
+    LiveInfo* L = &mgRA.L;
+    int i = 0;
+    while (i < mgRA.n && mgRA.code[i] != br) i++;
+    int k = liveNameIndex(L, in->result);
+    if (i == mgRA.n || k < 0) return NULL;
+    return liveIsSet(L->liveOut + (size_t)i * L->words, k) ? NULL : br;
+}
+
+/* Emit int add, subtract or compare in, taking the IF_FALSE after a
+ * compare along when it can; returns the last instruction covered */
+static TACInstr* mgSelect(MIPSList* out, TACInstr* in) {
+    int isCompare = in->op != TAC_ADD && in->op != TAC_SUBTRACT;
+    TACInstr* br = isCompare ? mgFusedBranch(in) : NULL;
+    const MGRule* best = NULL;
+    int bestCost = 0, bestSwap = 0;
+    for (int swap = 0; swap < 2; swap++) {
+        int op = swap ? mgMirror(in->op) : (int)in->op;
+        const char* x = swap ? in->arg2 : in->arg1;
+        const char* y = swap ? in->arg1 : in->arg2;
+        for (int k = 0; k < MG_NUM_RULES; k++) {
+            const MGRule* r = &mgRules[k];
+            if ((int)r->op != op || r->branch != (br != NULL) || !mgLeafMatches(r->leaf, y)) continue;
+            int cost = r->cost + mgIsConst(x) + (r->leaf == MG_LEAF_REG && mgIsConst(y));
+            if (!best || cost < bestCost) { best = r; bestCost = cost; bestSwap = swap; }
         }
     }
+    const char* x = bestSwap ? in->arg2 : in->arg1;
+    const char* y = bestSwap ? in->arg1 : in->arg2;
+    const char* a = mgSrc(out, x, "$t0");
+    const char* b = best->leaf == MG_LEAF_REG ? mgSrc(out, y, "$t1") : NULL;
+    long c = best->leaf == MG_LEAF_REG ? 0 : mgConstInt(y);
+    if (br) {
+        mgExpand(out, best, NULL, a, b, c, br->result);
+        return br;
+    }
+    const char* d = mgDst(in->result, "$t2");
+    mgExpand(out, best, d, a, b, c, NULL);
+    mgPut(out, in->result, d);
+    return in;
 }
 
 /* ─── Main MIPS Code Generator ─── */
-void generateMIPSFromOptimizedTAC2(const char* filename) {
-    FILE* out = fopen(filename, "w");
-    if (!out) { fprintf(stderr, "Error: Cannot open output file %s\n", filename); return; }
+static void mgGenerate(const char* filename) {
+    MIPSList list = {0};
+    MIPSList* out = &list;
 
     // First pass: collect string literals
     TACInstr* scan = optimizedList.head;
@@ -612,9 +5692,9 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
     }
 
     // Output data section with strings
-    fprintf(out, ".data\n");
+    mgDirective(out, NULL, ".data");
     for (int i = 0; i < stringCount; i++) {
-        fprintf(out, "str_%d: .asciiz ", strings[i].id);
+
         // Normalize string literals to avoid double newlines when we also print '\n' via syscall 11.
         char buf[1024];
         snprintf(buf, sizeof(buf), "%s", strings[i].value ? strings[i].value : "\"\"");
@@ -623,17 +5703,30 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             buf[len - 3] = '"';
             buf[len - 2] = '\0';
         }
-        fprintf(out, "%s\n", buf);
+        char line[1100];
+        snprintf(line, sizeof(line), ".asciiz %s", buf);
+        mgDirective(out, mgFmt("str_%d", strings[i].id), line);
+    }
+    if (memoNumTables > 0) mgDirective(out, NULL, ".align 2");
+    for (int i = 0; i < memoNumTables; i++) {
+        char label[80];
+        mgMemoLabel(memoTables[i].name, label, sizeof(label));
+        mgDirective(out, label, mgFmt(".space %d", memoTables[i].size * 4));
     }
-    fprintf(out, "\n.text\n");
-    fprintf(out, ".globl main\n\n");
+    mgDirective(out, NULL, ".text");
+    mgDirective(out, NULL, ".globl main");
+
+    mgTempCap = tacList.tempCount + 1;
+    mgTempOffsets = malloc(sizeof(int) * mgTempCap);
+    mgTempRegs = malloc(sizeof(int) * mgTempCap);
+    mgTempTypes = malloc(sizeof(VarType) * mgTempCap);
 
     TACInstr* curr = optimizedList.head;
     int inMain = 0;
 
-    // Argument collector for function calls
-    char* callArgs[10];
-    int callArgCount = 0;
+    // Pending ARG operands; a call takes the top getFunctionParamCount
+    char** callArgs = NULL;
+    int callArgCount = 0, callArgCap = 0;
 
     // Process all functions
     while (curr) {
@@ -641,8 +5734,8 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
         if (curr->op == TAC_FUNC_DEF) {
             // If we just finished main without RETURN, emit exit
             if (inMain) {
-                fprintf(out, "    li $v0, 10\n");
-                fprintf(out, "    syscall\n");
+                mgEmit(out, MIPS_LI, "$v0", "10", NULL);
+                mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
             }
 
             char* fn = curr->arg1;
@@ -650,23 +5743,22 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             mgReset();
             callArgCount = 0;
 
-            /* Pre-scan: find max temp, count params, collect array decl info */
+            /* Pre-scan: count params, collect array decl info */
             TACInstr* scan = curr->next;
-            int maxTemp = -1, pCount = 0;
+            int pCount = 0;
             char* arrNames[20]; int arrCount = 0;
 
+            int outArgs = 0;
             while (scan && scan->op != TAC_FUNC_DEF) {
                 if (scan->op == TAC_PARAM) pCount++;
                 if (scan->op == TAC_ARRAY_DECL && scan->arg1)
                     arrNames[arrCount++] = scan->arg1;
-                const char* flds[] = { scan->arg1, scan->arg2, scan->result };
-                for (int f = 0; f < 3; f++)
-                    if (flds[f] && mgIsTemp(flds[f])) {
-                        int t = mgTempNum(flds[f]);
-                        if (t > maxTemp) maxTemp = t;
-                    }
+                if (scan->op == TAC_FUNC_CALL && getFunctionParamCount(scan->arg1) > outArgs)
+                    outArgs = getFunctionParamCount(scan->arg1);
                 scan = scan->next;
             }
+            // Outgoing stack arguments sit at the bottom of the frame
+            if (outArgs > 4) mgNextOffset = 4 * (outArgs - 4);
 
             // Look up array sizes from the symbol table
             int arrSizes[20];
@@ -677,13 +5769,15 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             }
             exitFunction();
 
-            // Build variable map: PARAMs first, then ARRAY_DECLs, then DECLs
+            // Build variable map: PARAMs first, then ARRAY_DECLs, then DECLs.
+            // Arrays and structs are laid out here; scalars get their slots
+            // from mgAssignSlots below.
             enterFunction(fn);
             scan = curr->next;
             while (scan && scan->op != TAC_FUNC_DEF) {
                 if (scan->op == TAC_PARAM) {
                     VarType pt = getVarType(scan->arg1);
-                    mgAddVar(scan->arg1, 4, 0, 1, 0, pt == TYPE_STRUCT_PTR, pt);
+                    mgAddVar(scan->arg1, 0, 0, 1, 0, pt == TYPE_STRUCT_PTR, pt);
                 }
                 scan = scan->next;
             }
@@ -707,18 +5801,51 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
                     if (vt == TYPE_STRUCT && st) {
                         mgAddVar(scan->result, st->totalSize, 0, 0, 1, 0, vt);
                     } else if (vt == TYPE_STRUCT_PTR) {
-                        mgAddVar(scan->result, 4, 0, 0, 0, 1, vt);
+                        mgAddVar(scan->result, 0, 0, 0, 0, 1, vt);
                     } else {
-                        mgAddVar(scan->result, 4, 0, 0, 0, 0, vt);
+                        mgAddVar(scan->result, 0, 0, 0, 0, 0, vt);
                     }
                 }
                 scan = scan->next;
             }
+            scan = curr->next;
+            while (scan && scan->op != TAC_FUNC_DEF) {
+                if ((scan->op == TAC_ARRAY_READ || scan->op == TAC_ARRAY_WRITE) &&
+                    memoTableSize(scan->arg1) > 0 && mgFind(scan->arg1) < 0) {
+                    mgAddVar(scan->arg1, 0, 0, 0, 0, 0, TYPE_INT);
+                    mgVars[mgVarCount - 1].isMemoTable = 1;
+                }
+                scan = scan->next;
+            }
             exitFunction();
 
-            mgTempBase = mgNextOffset;
-            int nTemps = (maxTemp >= 0) ? (maxTemp + 1) : 0;
-            mgFrameSize = mgNextOffset + nTemps * 4 + 8;
+            int nSlots = mgAssignSlots(curr);
+            mgAllocateRegisters(curr);
+            /* main never returns, so its caller's registers need no saving */
+            if (inMain) mgSavedUsed = mgFSavedUsed = 0;
+
+            /* $sp never moves inside a function body, so optimized code
+             * addresses the frame off $sp and keeps no frame pointer.
+             * $ra is saved only by functions that make calls (main never
+             * returns).  A leaf whose scalars all live in registers never
+             * touches their slots, and a function with nothing in memory
+             * gets no frame at all. */
+            int hasCall = 0;
+            for (scan = curr->next; scan && scan->op != TAC_FUNC_DEF; scan = scan->next)
+                if (scan->op == TAC_FUNC_CALL) hasCall = 1;
+            if (mgUseRegs && !hasCall && !mgSlotsNeeded()) nSlots = 0;
+            mgSaveBase = mgNextOffset + nSlots * 4;
+            int nSaved = 0;
+            for (int r = 0; r < 8; r++) nSaved += ((mgSavedUsed >> r) & 1) + ((mgFSavedUsed >> r) & 1);
+            if (mgUseRegs) {
+                mgFrameReg = "$sp";
+                mgFrameLink = hasCall && !inMain;
+                mgFrameSize = mgSaveBase + nSaved * 4 + (mgFrameLink ? 4 : 0);
+            } else {
+                mgFrameReg = "$fp";
+                mgFrameLink = 1;
+                mgFrameSize = mgSaveBase + nSaved * 4 + 8;
+            }
             if (mgFrameSize % 8) mgFrameSize += 8 - (mgFrameSize % 8);
 
             // Emit prologue — prefix non-main functions with fn_ to avoid
@@ -728,15 +5855,32 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
                 snprintf(fnLab, sizeof(fnLab), "main");
             else
                 snprintf(fnLab, sizeof(fnLab), "fn_%s", fn);
-            fprintf(out, "%s:\n", fnLab);
-            fprintf(out, "    subu $sp, $sp, %d\n", mgFrameSize);
-            fprintf(out, "    sw $ra, %d($sp)\n", mgFrameSize - 4);
-            fprintf(out, "    sw $fp, %d($sp)\n", mgFrameSize - 8);
-            fprintf(out, "    move $fp, $sp\n");
+            appendMIPS(out, createMIPS(MIPS_LABEL, NULL, fnLab, NULL, NULL));
+            if (mgFrameSize > 0)
+                mgEmit(out, MIPS_SUBU, "$sp", "$sp", mgFmt("%d", mgFrameSize));
+            if (mgFrameLink)
+                mgEmit(out, MIPS_SW, "$ra", mgFmt("%d($sp)", mgFrameSize - 4), NULL);
+            if (!mgUseRegs) {
+                mgEmit(out, MIPS_SW, "$fp", mgFmt("%d($sp)", mgFrameSize - 8), NULL);
+                mgEmit(out, MIPS_MOVE, "$fp", "$sp", NULL);
+            }
+            mgCalleeSaves(out, 1);
+            mgConvReset();
 
-            // Store incoming params ($a0..$a3) onto the stack
-            for (int i = 0; i < pCount && i < 4; i++)
-                fprintf(out, "    sw $a%d, %d($fp)\n", i, mgVars[i].offset);
+            // Incoming params go to their register or stack slot
+            for (int i = 0; i < pCount; i++) {
+                int isFloat = getFunctionParamType(fn, i) == TYPE_FLOAT;
+                const char* areg = mgArgReg(i, isFloat);
+                if (!areg) {
+                    const char* d = mgDst(mgVars[i].name, "$t0");
+                    mgEmit(out, MIPS_LW, d, mgFmt("%d($sp)", mgFrameSize + 4 * (i - 4)), NULL);
+                    mgPut(out, mgVars[i].name, d);
+                } else if (areg[1] == 'f') {
+                    mgStoreFloat(out, mgVars[i].name, areg);
+                } else {
+                    mgStore(out, mgVars[i].name, areg);
+                }
+            }
 
             curr = curr->next;
             continue;
@@ -749,61 +5893,84 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             break; // handled during pre-scan or skipped
 
         case TAC_ASSIGN:
+            if (curr->next && curr->next->op == TAC_SELECT &&
+                optSame(curr->next->result, curr->result) &&
+                mgOperandType(curr->result) != TYPE_FLOAT) {
+                /* m = b; m = c ? a : m  →  a single movn on b */
+                const char* d = mgDst(curr->result, "$t2");
+                const char* c = mgSrc(out, curr->next->arg1, "$t0");
+                const char* a = mgSrc(out, curr->next->arg2, "$t1");
+                mgLoad(out, curr->arg1, d);
+                mgEmit(out, MIPS_MOVN, d, a, c);
+                mgPut(out, curr->result, d);
+                curr = curr->next;
+                break;
+            }
             if (mgOperandType(curr->result) == TYPE_FLOAT || mgOperandType(curr->arg1) == TYPE_FLOAT) {
-                mgLoadFloat(out, curr->arg1, "$f0");
-                if (mgOperandType(curr->result) == TYPE_FLOAT) {
-                    mgStoreFloat(out, curr->result, "$f0");
+                /* temps are untyped: a temp copy of a float stays a float */
+                if (mgOperandType(curr->result) == TYPE_FLOAT || mgIsTemp(curr->result)) {
+                    const char* d = mgDstFloat(curr->result, "$f0");
+                    mgLoadFloat(out, curr->arg1, d);
+                    mgStoreFloat(out, curr->result, d);
                 } else {
-                    fprintf(out, "    trunc.w.s $f0, $f0\n");
-                    fprintf(out, "    mfc1 $t0, $f0\n");
-                    mgStore(out, curr->result, "$t0");
+                    const char* d = mgDst(curr->result, "$t0");
+                    mgEmit(out, MIPS_TRUNC_W_S, "$f0", mgSrcFloat(out, curr->arg1, "$f0"), NULL);
+                    mgEmit(out, MIPS_MFC1, d, "$f0", NULL);
+                    mgPut(out, curr->result, d);
                 }
+            } else if (mgRegOf(curr->result)) {
+                mgLoad(out, curr->arg1, mgRegOf(curr->result));
             } else {
-                mgLoad(out, curr->arg1, "$t0");
-                mgStore(out, curr->result, "$t0");
+                mgStore(out, curr->result, mgSrc(out, curr->arg1, "$t0"));
             }
             break;
 
         case TAC_ADD:
             if (mgOperandType(curr->arg1) == TYPE_FLOAT || mgOperandType(curr->arg2) == TYPE_FLOAT) {
-                mgLoadFloat(out, curr->arg1, "$f0");
-                mgLoadFloat(out, curr->arg2, "$f1");
-                fprintf(out, "    add.s $f2, $f0, $f1\n");
-                mgStoreFloat(out, curr->result, "$f2");
+                const char* a = mgSrcFloat(out, curr->arg1, "$f0");
+                const char* b = mgSrcFloat(out, curr->arg2, "$f1");
+                const char* d = mgDstFloat(curr->result, "$f2");
+                mgEmit(out, MIPS_ADD_S, d, a, b);
+                mgStoreFloat(out, curr->result, d);
             } else {
-                mgLoad(out, curr->arg1, "$t0");
-                mgLoad(out, curr->arg2, "$t1");
-                fprintf(out, "    add $t2, $t0, $t1\n");
-                mgStore(out, curr->result, "$t2");
+                mgSelect(out, curr);
             }
             break;
 
         case TAC_SUBTRACT:
             if (mgOperandType(curr->arg1) == TYPE_FLOAT || mgOperandType(curr->arg2) == TYPE_FLOAT) {
-                mgLoadFloat(out, curr->arg1, "$f0");
-                mgLoadFloat(out, curr->arg2, "$f1");
-                fprintf(out, "    sub.s $f2, $f0, $f1\n");
-                mgStoreFloat(out, curr->result, "$f2");
+                const char* a = mgSrcFloat(out, curr->arg1, "$f0");
+                const char* b = mgSrcFloat(out, curr->arg2, "$f1");
+                const char* d = mgDstFloat(curr->result, "$f2");
+                mgEmit(out, MIPS_SUB_S, d, a, b);
+                mgStoreFloat(out, curr->result, d);
             } else {
-                mgLoad(out, curr->arg1, "$t0");
-                mgLoad(out, curr->arg2, "$t1");
-                fprintf(out, "    sub $t2, $t0, $t1\n");
-                mgStore(out, curr->result, "$t2");
+                mgSelect(out, curr);
             }
             break;
 
         case TAC_MULTIPLY:
             if (mgOperandType(curr->arg1) == TYPE_FLOAT || mgOperandType(curr->arg2) == TYPE_FLOAT) {
-                mgLoadFloat(out, curr->arg1, "$f0");
-                mgLoadFloat(out, curr->arg2, "$f1");
-                fprintf(out, "    mul.s $f2, $f0, $f1\n");
-                mgStoreFloat(out, curr->result, "$f2");
+                const char* a = mgSrcFloat(out, curr->arg1, "$f0");
+                const char* b = mgSrcFloat(out, curr->arg2, "$f1");
+                const char* d = mgDstFloat(curr->result, "$f2");
+                mgEmit(out, MIPS_MUL_S, d, a, b);
+                mgStoreFloat(out, curr->result, d);
+            } else if (mgPow2Const(curr->arg2) > 0 || mgPow2Const(curr->arg1) > 0) {
+                // x * 2^k is a single shift
+                int k2 = mgPow2Const(curr->arg2);
+                const char* x = k2 > 0 ? curr->arg1 : curr->arg2;
+                const char* a = mgSrc(out, x, "$t0");
+                const char* d = mgDst(curr->result, "$t2");
+                mgEmit(out, MIPS_SLL, d, a, mgFmt("%d", k2 > 0 ? k2 : mgPow2Const(curr->arg1)));
+                mgPut(out, curr->result, d);
             } else {
-                mgLoad(out, curr->arg1, "$t0");
-                mgLoad(out, curr->arg2, "$t1");
-                fprintf(out, "    mult $t0, $t1\n");
-                fprintf(out, "    mflo $t2\n");
-                mgStore(out, curr->result, "$t2");
+                const char* a = mgSrc(out, curr->arg1, "$t0");
+                const char* b = mgSrc(out, curr->arg2, "$t1");
+                const char* d = mgDst(curr->result, "$t2");
+                mgEmit(out, MIPS_MUL, NULL, a, b);
+                mgEmit(out, MIPS_MFLO, d, NULL, NULL);
+                mgPut(out, curr->result, d);
             }
             break;
 
@@ -811,16 +5978,18 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             if (mgOperandType(curr->arg1) == TYPE_FLOAT ||
                 mgOperandType(curr->arg2) == TYPE_FLOAT ||
                 (curr->result && mgIsTemp(curr->result) && mgWillUseTempAsFloat(curr->next, curr->result))) {
-                mgLoadFloat(out, curr->arg1, "$f0");
-                mgLoadFloat(out, curr->arg2, "$f1");
-                fprintf(out, "    div.s $f2, $f0, $f1\n");
-                mgStoreFloat(out, curr->result, "$f2");
+                const char* a = mgSrcFloat(out, curr->arg1, "$f0");
+                const char* b = mgSrcFloat(out, curr->arg2, "$f1");
+                const char* d = mgDstFloat(curr->result, "$f2");
+                mgEmit(out, MIPS_DIV_S, d, a, b);
+                mgStoreFloat(out, curr->result, d);
             } else {
-                mgLoad(out, curr->arg1, "$t0");
-                mgLoad(out, curr->arg2, "$t1");
-                fprintf(out, "    div $t0, $t1\n");
-                fprintf(out, "    mflo $t2\n");
-                mgStore(out, curr->result, "$t2");
+                const char* a = mgSrc(out, curr->arg1, "$t0");
+                const char* b = mgSrc(out, curr->arg2, "$t1");
+                const char* d = mgDst(curr->result, "$t2");
+                mgEmit(out, MIPS_DIV, NULL, a, b);
+                mgEmit(out, MIPS_MFLO, d, NULL, NULL);
+                mgPut(out, curr->result, d);
             }
             break;
 
@@ -831,51 +6000,43 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             VarType elemType = mgVars[vi].type;
             if (mgVars[vi].isLocalArray) {
                 if (elemType == TYPE_FLOAT) {
-                    mgLoadFloat(out, curr->result, "$f0");
+                    const char* v = mgSrcFloat(out, curr->result, "$f0");
                     if (mgIsConst(curr->arg2)) {
-                        fprintf(out, "    s.s $f0, %d($fp)\n",
-                                mgVars[vi].offset + mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_S_S, v, mgFmt("%d(%s)", mgVars[vi].offset + mgConstInt(curr->arg2) * 4, mgFrameReg), NULL);
                     } else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    addi $t2, $fp, %d\n", mgVars[vi].offset);
-                        fprintf(out, "    add $t2, $t2, $t1\n");
-                        fprintf(out, "    s.s $f0, 0($t2)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t2", mgFrameReg, "$t1");
+                        mgEmit(out, MIPS_S_S, v, mgFmt("%d($t2)", mgVars[vi].offset), NULL);
                     }
                 } else {
-                    mgLoad(out, curr->result, "$t0");  // value
+                    const char* v = mgSrc(out, curr->result, "$t0");  // value
                     if (mgIsConst(curr->arg2)) {
-                        fprintf(out, "    sw $t0, %d($fp)\n",
-                                mgVars[vi].offset + mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_SW, v, mgFmt("%d(%s)", mgVars[vi].offset + mgConstInt(curr->arg2) * 4, mgFrameReg), NULL);
                     } else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    addi $t2, $fp, %d\n", mgVars[vi].offset);
-                        fprintf(out, "    add $t2, $t2, $t1\n");
-                        fprintf(out, "    sw $t0, 0($t2)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t2", mgFrameReg, "$t1");
+                        mgEmit(out, MIPS_SW, v, mgFmt("%d($t2)", mgVars[vi].offset), NULL);
                     }
                 }
-            } else if (mgVars[vi].isParam) {
-                fprintf(out, "    lw $t3, %d($fp)\n", mgVars[vi].offset);
+            } else if (mgVars[vi].isParam || mgVars[vi].isMemoTable) {
+                mgArrayBase(out, vi);
                 if (elemType == TYPE_FLOAT) {
-                    mgLoadFloat(out, curr->result, "$f0");
+                    const char* v = mgSrcFloat(out, curr->result, "$f0");
                     if (mgIsConst(curr->arg2))
-                        fprintf(out, "    s.s $f0, %d($t3)\n", mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_S_S, v, mgFmt("%d($t3)", mgConstInt(curr->arg2) * 4), NULL);
                     else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    add $t3, $t3, $t1\n");
-                        fprintf(out, "    s.s $f0, 0($t3)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t3", "$t3", "$t1");
+                        mgEmit(out, MIPS_S_S, v, "0($t3)", NULL);
                     }
                 } else {
-                    mgLoad(out, curr->result, "$t0");  // value
+                    const char* v = mgSrc(out, curr->result, "$t0");  // value
                     if (mgIsConst(curr->arg2))
-                        fprintf(out, "    sw $t0, %d($t3)\n", mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_SW, v, mgFmt("%d($t3)", mgConstInt(curr->arg2) * 4), NULL);
                     else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    add $t3, $t3, $t1\n");
-                        fprintf(out, "    sw $t0, 0($t3)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t3", "$t3", "$t1");
+                        mgEmit(out, MIPS_SW, v, "0($t3)", NULL);
                     }
                 }
             }
@@ -887,56 +6048,50 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             int vi = mgFind(curr->arg1);
             if (vi < 0) break;
             VarType elemType = mgVars[vi].type;
+            const char* d = mgDst(curr->result, "$t0");
+            const char* fd = mgDstFloat(curr->result, "$f0");
             if (mgVars[vi].isLocalArray) {
                 if (elemType == TYPE_FLOAT) {
                     if (mgIsConst(curr->arg2)) {
-                        fprintf(out, "    l.s $f0, %d($fp)\n",
-                                mgVars[vi].offset + mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_L_S, fd, mgFmt("%d(%s)", mgVars[vi].offset + mgConstInt(curr->arg2) * 4, mgFrameReg), NULL);
                     } else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    addi $t2, $fp, %d\n", mgVars[vi].offset);
-                        fprintf(out, "    add $t2, $t2, $t1\n");
-                        fprintf(out, "    l.s $f0, 0($t2)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t2", mgFrameReg, "$t1");
+                        mgEmit(out, MIPS_L_S, fd, mgFmt("%d($t2)", mgVars[vi].offset), NULL);
                     }
                 } else {
                     if (mgIsConst(curr->arg2)) {
-                        fprintf(out, "    lw $t0, %d($fp)\n",
-                                mgVars[vi].offset + mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_LW, d, mgFmt("%d(%s)", mgVars[vi].offset + mgConstInt(curr->arg2) * 4, mgFrameReg), NULL);
                     } else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    addi $t2, $fp, %d\n", mgVars[vi].offset);
-                        fprintf(out, "    add $t2, $t2, $t1\n");
-                        fprintf(out, "    lw $t0, 0($t2)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t2", mgFrameReg, "$t1");
+                        mgEmit(out, MIPS_LW, d, mgFmt("%d($t2)", mgVars[vi].offset), NULL);
                     }
                 }
-            } else if (mgVars[vi].isParam) {
-                fprintf(out, "    lw $t3, %d($fp)\n", mgVars[vi].offset);
+            } else if (mgVars[vi].isParam || mgVars[vi].isMemoTable) {
+                mgArrayBase(out, vi);
                 if (elemType == TYPE_FLOAT) {
                     if (mgIsConst(curr->arg2))
-                        fprintf(out, "    l.s $f0, %d($t3)\n", mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_L_S, fd, mgFmt("%d($t3)", mgConstInt(curr->arg2) * 4), NULL);
                     else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    add $t3, $t3, $t1\n");
-                        fprintf(out, "    l.s $f0, 0($t3)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t3", "$t3", "$t1");
+                        mgEmit(out, MIPS_L_S, fd, "0($t3)", NULL);
                     }
                 } else {
                     if (mgIsConst(curr->arg2))
-                        fprintf(out, "    lw $t0, %d($t3)\n", mgConstInt(curr->arg2) * 4);
+                        mgEmit(out, MIPS_LW, d, mgFmt("%d($t3)", mgConstInt(curr->arg2) * 4), NULL);
                     else {
-                        mgLoad(out, curr->arg2, "$t1");
-                        fprintf(out, "    sll $t1, $t1, 2\n");
-                        fprintf(out, "    add $t3, $t3, $t1\n");
-                        fprintf(out, "    lw $t0, 0($t3)\n");
+                        mgEmit(out, MIPS_SLL, "$t1", mgSrc(out, curr->arg2, "$t1"), "2");
+                        mgEmit(out, MIPS_ADD, "$t3", "$t3", "$t1");
+                        mgEmit(out, MIPS_LW, d, "0($t3)", NULL);
                     }
                 }
             }
             if (elemType == TYPE_FLOAT) {
-                mgStoreFloat(out, curr->result, "$f0");
+                mgStoreFloat(out, curr->result, fd);
             } else {
-                mgStore(out, curr->result, "$t0");
+                mgPut(out, curr->result, d);
             }
             break;
         }
@@ -947,10 +6102,10 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             int fieldOff = mgConstInt(curr->arg2);
 
             if (mgVars[vi].isStructPtr || mgVars[vi].isParam) {
-                fprintf(out, "    lw $t1, %d($fp)\n", mgVars[vi].offset);
-                fprintf(out, "    lw $t0, %d($t1)\n", fieldOff);
+                mgEmit(out, MIPS_LW, "$t1", mgFmt("%d(%s)", mgVars[vi].offset, mgFrameReg), NULL);
+                mgEmit(out, MIPS_LW, "$t0", mgFmt("%d($t1)", fieldOff), NULL);
             } else {
-                fprintf(out, "    lw $t0, %d($fp)\n", mgVars[vi].offset + fieldOff);
+                mgEmit(out, MIPS_LW, "$t0", mgFmt("%d(%s)", mgVars[vi].offset + fieldOff, mgFrameReg), NULL);
             }
             mgStore(out, curr->result, "$t0");
             break;
@@ -963,10 +6118,10 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
             mgLoad(out, curr->result, "$t0");
 
             if (mgVars[vi].isStructPtr || mgVars[vi].isParam) {
-                fprintf(out, "    lw $t1, %d($fp)\n", mgVars[vi].offset);
-                fprintf(out, "    sw $t0, %d($t1)\n", fieldOff);
+                mgEmit(out, MIPS_LW, "$t1", mgFmt("%d(%s)", mgVars[vi].offset, mgFrameReg), NULL);
+                mgEmit(out, MIPS_SW, "$t0", mgFmt("%d($t1)", fieldOff), NULL);
             } else {
-                fprintf(out, "    sw $t0, %d($fp)\n", mgVars[vi].offset + fieldOff);
+                mgEmit(out, MIPS_SW, "$t0", mgFmt("%d(%s)", mgVars[vi].offset + fieldOff, mgFrameReg), NULL);
             }
             break;
         }
@@ -974,7 +6129,7 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
         case TAC_ADDR_OF: {
             int vi = mgFind(curr->arg1);
             if (vi < 0) break;
-            fprintf(out, "    addiu $t0, $fp, %d\n", mgVars[vi].offset);
+            mgEmit(out, MIPS_ADDIU, "$t0", mgFrameReg, mgFmt("%d", mgVars[vi].offset));
             mgStore(out, curr->result, "$t0");
             break;
         }
@@ -992,71 +6147,82 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
                     }
                 }
                 if (strId >= 0) {
-                    fprintf(out, "    la $a0, str_%d\n", strId);
-                    fprintf(out, "    li $v0, 4\n");
-                    fprintf(out, "    syscall\n");
+                    mgEmit(out, MIPS_LA, "$a0", mgFmt("str_%d", strId), NULL);
+                    mgEmit(out, MIPS_LI, "$v0", "4", NULL);
+                    mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
                     if (curr->op == TAC_PRINT) {
-                        fprintf(out, "    li $v0, 11\n");
-                        fprintf(out, "    li $a0, 10\n");
-                        fprintf(out, "    syscall\n");
+                        mgEmit(out, MIPS_LI, "$v0", "11", NULL);
+                        mgEmit(out, MIPS_LI, "$a0", "10", NULL);
+                        mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
                     }
                 }
             } else {
                 VarType pt = mgOperandType(curr->arg1);
                 if (pt == TYPE_FLOAT) {
                     mgLoadFloat(out, curr->arg1, "$f12");
-                    fprintf(out, "    li $v0, 2\n");
-                    fprintf(out, "    syscall\n");
+                    mgEmit(out, MIPS_LI, "$v0", "2", NULL);
+                    mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
                 } else if (pt == TYPE_CHAR) {
                     mgLoad(out, curr->arg1, "$a0");
-                    fprintf(out, "    li $v0, 11\n");
-                    fprintf(out, "    syscall\n");
+                    mgEmit(out, MIPS_LI, "$v0", "11", NULL);
+                    mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
                 } else {
                     mgLoad(out, curr->arg1, "$a0");
-                    fprintf(out, "    li $v0, 1\n");
-                    fprintf(out, "    syscall\n");
+                    mgEmit(out, MIPS_LI, "$v0", "1", NULL);
+                    mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
                 }
                 if (curr->op == TAC_PRINT) {
                     /* Print newline character (syscall 11 = print_char, '\n' = 10) */
-                    fprintf(out, "    li $v0, 11\n");
-                    fprintf(out, "    li $a0, 10\n");
-                    fprintf(out, "    syscall\n");
+                    mgEmit(out, MIPS_LI, "$v0", "11", NULL);
+                    mgEmit(out, MIPS_LI, "$a0", "10", NULL);
+                    mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
                 }
             }
             break;
 
         case TAC_ARG:
-            if (callArgCount < 10)
-                callArgs[callArgCount++] = curr->arg1;
+            if (callArgCount == callArgCap) {
+                callArgCap = callArgCap ? callArgCap * 2 : 16;
+                callArgs = realloc(callArgs, sizeof(char*) * callArgCap);
+            }
+            callArgs[callArgCount++] = curr->arg1;
             break;
 
         case TAC_FUNC_CALL: {
-            // Load args in reverse order → $a0, $a1, …
-            for (int i = 0; i < callArgCount && i < 4; i++) {
-                char* a = callArgs[callArgCount - 1 - i];
-                if (mgIsTemp(a)) {
-                    fprintf(out, "    lw $a%d, %d($fp)\n", i,
-                            mgTempBase + mgTempNum(a) * 4);
-                } else if (mgIsConst(a)) {
-                    fprintf(out, "    li $a%d, %d\n", i, mgConstInt(a));
-                } else {
-                    int vi = mgFind(a);
-                    if (vi >= 0) {
-                        if (mgVars[vi].isLocalArray || mgVars[vi].isLocalStruct)
-                            fprintf(out, "    addi $a%d, $fp, %d\n", i,
-                                    mgVars[vi].offset);
-                        else
-                            fprintf(out, "    lw $a%d, %d($fp)\n", i,
-                                    mgVars[vi].offset);
+            // This call's ARGs are the top nArgs pending, last one first.
+            // Stack args go first: they pass through $t0 and $f0.
+            int nArgs = getFunctionParamCount(curr->arg1);
+            if (nArgs < 0 || nArgs > callArgCount) nArgs = callArgCount;
+            for (int pass = 0; pass < 2; pass++) {
+                for (int i = 0; i < nArgs; i++) {
+                    char* a = callArgs[callArgCount - 1 - i];
+                    int isFloat = getFunctionParamType(curr->arg1, i) == TYPE_FLOAT;
+                    const char* areg = mgArgReg(i, isFloat);
+                    if ((areg == NULL) != (pass == 0)) continue;
+                    const char* dst = areg ? areg : "$t0";
+                    int vi = (mgIsTemp(a) || mgIsConst(a)) ? -1 : mgFind(a);
+                    if (vi >= 0 && (mgVars[vi].isLocalArray || mgVars[vi].isLocalStruct)) {
+                        mgEmit(out, MIPS_ADDI, dst, mgFrameReg, mgFmt("%d", mgVars[vi].offset));
+                    } else if (dst[1] == 'f') {
+                        mgLoadFloat(out, a, dst);
+                    } else if (isFloat) {
+                        mgEmit(out, MIPS_MFC1, dst, mgSrcFloat(out, a, "$f0"), NULL);
+                    } else {
+                        mgLoad(out, a, dst);
                     }
+                    if (!areg) mgEmit(out, MIPS_SW, "$t0", mgFmt("%d($sp)", 4 * (i - 4)), NULL);
                 }
             }
+            callArgCount -= nArgs;
+            mgSaveAcrossCall(out, curr, 1);
             char callLab[256];
             if (strcmp(curr->arg1, "main") == 0)
                 snprintf(callLab, sizeof(callLab), "main");
             else
                 snprintf(callLab, sizeof(callLab), "fn_%s", curr->arg1);
-            fprintf(out, "    jal %s\n", callLab);
+            mgEmit(out, MIPS_JAL, NULL, callLab, NULL);
+            mgSaveAcrossCall(out, curr, 0);
+            mgConvReset();
             if (curr->result) {
                 if (getFunctionReturnType(curr->arg1) == TYPE_FLOAT) {
                     mgStoreFloat(out, curr->result, "$f0");
@@ -1064,7 +6230,6 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
                     mgStore(out, curr->result, "$v0");
                 }
             }
-            callArgCount = 0;
             break;
         }
 
@@ -1077,106 +6242,124 @@ void generateMIPSFromOptimizedTAC2(const char* filename) {
                 }
             }
             if (inMain) {
-                fprintf(out, "    li $v0, 10\n");
-                fprintf(out, "    syscall\n");
+                mgEmit(out, MIPS_LI, "$v0", "10", NULL);
+                mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
             } else {
-                fprintf(out, "    lw $ra, %d($sp)\n", mgFrameSize - 4);
-                fprintf(out, "    lw $fp, %d($sp)\n", mgFrameSize - 8);
-                fprintf(out, "    addu $sp, $sp, %d\n", mgFrameSize);
-                fprintf(out, "    jr $ra\n");
+                mgCalleeSaves(out, 0);
+                if (mgFrameLink)
+                    mgEmit(out, MIPS_LW, "$ra", mgFmt("%d($sp)", mgFrameSize - 4), NULL);
+                if (!mgUseRegs)
+                    mgEmit(out, MIPS_LW, "$fp", mgFmt("%d($sp)", mgFrameSize - 8), NULL);
+                if (mgFrameSize > 0)
+                    mgEmit(out, MIPS_ADDU, "$sp", "$sp", mgFmt("%d", mgFrameSize));
+                mgEmit(out, MIPS_JR, NULL, "$ra", NULL);
             }
             break;
 
         case TAC_LABEL:
             /* At every label (merge point) we conceptually invalidate all
              * register descriptors — code may have arrived here via a branch
-             * from a different path.  Because this code generator uses a
-             * strict load/store discipline (every variable read calls mgLoad,
-             * which always emits lw/li from the stack slot), no stale cached
-             * register value is ever used.  The comment below documents the
-             * invariant explicitly, as required by Activity 2 Task 3.3/3.5. */
-            fprintf(out, "%s:    # merge point — register state invalidated\n",
-                    curr->arg1);
+             * from a different path.  Scratch registers are reloaded by every
+             * instruction, and an allocated value owns its register for its
+             * whole live interval on every path, so no stale cached register
+             * value is ever used.  The comment below documents the invariant
+             * explicitly, as required by Activity 2 Task 3.3/3.5. */
+            appendMIPS(out, createMIPS(MIPS_LABEL, NULL, curr->arg1, NULL,
+                                       "merge point — register state invalidated"));
+            mgConvReset();
             break;
 
         case TAC_GOTO:
             /* Before an unconditional jump, all live variables are already
-             * in memory (every assignment emits mgStore).  This is equivalent
-             * to calling spillAllRegisters() as required by Activity 2 Task 3.4. */
-            fprintf(out, "    j %s    # unconditional jump (all vars in memory)\n",
-                    curr->arg1);
-            break;
-
-        case TAC_IF_FALSE:
-            /* Before the conditional branch, variables are in memory via the
-             * load/store discipline — equivalent to spillAllRegisters(). */
-            mgLoad(out, curr->arg1, "$t0");
-            fprintf(out, "    beqz $t0, %s    # branch if false\n", curr->result);
-            break;
-
-        case TAC_EQ:
-            mgLoad(out, curr->arg1, "$t0");
-            mgLoad(out, curr->arg2, "$t1");
-            fprintf(out, "    seq $t2, $t0, $t1\n");
-            mgStore(out, curr->result, "$t2");
-            break;
-
-        case TAC_NE:
-            mgLoad(out, curr->arg1, "$t0");
-            mgLoad(out, curr->arg2, "$t1");
-            fprintf(out, "    sne $t2, $t0, $t1\n");
-            mgStore(out, curr->result, "$t2");
+             * in their home (allocated register or stack slot; every
+             * assignment emits mgStore).  This is equivalent to calling
+             * spillAllRegisters() as required by Activity 2 Task 3.4. */
+            appendMIPS(out, createMIPS(MIPS_J, NULL, curr->arg1, NULL,
+                                       "unconditional jump (all vars in place)"));
             break;
 
-        case TAC_LT:
-            mgLoad(out, curr->arg1, "$t0");
-            mgLoad(out, curr->arg2, "$t1");
-            fprintf(out, "    slt $t2, $t0, $t1\n");
-            mgStore(out, curr->result, "$t2");
+        case TAC_EQ: case TAC_NE: case TAC_LT:
+        case TAC_GT: case TAC_LE: case TAC_GE:
+            curr = mgSelect(out, curr);
             break;
 
-        case TAC_GT:
-            mgLoad(out, curr->arg1, "$t0");
-            mgLoad(out, curr->arg2, "$t1");
-            fprintf(out, "    sgt $t2, $t0, $t1\n");
-            mgStore(out, curr->result, "$t2");
-            break;
-
-        case TAC_LE:
-            mgLoad(out, curr->arg1, "$t0");
-            mgLoad(out, curr->arg2, "$t1");
-            fprintf(out, "    sle $t2, $t0, $t1\n");
-            mgStore(out, curr->result, "$t2");
+        case TAC_IF_FALSE:
+            /* Before the conditional branch, variables are in their home
+             * as for GOTO — equivalent to spillAllRegisters(). */
+            appendMIPS(out, createMIPS(MIPS_BEQZ, mgSrc(out, curr->arg1, "$t0"), curr->result, NULL,
+                                       "branch if false"));
             break;
 
-        case TAC_GE:
-            mgLoad(out, curr->arg1, "$t0");
-            mgLoad(out, curr->arg2, "$t1");
-            fprintf(out, "    sge $t2, $t0, $t1\n");
-            mgStore(out, curr->result, "$t2");
+        case TAC_SELECT:
+            /* Branchless: movn only overwrites $t2 when the condition is set */
+        {
+            const char* c = mgSrc(out, curr->arg1, "$t0");
+            const char* a = mgSrc(out, curr->arg2, "$t1");
+            const char* d = mgSrc(out, curr->result, "$t2");
+            mgEmit(out, MIPS_MOVN, d, a, c);
+            mgPut(out, curr->result, d);
             break;
+        }
 
         default: break;
         }
+        if (mgDefinesResult(curr->op)) mgConvForget(curr->result);
 
         curr = curr->next;
     }
 
     // If main ended without explicit RETURN, emit exit
     if (inMain) {
-        fprintf(out, "    li $v0, 10\n");
-        fprintf(out, "    syscall\n");
+        mgEmit(out, MIPS_LI, "$v0", "10", NULL);
+        mgEmit(out, MIPS_SYSCALL, NULL, NULL, NULL);
+    }
+
+    if (mgRA.haveLive) liveFree(&mgRA.L);
+    free(mgRA.code);
+    mgRA.code = NULL;
+    mgRA.haveLive = 0;
+    free(callArgs);
+    free(mgTempOffsets);
+    free(mgTempRegs);
+    free(mgTempTypes);
+    mgTempOffsets = NULL;
+    mgTempRegs = NULL;
+    mgTempTypes = NULL;
+    mgTempCap = 0;
+
+    if (mgUseRegs) peepholeMIPS(out);
+    if (delaySlots) fillDelaySlotsMIPS(out, mgUseRegs);
+    mgLastCount = countMIPSInstructions(out);
+    FILE* file = fopen(filename, "w");
+    if (file) {
+        static char obuf[1 << 16];
+        setvbuf(file, obuf, _IOFBF, sizeof(obuf));
+        printMIPS(out, file);
+        fclose(file);
+    } else {
+        fprintf(stderr, "Error: Cannot open output file %s\n", filename);
+        mgLastCount = -1;
     }
+    freeMIPSList(out);
+}
+
+int getLastMIPSInstructionCount(void) {
+    return mgLastCount;
+}
 
-    fclose(out);
+void generateMIPSFromOptimizedTAC2(const char* filename) {
+    mgUseRegs = 1;
+    mgGenerate(filename);
 }
 
+/* The unoptimized baseline keeps every value in its stack slot */
 void generateMIPSFromUnoptimizedTAC2(const char* filename) {
     TACInstr* savedHead = optimizedList.head;
     TACInstr* savedTail = optimizedList.tail;
     optimizedList.head = tacList.head;
     optimizedList.tail = tacList.tail;
-    generateMIPSFromOptimizedTAC2(filename);
+    mgUseRegs = 0;
+    mgGenerate(filename);
     optimizedList.head = savedHead;
     optimizedList.tail = savedTail;
 }
@@ -1293,6 +6476,9 @@ void printOptimizedTAC2() {
             case TAC_GE:
                 printf("%2d: %s = %s >= %s           // Greater or equal\n", instrNum++, curr->result, curr->arg1, curr->arg2);
                 break;
+            case TAC_SELECT:
+                printf("%2d: %s = %s ? %s : %s     // Branchless select\n", instrNum++, curr->result, curr->arg1, curr->arg2, curr->result);
+                break;
         }
         curr = curr->next;
     }
@@ -1409,6 +6595,9 @@ void printOptimizedTACToFile2(const char* filename) {
             case TAC_GE:
                 fprintf(file, "%2d: %s = %s >= %s           // Greater or equal\n", instrNum++, curr->result, curr->arg1, curr->arg2);
                 break;
+            case TAC_SELECT:
+                fprintf(file, "%2d: %s = %s ? %s : %s     // Branchless select\n", instrNum++, curr->result, curr->arg1, curr->arg2, curr->result);
+                break;
         }
         curr = curr->next;
     }
@@ -1525,6 +6714,8 @@ void printTACToFile2(const char* filename) {
             case TAC_GE:
                 fprintf(file, "%2d: %s = %s >= %s\n", instrNum++, curr->result, curr->arg1, curr->arg2);
                 break;
+            default:
+                break;
         }
         curr = curr->next;
     }
@@ -7,10 +7,19 @@
 void optimizeTAC2();
 void generateMIPSFromOptimizedTAC2(const char* filename);
 void generateMIPSFromUnoptimizedTAC2(const char* filename);
+int getLastMIPSInstructionCount(void);    /* counted in memory, -1 if not written */
 void printOptimizedTAC2();
 void printOptimizedTACToFile2(const char* filename);
 void printTACToFile2(const char* filename);
 int getOptimizerConstFoldCount(void);
 int getOptimizerDeadCodeElimCount(void);
 
+/* Optimization profiles: post-pass order and thresholds */
+int  optLoadProfile(const char* path);                        /* 0 ok, -1 on error */
+int  optSetProfileOption(const char* key, const char* value); /* "passes" or a threshold */
+int  optGetProfileOption(const char* key, int* value);        /* thresholds only */
+int  optNumProfilePasses(void);
+const char* optProfilePass(int i);
+void optWriteProfile(FILE* out, int target);               /* target: regalloc, delay-slots only */
+
 #endif
@@ -0,0 +1,552 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "superopt.h"
+
+#define SO_MAX_WINDOW  4        /* TAC instructions in a window */
+#define SO_MAX_REPLACE 2        /* instructions in a replacement */
+#define SO_MAX_INPUTS  3
+#define SO_MAX_RULES   512
+#define SO_MAX_CONSTS  16
+#define SO_SMALL       3        /* test every input in [-SO_SMALL, SO_SMALL] */
+#define SO_RANDOM      48
+#define SO_MAX_VALUES  64
+#define SO_MAX_VECTORS 2048
+#define SO_LINE        256
+
+typedef enum { SO_MOV, SO_ADD, SO_SUB, SO_MUL, SO_EQ, SO_NE,
+               SO_LT, SO_GT, SO_LE, SO_GE, SO_NOPS } SoOp;
+
+static const char* soOpNames[SO_NOPS] = { "mov", "add", "sub", "mul", "eq", "ne", "lt", "gt", "le", "ge" };
+static const TACOp soTacOps[SO_NOPS]  = { TAC_ASSIGN, TAC_ADD, TAC_SUBTRACT, TAC_MULTIPLY, TAC_EQ, TAC_NE,
+                                          TAC_LT, TAC_GT, TAC_LE, TAC_GE };
+/* Instructions the register-allocated backend emits with both operands in
+ * registers (mult/mflo for mul; seq, sne, sle and sge expand to two), and
+ * with a constant second operand in its immediate form (mgRules) */
+static const int   soOpCost[SO_NOPS]  = { 1, 1, 1, 2, 2, 2, 1, 1, 2, 2 };
+static const int   soImmCost[SO_NOPS] = { 1, 1, 1, 3, 2, 2, 1, 2, 1, 2 };
+/* The operator with its operands swapped (a OP b == b OP' a), or -1 */
+static const int   soMirror[SO_NOPS]  = { -1, SO_ADD, -1, SO_MUL, SO_EQ, SO_NE,
+                                          SO_GT, SO_LT, SO_GE, SO_LE };
+
+typedef struct { char kind; int val; } SoArg;   /* 'v' input, 'r' earlier result, 'c' constant, 0 none */
+typedef struct { SoOp op; SoArg a, b; } SoInstr;
+
+typedef struct {
+    SoInstr win[SO_MAX_WINDOW];
+    int     nWin;
+    int     nInputs;
+    SoInstr rep[SO_MAX_REPLACE];
+    int     nRep;
+    char*   key;                                /* the window in table syntax */
+} SoRule;
+
+static SoRule soRules[SO_MAX_RULES];
+static int    soNumRules = 0;
+static int    soLoaded = 0;
+static int    soTraining = 0;
+static char*  soTried[SO_MAX_RULES];           /* windows searched without a win */
+static int    soNumTried = 0;
+
+#include "superopt_table.h"
+
+/* ── Table syntax: "add v0 #4 ; eq r0 #10 => eq v0 #6" ── */
+
+static void soFormatArg(SoArg x, char* buf) {
+    switch (x.kind) {
+    case 'v': sprintf(buf, "v%d", x.val); break;
+    case 'r': sprintf(buf, "r%d", x.val); break;
+    case 'c': sprintf(buf, "#%d", x.val); break;
+    default:  strcpy(buf, "-");           break;
+    }
+}
+
+static void soFormat(const SoInstr* s, int n, char* out) {
+    char a[16], b[16];
+    out[0] = '\0';
+    for (int i = 0; i < n; i++) {
+        soFormatArg(s[i].a, a);
+        soFormatArg(s[i].b, b);
+        sprintf(out + strlen(out), "%s%s %s %s", i ? " ; " : "", soOpNames[s[i].op], a, b);
+    }
+}
+
+static int soParseArg(const char* tok, SoArg* x) {
+    x->kind = 0;
+    x->val = 0;
+    if (strcmp(tok, "-") == 0) return 1;
+    if (tok[0] != 'v' && tok[0] != 'r' && tok[0] != '#') return 0;
+    char* end;
+    x->val = (int)strtol(tok + 1, &end, 10);
+    x->kind = tok[0] == '#' ? 'c' : tok[0];
+    return *end == '\0' && end != tok + 1;
+}
+
+static int soParseSeq(char* text, SoInstr* out, int max) {
+    int n = 0;
+    char* save = NULL;
+    char* tok = strtok_r(text, " ", &save);
+    while (tok) {
+        if (strcmp(tok, ";") == 0) { tok = strtok_r(NULL, " ", &save); continue; }
+        if (n >= max) return -1;
+        int op = 0;
+        while (op < SO_NOPS && strcmp(soOpNames[op], tok) != 0) op++;
+        char* a = strtok_r(NULL, " ", &save);
+        char* b = a ? strtok_r(NULL, " ", &save) : NULL;
+        if (op == SO_NOPS || !b || !soParseArg(a, &out[n].a) || !soParseArg(b, &out[n].b)) return -1;
+        out[n++].op = (SoOp)op;
+        tok = strtok_r(NULL, " ", &save);
+    }
+    return n;
+}
+
+static int soFindRule(const char* key) {
+    for (int i = 0; i < soNumRules; i++)
+        if (strcmp(soRules[i].key, key) == 0) return i;
+    return -1;
+}
+
+static int soAddRuleText(const char* line) {
+    char buf[SO_LINE];
+    if (soNumRules >= SO_MAX_RULES || strlen(line) >= sizeof(buf)) return 0;
+    strcpy(buf, line);
+    char* arrow = strstr(buf, " => ");
+    if (!arrow) return 0;
+    *arrow = '\0';
+    SoRule* r = &soRules[soNumRules];
+    char key[SO_LINE];
+    r->nWin = soParseSeq(buf, r->win, SO_MAX_WINDOW);
+    r->nRep = soParseSeq(arrow + 4, r->rep, SO_MAX_REPLACE);
+    if (r->nWin < 1 || r->nRep < 1) return 0;
+    r->nInputs = 0;
+    for (int i = 0; i < r->nWin; i++) {
+        if (r->win[i].a.kind == 'v' && r->win[i].a.val >= r->nInputs) r->nInputs = r->win[i].a.val + 1;
+        if (r->win[i].b.kind == 'v' && r->win[i].b.val >= r->nInputs) r->nInputs = r->win[i].b.val + 1;
+    }
+    soFormat(r->win, r->nWin, key);
+    if (soFindRule(key) >= 0) return 0;
+    r->key = strdup(key);
+    soNumRules++;
+    return 1;
+}
+
+int superoptLoadTable(void) {
+    if (soLoaded) return soNumRules;
+    soLoaded = 1;
+    for (int i = 0; superoptTable[i]; i++)
+        soAddRuleText(superoptTable[i]);
+    return soNumRules;
+}
+
+void superoptSetTraining(int on) {
+    soTraining = on;
+}
+
+int superoptSaveTable(const char* path) {
+    /* keep what earlier training runs wrote but this build does not have */
+    FILE* f = fopen(path, "r");
+    if (f) {
+        char line[SO_LINE + 16];
+        while (fgets(line, sizeof(line), f)) {
+            char* open = strchr(line, '"');
+            char* close = open ? strrchr(line, '"') : NULL;
+            if (!open || close == open) continue;
+            *close = '\0';
+            soAddRuleText(open + 1);
+        }
+        fclose(f);
+    }
+
+    f = fopen(path, "w");
+    if (!f) return -1;
+    fprintf(f, "/* GENERATED FILE: superoptimizer rewrite table.\n"
+               " * Regenerate with `make superopt-table`, which runs\n"
+               " * `minicompiler --superopt` over the test programs.\n"
+               " * Each entry reads  window => replacement,  where vN is an input,\n"
+               " * rN the result of instruction N and #c a constant.\n"
+               " */\n");
+    fprintf(f, "static const char* superoptTable[] = {\n");
+    for (int i = 0; i < soNumRules; i++) {
+        char rep[SO_LINE];
+        soFormat(soRules[i].rep, soRules[i].nRep, rep);
+        fprintf(f, "    \"%s => %s\",\n", soRules[i].key, rep);
+    }
+    fprintf(f, "    NULL\n};\n");
+    fclose(f);
+    return soNumRules;
+}
+
+/* ── Search ── */
+
+static unsigned soApply(SoOp op, unsigned a, unsigned b) {
+    switch (op) {
+    case SO_MOV: return a;
+    case SO_ADD: return a + b;
+    case SO_SUB: return a - b;
+    case SO_MUL: return a * b;
+    case SO_EQ:  return a == b;
+    case SO_NE:  return a != b;
+    case SO_LT:  return (int)a <  (int)b;
+    case SO_GT:  return (int)a >  (int)b;
+    case SO_LE:  return (int)a <= (int)b;
+    default:     return (int)a >= (int)b;
+    }
+}
+
+static unsigned soArgVal(SoArg x, const unsigned* in, const unsigned* res) {
+    switch (x.kind) {
+    case 'v': return in[x.val];
+    case 'r': return res[x.val];
+    case 'c': return (unsigned)x.val;
+    default:  return 0;
+    }
+}
+
+static unsigned soRun(const SoInstr* s, int n, const unsigned* in) {
+    unsigned res[SO_MAX_WINDOW];
+    for (int i = 0; i < n; i++)
+        res[i] = soApply(s[i].op, soArgVal(s[i].a, in, res), soArgVal(s[i].b, in, res));
+    return res[n - 1];
+}
+
+static int soIsPow2(SoArg x) {
+    return x.kind == 'c' && x.val >= 2 && (x.val & (x.val - 1)) == 0;
+}
+
+static int soIsImm(SoArg x) {
+    return x.kind == 'c' && x.val >= -32768 && x.val <= 32767;
+}
+
+/* Instructions the register-allocated backend emits: inputs and results
+ * stay in registers, so a copy is one move or li and an operation is its
+ * ALU work plus an li for each constant with no immediate form */
+static int soInstrCost(const SoInstr* s) {
+    if (s->op == SO_MOV) return 1;
+    if (s->op == SO_MUL && (soIsPow2(s->a) || soIsPow2(s->b))) return 1;
+    int op = s->op;
+    SoArg a = s->a, b = s->b;
+    if (soIsImm(a) && !soIsImm(b) && soMirror[op] >= 0) {
+        op = soMirror[op];
+        a = s->b;
+        b = s->a;
+    }
+    if (!soIsImm(b)) return soOpCost[op] + (a.kind == 'c') + (b.kind == 'c');
+    if ((op == SO_EQ || op == SO_NE) && b.val == 0) return 1 + (a.kind == 'c');
+    return soImmCost[op] + (a.kind == 'c');
+}
+
+static int soSeqCost(const SoInstr* s, int n) {
+    int c = 0;
+    for (int i = 0; i < n; i++) c += soInstrCost(&s[i]);
+    return c;
+}
+
+/* Test inputs: random words first (they reject most candidates at
+ * once), then every combination of the interesting values, i.e. a
+ * small range, the int boundaries and each constant the window could
+ * be compared against together with its neighbours.  When there are
+ * too many combinations, random picks among them. */
+static int soVectors(int m, const int* consts, int nConsts, unsigned vec[][SO_MAX_INPUTS]) {
+    unsigned vals[SO_MAX_VALUES];
+    int nVals = 0;
+    unsigned seed = 12345u;
+#define SO_VALUE(x) do { unsigned _v = (unsigned)(x); int _k = 0; \
+        while (_k < nVals && vals[_k] != _v) _k++; \
+        if (_k == nVals && nVals < SO_MAX_VALUES) vals[nVals++] = _v; } while (0)
+    for (int v = -SO_SMALL; v <= SO_SMALL; v++) SO_VALUE(v);
+    SO_VALUE(0x7fffffffu);
+    SO_VALUE(0x80000000u);
+    for (int c = 0; c < nConsts; c++) {
+        SO_VALUE(consts[c]);
+        SO_VALUE((unsigned)consts[c] - 1u);
+        SO_VALUE((unsigned)consts[c] + 1u);
+    }
+#undef SO_VALUE
+
+    int nv = 0;
+    for (int r = 0; r < SO_RANDOM; r++, nv++)
+        for (int i = 0; i < SO_MAX_INPUTS; i++) {
+            seed = seed * 1103515245u + 12345u;
+            vec[nv][i] = seed ^ (seed >> 13);
+        }
+    long total = 1;
+    for (int i = 0; i < m; i++) total *= nVals;
+    int exhaustive = total <= SO_MAX_VECTORS - SO_RANDOM;
+    for (long k = 0; nv < SO_MAX_VECTORS && (!exhaustive || k < total); k++, nv++) {
+        long rest = k;
+        for (int i = 0; i < SO_MAX_INPUTS; i++) {
+            seed = seed * 1103515245u + 12345u;
+            vec[nv][i] = vals[exhaustive ? rest % nVals : (seed >> 8) % nVals];
+            rest /= nVals;
+        }
+    }
+    return nv;
+}
+
+typedef struct {
+    SoRule*  rule;
+    unsigned (*vec)[SO_MAX_INPUTS];
+    unsigned* want;
+    int      nv;
+    int      consts[SO_MAX_CONSTS];
+    int      nConsts;
+    SoInstr  cand[SO_MAX_REPLACE];
+    int      len;
+    int      bestCost;
+    int      found;
+} SoSearch;
+
+static void soAddConst(SoSearch* S, long v) {
+    if (v != (int)v || S->nConsts >= SO_MAX_CONSTS) return;
+    for (int i = 0; i < S->nConsts; i++)
+        if (S->consts[i] == v) return;
+    S->consts[S->nConsts++] = (int)v;
+}
+
+static int soVerify(SoSearch* S) {
+    for (int v = 0; v < S->nv; v++)
+        if (soRun(S->cand, S->len, S->vec[v]) != S->want[v]) return 0;
+    return 1;
+}
+
+/* Operand number k at position p: inputs, then earlier results, then constants */
+static SoArg soPoolArg(SoSearch* S, int p, int k) {
+    SoArg x;
+    int m = S->rule->nInputs;
+    if (k < m)          { x.kind = 'v'; x.val = k; }
+    else if (k < m + p) { x.kind = 'r'; x.val = k - m; }
+    else                { x.kind = 'c'; x.val = S->consts[k - m - p]; }
+    return x;
+}
+
+static void soEnumerate(SoSearch* S, int p, int costSoFar) {
+    int m = S->rule->nInputs, pool = m + p + S->nConsts;
+    SoArg none = { 0, 0 };
+    for (int op = 0; op < SO_NOPS; op++) {
+        int commutes = op == SO_ADD || op == SO_MUL || op == SO_EQ || op == SO_NE;
+        for (int ka = 0; ka < pool; ka++) {
+            int kbFirst = op == SO_MOV ? -1 : (commutes ? ka : 0), kbEnd = op == SO_MOV ? 0 : pool;
+            for (int kb = kbFirst; kb < kbEnd; kb++) {
+                SoInstr* c = &S->cand[p];
+                c->op = (SoOp)op;
+                c->a = soPoolArg(S, p, ka);
+                c->b = kb < 0 ? none : soPoolArg(S, p, kb);
+                if (c->a.kind == 'c' && (c->b.kind == 'c' || op == SO_MOV) && p + 1 < S->len) continue;
+                int cost = costSoFar + soInstrCost(c);
+                if (cost >= S->bestCost) continue;
+                if (p + 1 < S->len) {
+                    soEnumerate(S, p + 1, cost);
+                } else if (soVerify(S)) {
+                    memcpy(S->rule->rep, S->cand, sizeof(SoInstr) * S->len);
+                    S->rule->nRep = S->len;
+                    S->bestCost = cost;
+                    S->found = 1;
+                }
+            }
+        }
+    }
+}
+
+/* Cheapest shorter sequence equal to the window on every test vector */
+static int soSearchRule(SoRule* r) {
+    static unsigned vec[SO_MAX_VECTORS][SO_MAX_INPUTS], want[SO_MAX_VECTORS];
+    SoSearch S;
+    memset(&S, 0, sizeof(S));
+    S.rule = r;
+    S.vec = vec;
+    S.want = want;
+
+    int wc[2 * SO_MAX_WINDOW], nwc = 0;
+    for (int i = 0; i < r->nWin; i++) {
+        if (r->win[i].a.kind == 'c') wc[nwc++] = r->win[i].a.val;
+        if (r->win[i].b.kind == 'c') wc[nwc++] = r->win[i].b.val;
+    }
+    soAddConst(&S, 0);
+    soAddConst(&S, 1);
+    for (int i = 0; i < nwc; i++) soAddConst(&S, wc[i]);
+    for (int i = 0; i < nwc; i++) soAddConst(&S, -(long)wc[i]);
+    for (int i = 0; i < nwc; i++)
+        for (int j = 0; j < nwc; j++) {
+            if (i < j) soAddConst(&S, (long)wc[i] + wc[j]);
+            if (i != j) soAddConst(&S, (long)wc[j] - wc[i]);
+            if (i < j) soAddConst(&S, (long)wc[i] * wc[j]);
+        }
+    soAddConst(&S, 2);
+
+    S.nv = soVectors(r->nInputs, S.consts, S.nConsts, vec);
+    for (int v = 0; v < S.nv; v++) want[v] = soRun(r->win, r->nWin, vec[v]);
+
+    S.bestCost = soSeqCost(r->win, r->nWin);
+    for (S.len = 1; S.len < r->nWin && S.len <= SO_MAX_REPLACE && !S.found; S.len++)
+        soEnumerate(&S, 0, 0);
+    return S.found;
+}
+
+/* ── Peephole ── */
+
+static int soIsTemp(const char* s) {
+    if (!s || s[0] != 't' || s[1] == '\0') return 0;
+    for (int i = 1; s[i]; i++) if (!isdigit((unsigned char)s[i])) return 0;
+    return 1;
+}
+
+static int soIntConst(const char* s, int* v) {
+    if (!s || !*s) return 0;
+    char* end;
+    long x = strtol(s, &end, 10);
+    if (*end != '\0' || x != (int)x) return 0;
+    *v = (int)x;
+    return 1;
+}
+
+static int soOpOf(TACOp op, SoOp* out) {
+    for (int i = 0; i < SO_NOPS; i++)
+        if (soTacOps[i] == op) { *out = (SoOp)i; return 1; }
+    return 0;
+}
+
+static int soSame(const char* a, const char* b) {
+    return a && b && strcmp(a, b) == 0;
+}
+
+/* Abstract code[i..i+k) into r->win; names[] receives the inputs */
+static int soAbstract(TACInstr** code, int i, int k, int (*isInt)(const char*),
+                      const int* mentions, int maxTemp, SoRule* r, const char** names) {
+    r->nWin = k;
+    r->nInputs = 0;
+    for (int j = 0; j < k; j++) {
+        TACInstr* in = code[i + j];
+        SoInstr* s = &r->win[j];
+        if (!soOpOf(in->op, &s->op) || !in->result || !isInt(in->result)) return 0;
+        for (int q = 0; q < j; q++)
+            if (soSame(code[i + q]->result, in->result)) return 0;
+        const char* ops[2] = { in->arg1, s->op == SO_MOV ? NULL : in->arg2 };
+        for (int f = 0; f < 2; f++) {
+            SoArg* x = f ? &s->b : &s->a;
+            x->kind = 0;
+            x->val = 0;
+            if (!ops[f]) {
+                if (f == 0 || s->op != SO_MOV) return 0;
+                continue;
+            }
+            if (soIntConst(ops[f], &x->val)) { x->kind = 'c'; continue; }
+            if (ops[f][0] == '"' || !isInt(ops[f])) return 0;
+            for (int q = 0; q < j; q++)
+                if (soSame(code[i + q]->result, ops[f])) { x->kind = 'r'; x->val = q; }
+            if (x->kind) continue;
+            int v = 0;
+            while (v < r->nInputs && !soSame(names[v], ops[f])) v++;
+            if (v == SO_MAX_INPUTS) return 0;
+            if (v == r->nInputs) names[r->nInputs++] = ops[f];
+            x->kind = 'v';
+            x->val = v;
+        }
+    }
+    /* intermediate results: temps nothing outside the window mentions */
+    for (int j = 0; j + 1 < k; j++) {
+        const char* t = code[i + j]->result;
+        if (!soIsTemp(t) || atoi(t + 1) > maxTemp) return 0;
+        for (int v = 0; v < r->nInputs; v++)
+            if (soSame(names[v], t)) return 0;
+        int inside = 0;
+        for (int q = 0; q < k; q++)
+            inside += soSame(code[i + q]->arg1, t) + soSame(code[i + q]->arg2, t) +
+                      soSame(code[i + q]->result, t);
+        if (inside != mentions[atoi(t + 1)]) return 0;
+    }
+    return 1;
+}
+
+static void soSet(char** field, const char* val) {
+    char* copy = val ? strdup(val) : NULL;
+    free(*field);
+    *field = copy;
+}
+
+/* Write the replacement over the tail of the window, kill the head */
+static void soRewrite(TACInstr** code, int i, SoRule* r, const char** names, int* dead) {
+    int k = r->nWin, j = r->nRep;
+    char* inputs[SO_MAX_INPUTS];
+    char* results[SO_MAX_REPLACE];
+    for (int v = 0; v < r->nInputs; v++) inputs[v] = strdup(names[v]);
+    for (int q = 0; q < j; q++)
+        results[q] = q == j - 1 ? strdup(code[i + k - 1]->result) : newTemp();
+    for (int q = 0; q < j; q++) {
+        TACInstr* in = code[i + k - j + q];
+        SoArg args[2] = { r->rep[q].a, r->rep[q].b };
+        char* vals[2] = { NULL, NULL };
+        char buf[2][16];
+        for (int f = 0; f < 2; f++) {
+            if (args[f].kind == 'v')      vals[f] = inputs[args[f].val];
+            else if (args[f].kind == 'r') vals[f] = results[args[f].val];
+            else if (args[f].kind == 'c') { sprintf(buf[f], "%d", args[f].val); vals[f] = buf[f]; }
+        }
+        in->op = soTacOps[r->rep[q].op];
+        soSet(&in->arg1, vals[0]);
+        soSet(&in->arg2, vals[1]);
+        soSet(&in->result, results[q]);
+    }
+    for (int q = 0; q < k - j; q++) dead[i + q] = 1;
+    for (int v = 0; v < r->nInputs; v++) free(inputs[v]);
+    for (int q = 0; q < j; q++) free(results[q]);
+}
+
+static int soWasTried(const char* key) {
+    for (int i = 0; i < soNumTried; i++)
+        if (strcmp(soTried[i], key) == 0) return 1;
+    return 0;
+}
+
+int superoptPeephole(TACInstr** code, int n, int (*isInt)(const char*), int* dead) {
+    superoptLoadTable();
+    if (soNumRules == 0 && !soTraining) return 0;
+
+    /* how often each temp is mentioned in the function */
+    int maxTemp = -1;
+    for (int i = 0; i < n; i++) {
+        const char* f[3] = { code[i]->arg1, code[i]->arg2, code[i]->result };
+        for (int q = 0; q < 3; q++)
+            if (soIsTemp(f[q]) && atoi(f[q] + 1) > maxTemp) maxTemp = atoi(f[q] + 1);
+    }
+    int* mentions = calloc(maxTemp + 2, sizeof(int));
+    for (int i = 0; i < n; i++) {
+        const char* f[3] = { code[i]->arg1, code[i]->arg2, code[i]->result };
+        for (int q = 0; q < 3; q++)
+            if (soIsTemp(f[q])) mentions[atoi(f[q] + 1)]++;
+    }
+
+    int rewrites = 0;
+    for (int i = 0; i < n; i++) {
+        for (int k = SO_MAX_WINDOW; k >= 2; k--) {
+            if (i + k > n) continue;
+            int live = 1;
+            for (int q = 0; q < k; q++) live &= !dead[i + q];
+            SoRule w;
+            const char* names[SO_MAX_INPUTS];
+            char key[SO_LINE];
+            if (!live || !soAbstract(code, i, k, isInt, mentions, maxTemp, &w, names)) continue;
+            soFormat(w.win, w.nWin, key);
+            int ri = soFindRule(key);
+            if (ri < 0 && soTraining && !soWasTried(key) && soNumRules < SO_MAX_RULES) {
+                if (soSearchRule(&w)) {
+                    char rep[SO_LINE];
+                    soFormat(w.rep, w.nRep, rep);
+                    w.key = strdup(key);
+                    soRules[soNumRules] = w;
+                    ri = soNumRules++;
+                    fprintf(stderr, "\n⚡ Superoptimizer: learned  %s  =>  %s\n\n", key, rep);
+                } else if (soNumTried < SO_MAX_RULES) {
+                    soTried[soNumTried++] = strdup(key);
+                }
+            }
+            if (ri < 0) continue;
+            soRewrite(code, i, &soRules[ri], names, dead);
+            rewrites++;
+            i += k - 1;
+            break;
+        }
+    }
+    free(mentions);
+    return rewrites;
+}
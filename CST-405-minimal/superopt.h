@@ -0,0 +1,28 @@
+#ifndef SUPEROPT_H
+#define SUPEROPT_H
+
+#include "tac.h"
+
+/* SUPEROPTIMIZER
+ * Offline (--superopt): short windows of int TAC that survive the
+ * optimizer are abstracted into patterns, and the shortest equivalent
+ * sequence is found by enumeration.  Equivalence is checked on every
+ * input in a small domain plus pseudo-random 32-bit values.  Winning
+ * rewrites are merged into the generated table superopt_table.h.
+ * Online: the table is compiled in, loaded at startup and applied as
+ * a peephole pass over the optimized TAC.
+ */
+
+#define SUPEROPT_TABLE_FILE "superopt_table.h"
+
+int  superoptLoadTable(void);                     /* parse the built-in table; rules loaded */
+void superoptSetTraining(int on);                 /* harvest and search new windows */
+int  superoptSaveTable(const char* path);         /* rewrite the table file; rules written */
+
+/* isInt decides which operands hold int values.  Windows not yet in
+ * the table are searched first when training.  Rewrites code[0..n)
+ * in place and sets dead[i] for instructions that became redundant;
+ * returns the number of windows rewritten. */
+int  superoptPeephole(TACInstr** code, int n, int (*isInt)(const char*), int* dead);
+
+#endif
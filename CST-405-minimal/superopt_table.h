@@ -0,0 +1,47 @@
+/* GENERATED FILE: superoptimizer rewrite table.
+ * Regenerate with `make superopt-table`, which runs
+ * `minicompiler --superopt` over the test programs.
+ * Each entry reads  window => replacement,  where vN is an input,
+ * rN the result of instruction N and #c a constant.
+ */
+static const char* superoptTable[] = {
+    "mov v0 - ; mov v1 - ; add r0 r1 => add v0 v1",
+    "mov v0 - ; add r0 v1 ; mov r1 - => add v0 v1",
+    "mov v0 - ; add r0 #1 ; mov r1 - => add v0 #1",
+    "add v0 #1 ; mov r0 - => add v0 #1",
+    "mov v0 - ; add r0 #3 ; mov r1 - => add v0 #3",
+    "add v0 v1 ; mov r0 - => add v0 v1",
+    "mul v0 #3 ; add v1 r0 ; mov r1 - => mul v0 #3 ; add v1 r0",
+    "mul v0 #7 ; mov r0 - => mul v0 #7",
+    "sub v0 #1 ; mov r0 - => add v0 #-1",
+    "add v0 #2 ; mov r0 - => add v0 #2",
+    "mov v0 - ; gt r0 #3 => lt #3 v0",
+    "mov v0 - ; add r0 #1 => add v0 #1",
+    "mov v0 - ; add v1 r0 => add v0 v1",
+    "mov v0 - ; sub v1 r0 => sub v1 v0",
+    "mov v0 - ; mul r0 #2 => add v0 v0",
+    "sub v0 v1 ; mov r0 - => sub v0 v1",
+    "add v0 v1 ; add r0 v2 ; mov r1 - => add v0 v1 ; add v2 r0",
+    "mov #0 - ; add r0 v0 => mov v0 -",
+    "mov #0 - ; mov #6 - ; mov #6 - ; mov #6 - => mov #6 -",
+    "mul v0 v0 ; add v1 r0 ; mov r1 - => mul v0 v0 ; add v1 r0",
+    "mov v0 - ; mul v1 r0 => mul v0 v1",
+    "add v0 #7 ; mov r0 - => add v0 #7",
+    "mov #3 - ; mov #7 - ; add r0 r1 => mov #10 -",
+    "mul v0 #2 ; add v1 r0 ; mov r1 - => add v0 v0 ; add v1 r0",
+    "add v0 v1 ; add v2 r0 ; mov r1 - => add v0 v1 ; add v2 r0",
+    "mul #3 v0 ; add r0 #1 ; mov r1 - => mul v0 #3 ; add r0 #1",
+    "mov v0 - ; add r0 v0 => add v0 v0",
+    "mov #11 - ; mov r0 - => mov #11 -",
+    "mul v0 v1 ; add v2 r0 ; mov r1 - => mul v0 v1 ; add v2 r0",
+    "add v0 v1 ; sub r0 v2 ; mov r1 - => add v0 v1 ; sub r0 v2",
+    "mov #-40000 - ; mov #-40000 - => mov #-40000 -",
+    "eq v0 #0 ; mov r0 - => eq v0 #0",
+    "ne v0 #3 ; mov r0 - => ne v0 #3",
+    "ge v0 #10 ; mov r0 - => le #10 v0",
+    "add #7232 v0 ; sub r0 v1 ; mov r1 - => add v0 #7232 ; sub r0 v1",
+    "mov v0 - ; mov r0 - => mov v0 -",
+    "add v0 #4 ; eq r0 #10 => eq v0 #6",
+    "mov #18 - ; add #18 v0 => add v0 #18",
+    NULL
+};
@@ -470,6 +470,38 @@ VarType getFunctionReturnType(char* name) {
     return TYPE_VOID;
 }
 
+/* Get number of parameters, -1 if the function is unknown */
+int getFunctionParamCount(char* name) {
+    for (int i = 0; i < globalSymTab.func_count; i++) {
+        if (strcmp(globalSymTab.funcs[i].name, name) == 0)
+            return globalSymTab.funcs[i].param_count;
+    }
+    return -1;
+}
+
+/* Find the index-th parameter (in source order) of a nested param list AST */
+static ASTNode* findParam(ASTNode* node, int* index) {
+    if (!node) return NULL;
+    if (node->type == NODE_PARAM) return (*index)-- == 0 ? node : NULL;
+    if (node->type == NODE_PARAM_LIST) {
+        ASTNode* p = findParam(node->data.param_list.param, index);
+        return p ? p : findParam(node->data.param_list.next, index);
+    }
+    return NULL;
+}
+
+/* Get the type a parameter is passed as; arrays are passed by address */
+VarType getFunctionParamType(char* name, int index) {
+    for (int i = 0; i < globalSymTab.func_count; i++) {
+        if (strcmp(globalSymTab.funcs[i].name, name) != 0) continue;
+        ASTNode* fn = globalSymTab.funcs[i].ast_node;
+        ASTNode* p = fn ? findParam(fn->data.func.params, &index) : NULL;
+        if (!p) return TYPE_VOID;
+        return p->data.param.is_array ? TYPE_INT : p->data.param.type;
+    }
+    return TYPE_VOID;
+}
+
 /* Debug print current symbol table */
 void printSymTab() {
     printf("\n=== SYMBOL TABLE ===\n");
@@ -88,6 +88,8 @@ void enterFunction(char* name);  /* Enter function scope */
 void exitFunction();             /* Exit function scope */
 int isFunctionDeclared(char* name); /* Check if function exists */
 VarType getFunctionReturnType(char* name); /* Get function return type */
+int getFunctionParamCount(char* name);      /* Get parameter count, -1 if unknown */
+VarType getFunctionParamType(char* name, int index); /* Get type a parameter is passed as */
 void printSymTab();              /* Print current symbol table contents for tracing */
 void printGlobalSymTab();        /* Print global symbol table */
 int addArrayVar(char* name, VarType type, int size); /* Add array variable */
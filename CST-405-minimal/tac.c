@@ -404,7 +404,8 @@ void generateTAC(ASTNode* node) {
         }
 
         case NODE_FOR: {
-            /* Emit: init; start: if(!cond) goto end; body; update; goto start; end: */
+            /* Emit: init; start: if(!cond) goto end; body; update; goto start; end:
+             * (loop fusion in optimizer.c recognizes loops by this shape) */
             char* start_label = newLabel();
             char* end_label   = newLabel();
 
@@ -40,7 +40,8 @@ typedef enum {
     TAC_LT,          /* Less than: result = arg1 < arg2 */
     TAC_GT,          /* Greater than: result = arg1 > arg2 */
     TAC_LE,          /* Less or equal: result = arg1 <= arg2 */
-    TAC_GE           /* Greater or equal: result = arg1 >= arg2 */
+    TAC_GE,          /* Greater or equal: result = arg1 >= arg2 */
+    TAC_SELECT       /* Select: if arg1 != 0, result = arg2 (else unchanged) */
 } TACOp;
 
 /* TAC INSTRUCTION STRUCTURE */